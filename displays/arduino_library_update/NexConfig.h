@@ -37,6 +37,42 @@
 #define nexSerial Serial1
 #define NEXSERIALBAUD 115200
 
+/**
+ * Size of the queue of bytes waiting to be sent to the display. 
+ * Must be a power of 2, no larger than 256. 
+ */
+#define NEX_TX_RING_SIZE 256
+
+/**
+ * Maximum bytes passed to nexSerial by each call of nexTxService(). 
+ * Limits the time spent in the interrupt that calls it. 
+ * 32 from a 1ms interrupt keeps up with about 320000 baud. 
+ */
+#define NEX_TX_SERVICE_MAX 32
+
+/**
+ * Longest return frame kept by nexLoop(), including the terminator. 
+ * Longer string frames are truncated. 
+ */
+#define NEX_RX_FRAME_MAX 16
+
+/**
+ * Touch events held until nexLoop() passes them to their callbacks. 
+ */
+#define NEX_TOUCH_QUEUE_SIZE 4
+
+/**
+ * "get" queries that can be waiting for a reply, and the longest command. 
+ */
+#define NEX_GET_QUEUE_SIZE 4
+#define NEX_GET_CMD_MAX 24
+
+/**
+ * ms a "get" query that timed out still holds its place in the queue, so that 
+ * its reply, if it comes late, is not taken for the reply to a later query. 
+ */
+#define NEX_GET_LATE_MS 500
+
 
 #ifdef DEBUG_SERIAL_ENABLE
 #define dbSerialPrint(a)    dbSerial.print(a)
@@ -23,6 +23,8 @@
 #define NEX_RET_CURRENT_PAGE_ID_HEAD        (0x66)
 #define NEX_RET_STRING_HEAD                 (0x70)
 #define NEX_RET_NUMBER_HEAD                 (0x71)
+#define NEX_RET_TRANSPARENT_READY           (0xFE)
+#define NEX_RET_TRANSPARENT_DONE            (0xFD)
 #define NEX_RET_INVALID_CMD             (0x00)
 #define NEX_RET_INVALID_COMPONENT_ID    (0x02)
 #define NEX_RET_INVALID_PAGE_ID         (0x03)
@@ -31,10 +33,97 @@
 #define NEX_RET_INVALID_BAUD            (0x11)
 #define NEX_RET_INVALID_VARIABLE        (0x1A)
 #define NEX_RET_INVALID_OPERATION       (0x1B)
+#define NEX_RET_ERROR_LIMIT             (0x30)  /* return codes below this, except 0x01, are errors */
+#define NEX_RET_STARTUP_LEN             (6)     /* 00 00 00 FF FF FF, sent at power on: not an error */
+
+/*
+ * count of bytes sent to the display, including the 0xFF terminators
+ */
+uint32_t nexTxByteCount = 0;
+
+/*
+ * display transmit queue.
+ * commands are added by nexTrySendCommand() and removed by nexTxService(),
+ * normally called from a timer interrupt. There is one writer of each index
+ * and they are single bytes, so no locking is needed.
+ */
+#define NEX_TX_RING_MASK (NEX_TX_RING_SIZE - 1)
+static uint8_t nexTxRing[NEX_TX_RING_SIZE];
+static volatile uint8_t nexTxHead = 0;              /* next byte to write */
+static volatile uint8_t nexTxTail = 0;              /* next byte to send */
+uint16_t nexTxHighWater = 0;
+uint16_t nexTxRejectCount = 0;
+
+/*
+ * return frame statistics and the last page number reported by the display
+ */
+uint16_t nexRxAckCount = 0;
+static uint16_t nexRxAckPending = 0;            /* commands sent whose ack hasn't arrived */
+uint16_t nexRxErrorCount = 0;
+uint16_t nexRxLaunchCount = 0;
+uint16_t nexRxFrameErrorCount = 0;
+uint8_t nexCurrentPageId = 0;
+bool nexRxTransparentReady = false;
+bool nexRxTransparentDone = false;
+
+/*
+ * touch events received, waiting to be passed to callbacks by nexLoop()
+ */
+struct NexTouchEvent
+{
+    uint8_t pid;
+    uint8_t cid;
+    uint8_t event;
+};
+static NexTouchEvent nexTouchQueue[NEX_TOUCH_QUEUE_SIZE];
+static uint8_t nexTouchHead = 0;                /* oldest event */
+static uint8_t nexTouchCount = 0;
+
+/*
+ * queued "get" queries waiting for their number return frame.
+ * replies come back in the order the queries were sent, so the oldest
+ * query still owed a reply gets the next number, or the next error frame.
+ * a query that times out has its callback called, but stays in the queue
+ * (late) until its reply arrives and is dropped, or NEX_GET_LATE_MS passes,
+ * so a late reply isn't taken for the reply to the query after it.
+ * Callbacks are called from nexLoop().
+ */
+#define NEX_GET_WAITING 0                       /* sent, waiting for the reply */
+#define NEX_GET_DONE 1                          /* number received, callback not yet called */
+#define NEX_GET_FAILED 2                        /* error frame received, callback not yet called */
+#define NEX_GET_LATE 3                          /* timed out and callback called; reply still owed */
+#define NEX_GET_FINISHED 4                      /* callback called and reply received: can be removed */
+struct NexPendingGet
+{
+    NexNumberCallback callback;
+    void *ptr;
+    uint32_t start;                             /* millis() when sent, or when it timed out if late */
+    uint16_t timeout;
+    uint32_t number;
+    uint8_t state;
+};
+static NexPendingGet nexGetQueue[NEX_GET_QUEUE_SIZE];
+static uint8_t nexGetHead = 0;                  /* oldest query */
+static uint8_t nexGetCount = 0;
+
+/*
+ * results wanted by the blocking receive functions
+ */
+static bool nexSyncNumberWanted = false;
+static bool nexSyncNumberReady = false;
+static uint32_t nexSyncNumber;
+static char *nexSyncString = NULL;              /* buffer for a string return, or NULL */
+static uint16_t nexSyncStringMax;
+static uint16_t nexSyncStringLen;
+static bool nexSyncStringReady = false;
+
+static void nexRxPoll(void);
 
 /*
  * Receive uint32_t data. 
  * 
+ * Other return frames that arrive first are still processed. 
+ *
  * @param number - save uint32_t data. 
  * @param timeout - set timeout time. 
  *
@@ -45,26 +134,25 @@
 bool recvRetNumber(uint32_t *number, uint32_t timeout)
 {
     bool ret = false;
-    uint8_t temp[8] = {0};
+    uint32_t start;
 
     if (!number)
     {
         goto __return;
     }
     
-    nexSerial.setTimeout(timeout);
-    if (sizeof(temp) != nexSerial.readBytes((char *)temp, sizeof(temp)))
+    nexTxFlush();
+    nexSyncNumberReady = false;
+    nexSyncNumberWanted = true;
+    start = millis();
+    while (!nexSyncNumberReady && millis() - start <= timeout)
     {
-        goto __return;
+        nexRxPoll();
     }
-
-    if (temp[0] == NEX_RET_NUMBER_HEAD
-        && temp[5] == 0xFF
-        && temp[6] == 0xFF
-        && temp[7] == 0xFF
-        )
+    nexSyncNumberWanted = false;
+    if (nexSyncNumberReady)
     {
-        *number = ((uint32_t)temp[4] << 24) | ((uint32_t)temp[3] << 16) | (temp[2] << 8) | (temp[1]);
+        *number = nexSyncNumber;
         ret = true;
     }
 
@@ -87,6 +175,8 @@ __return:
 /*
  * Receive string data. 
  * 
+ * Other return frames that arrive first are still processed. 
+ *
  * @param buffer - save string data. 
  * @param len - string buffer length. 
  * @param timeout - set timeout time. 
@@ -97,87 +187,402 @@ __return:
 uint16_t recvRetString(char *buffer, uint16_t len, uint32_t timeout)
 {
     uint16_t ret = 0;
-    bool str_start_flag = false;
-    uint8_t cnt_0xff = 0;
-    String temp = String("");
-    uint8_t c = 0;
-    long start;
+    uint32_t start;
 
     if (!buffer || len == 0)
     {
         goto __return;
     }
     
+    nexTxFlush();
+    nexSyncStringLen = 0;
+    nexSyncStringMax = len;
+    nexSyncStringReady = false;
+    nexSyncString = buffer;
     start = millis();
-    while (millis() - start <= timeout)
+    while (!nexSyncStringReady && millis() - start <= timeout)
+    {
+        nexRxPoll();
+    }
+    nexSyncString = NULL;
+    ret = nexSyncStringLen;
+    
+__return:
+
+    dbSerialPrint("recvRetString[");
+    dbSerialPrint(ret);
+    dbSerialPrintln("]");
+
+    return ret;
+}
+
+/*
+ * Number of bytes waiting in the transmit queue. 
+ */
+uint16_t nexTxUsed(void)
+{
+    return (uint8_t)(nexTxHead - nexTxTail) & NEX_TX_RING_MASK;
+}
+
+/*
+ * Free space in the transmit queue, in bytes. 
+ * One byte is kept unused so that a full queue can be told from an empty one. 
+ */
+uint16_t nexTxFree(void)
+{
+    return NEX_TX_RING_SIZE - 1 - nexTxUsed();
+}
+
+/*
+ * Pass up to max queued bytes to nexSerial, as many as it will take without blocking. 
+ */
+static void nexTxServiceBytes(uint8_t max)
+{
+    uint8_t tail = nexTxTail;
+    uint8_t count = 0;
+
+    while (tail != nexTxHead && count < max
+           && nexSerial.availableForWrite() > 0)
+    {
+        nexSerial.write(nexTxRing[tail]);
+        tail = (tail + 1) & NEX_TX_RING_MASK;
+        count++;
+    }
+    nexTxTail = tail;
+}
+
+/*
+ * Pass queued bytes to nexSerial, as many as it will take without blocking. 
+ * Call from a periodic interrupt (1ms is enough for 115200 baud). 
+ */
+void nexTxService(void)
+{
+    nexTxServiceBytes(NEX_TX_SERVICE_MAX);
+}
+
+/*
+ * Service the queue from the main code, for when it is waiting. 
+ * Interrupts are held off so this can't run at the same time as the interrupt call; 
+ * only one byte is passed each time, so they are held off for as short a time as possible. 
+ */
+static void nexTxServiceFromLoop(void)
+{
+    uint8_t sreg = SREG;
+
+    cli();
+    nexTxServiceBytes(1);
+    SREG = sreg;
+}
+
+/*
+ * Wait until every queued byte has been passed to nexSerial. 
+ */
+void nexTxFlush(void)
+{
+    while (nexTxUsed() != 0)
+    {
+        nexTxServiceFromLoop();
+    }
+}
+
+/*
+ * Count a command sent, for recvRetCommandFinished(): all but two are acknowledged. 
+ * An empty command only clears the display's input, and "get" is answered with its value. 
+ * cmd needs only its first 4 characters. 
+ */
+static void nexTxAckExpected(const char* cmd)
+{
+    if (cmd[0] == 0 || strncmp(cmd, "get ", 4) == 0)
+    {
+        return;
+    }
+    if (nexRxAckPending != 0xFFFF)
+    {
+        nexRxAckPending++;
+    }
+}
+
+/*
+ * Copy a command and its terminator into the transmit queue. 
+ * Returns false, having queued nothing, if there isn't space. 
+ */
+static bool nexTxEnqueue(const char* cmd)
+{
+    uint16_t len = strlen(cmd) + 3;
+    uint16_t used;
+    uint8_t head;
+
+    if (len > nexTxFree())
     {
-        while (nexSerial.available())
+        return false;
+    }
+
+    nexTxAckExpected(cmd);
+    head = nexTxHead;
+    while (*cmd)
+    {
+        nexTxRing[head] = *cmd++;
+        head = (head + 1) & NEX_TX_RING_MASK;
+    }
+    nexTxRing[head] = 0xFF;
+    head = (head + 1) & NEX_TX_RING_MASK;
+    nexTxRing[head] = 0xFF;
+    head = (head + 1) & NEX_TX_RING_MASK;
+    nexTxRing[head] = 0xFF;
+    head = (head + 1) & NEX_TX_RING_MASK;
+    nexTxHead = head;
+
+    nexTxByteCount += len;
+    used = nexTxUsed();
+    if (used > nexTxHighWater)
+    {
+        nexTxHighWater = used;
+    }
+    return true;
+}
+
+/*
+ * Copy binary data into the transmit queue, with no terminator. 
+ *
+ * @param data - the bytes to send. 
+ * @param len - number of bytes. 
+ *
+ * @retval true - all the data is queued. 
+ * @retval false - not enough space; nothing has been queued. 
+ */
+bool nexTrySendData(const uint8_t *data, uint16_t len)
+{
+    uint16_t cntr;
+    uint16_t used;
+    uint8_t head;
+
+    if (len > nexTxFree())
+    {
+        nexTxRejectCount++;
+        return false;
+    }
+
+    head = nexTxHead;
+    for (cntr = 0; cntr < len; cntr++)
+    {
+        nexTxRing[head] = data[cntr];
+        head = (head + 1) & NEX_TX_RING_MASK;
+    }
+    nexTxHead = head;
+
+    nexTxByteCount += len;
+    used = nexTxUsed();
+    if (used > nexTxHighWater)
+    {
+        nexTxHighWater = used;
+    }
+    return true;
+}
+
+/*
+ * Add a command to the transmit queue, without waiting. 
+ *
+ * @param cmd - the string of command.
+ *
+ * @retval true - the command and its terminator are queued. 
+ * @retval false - not enough space; nothing has been queued. 
+ */
+bool nexTrySendCommand(const char* cmd)
+{
+    if (!nexTxEnqueue(cmd))
+    {
+        nexTxRejectCount++;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Start building a command directly in the transmit queue. 
+ *
+ * Reserves space for maxLen characters and the terminator. The characters are 
+ * written beyond the end of the queue and only become visible to nexTxService() 
+ * when nexCmdEnd() is called, so no other command may be sent until then. 
+ *
+ * @param cmd - the builder. 
+ * @param maxLen - most characters the command can have. 
+ * @param wait - if true, wait for space; if false, fail if there isn't space. 
+ *
+ * @retval true - space reserved. 
+ * @retval false - not enough space. The builder ignores anything added. 
+ */
+bool nexCmdBegin(NexCmdBuilder *cmd, uint8_t maxLen, bool wait)
+{
+    cmd->len = 0;
+    cmd->cap = maxLen;
+    cmd->overflow = false;
+    if ((uint16_t)maxLen + 3 >= NEX_TX_RING_SIZE)
+    {
+        cmd->cap = NEX_TX_RING_SIZE - 4;
+    }
+    while ((uint16_t)cmd->cap + 3 > nexTxFree())
+    {
+        if (!wait)
         {
-            c = nexSerial.read();
-            if (str_start_flag)
-            {
-                if (0xFF == c)
-                {
-                    cnt_0xff++;                    
-                    if (cnt_0xff >= 3)
-                    {
-                        break;
-                    }
-                }
-                else
-                {
-                    temp += (char)c;
-                }
-            }
-            else if (NEX_RET_STRING_HEAD == c)
+            nexTxRejectCount++;
+            cmd->cap = 0;
+            cmd->overflow = true;
+            return false;
+        }
+        nexTxServiceFromLoop();
+    }
+    return true;
+}
+
+/*
+ * Add one character to a command. 
+ */
+void nexCmdChar(NexCmdBuilder *cmd, char c)
+{
+    if (cmd->len >= cmd->cap)
+    {
+        cmd->overflow = true;
+        return;
+    }
+    nexTxRing[(uint8_t)(nexTxHead + cmd->len) & NEX_TX_RING_MASK] = c;
+    cmd->len++;
+}
+
+/*
+ * Add a string to a command. 
+ */
+void nexCmdText(NexCmdBuilder *cmd, const char *text)
+{
+    while (*text)
+    {
+        nexCmdChar(cmd, *text++);
+    }
+}
+
+/*
+ * Add a signed integer to a command, with a decimal point before the 
+ * last "decimals" digits (so 123 with 1 decimal is "12.3" and -5 is "-0.5"). 
+ * Digits are found most significant first so they are written in one pass. 
+ */
+void nexCmdInt(NexCmdBuilder *cmd, int16_t value, uint8_t decimals)
+{
+    uint16_t magnitude;
+    uint16_t divisor = 10000;
+    uint8_t place = 4;                              /* power of 10 of this digit */
+    uint8_t digit;
+    bool started = false;
+
+    if (value < 0)
+    {
+        nexCmdChar(cmd, '-');
+        magnitude = (uint16_t)(-(int32_t)value);
+    }
+    else
+    {
+        magnitude = (uint16_t)value;
+    }
+
+    while (true)
+    {
+        digit = magnitude / divisor;
+        magnitude -= digit * divisor;
+        if (digit != 0 || started || place <= decimals || place == 0)
+        {
+            started = true;
+            nexCmdChar(cmd, '0' + digit);
+            if (place == decimals && place != 0)
             {
-                str_start_flag = true;
+                nexCmdChar(cmd, '.');
             }
         }
-        
-        if (cnt_0xff >= 3)
+        if (place == 0)
         {
             break;
         }
+        place--;
+        divisor /= 10;
     }
+}
 
-    ret = temp.length();
-    ret = ret > len ? len : ret;
-    strncpy(buffer, temp.c_str(), ret);
-    
-__return:
+/*
+ * Finish a command: add the terminator and pass it to nexTxService(). 
+ *
+ * @retval true - command queued. 
+ * @retval false - it didn't fit in the space reserved, or nexCmdBegin() failed; nothing is sent. 
+ */
+bool nexCmdEnd(NexCmdBuilder *cmd)
+{
+    uint8_t head;
+    uint16_t used;
+    char start[5];
+    uint8_t cntr;
 
-    dbSerialPrint("recvRetString[");
-    dbSerialPrint(temp.length());
-    dbSerialPrint(",");
-    dbSerialPrint(temp);
-    dbSerialPrintln("]");
+    if (cmd->overflow)
+    {
+        return false;
+    }
 
-    return ret;
+    for (cntr = 0; cntr < 4 && cntr < cmd->len; cntr++)
+    {
+        start[cntr] = nexTxRing[(uint8_t)(nexTxHead + cntr) & NEX_TX_RING_MASK];
+    }
+    start[cntr] = 0;
+    nexTxAckExpected(start);
+    head = (nexTxHead + cmd->len) & NEX_TX_RING_MASK;
+    nexTxRing[head] = 0xFF;
+    head = (head + 1) & NEX_TX_RING_MASK;
+    nexTxRing[head] = 0xFF;
+    head = (head + 1) & NEX_TX_RING_MASK;
+    nexTxRing[head] = 0xFF;
+    head = (head + 1) & NEX_TX_RING_MASK;
+    nexTxHead = head;
+
+    nexTxByteCount += cmd->len + 3;
+    used = nexTxUsed();
+    if (used > nexTxHighWater)
+    {
+        nexTxHighWater = used;
+    }
+    return true;
 }
 
 /*
  * Send command to Nextion.
  *
+ * Waits for space in the transmit queue if it is full. 
+ * Bytes already received are left for nexLoop() to process. 
+ *
  * @param cmd - the string of command.
  */
 void sendCommand(const char* cmd)
 {
-    while (nexSerial.available())
+    if (strlen(cmd) + 3 >= NEX_TX_RING_SIZE)
     {
-        nexSerial.read();
+        /* too long to ever fit in the queue: send it directly */
+        nexTxFlush();
+        nexTxAckExpected(cmd);
+        nexTxByteCount += nexSerial.print(cmd) + 3;
+        nexSerial.write(0xFF);
+        nexSerial.write(0xFF);
+        nexSerial.write(0xFF);
+        return;
+    }
+
+    while (!nexTxEnqueue(cmd))
+    {
+        nexTxServiceFromLoop();
     }
-    
-    nexSerial.print(cmd);
-    nexSerial.write(0xFF);
-    nexSerial.write(0xFF);
-    nexSerial.write(0xFF);
 }
 
 
 /*
  * Command is executed successfully. 
  *
+ * Waits until every command sent so far has been acknowledged, so an ack for an 
+ * earlier queued command isn't taken for this one's; other return frames that 
+ * arrive first are still processed. With bkcmd=1 a command that fails sends 
+ * nothing, so after a failure this times out once; the count then starts again. 
+ *
  * @param timeout - set timeout time.
  *
  * @retval true - success.
@@ -187,22 +592,16 @@ void sendCommand(const char* cmd)
 bool recvRetCommandFinished(uint32_t timeout)
 {    
     bool ret = false;
-    uint8_t temp[4] = {0};
+    uint32_t start;
     
-    nexSerial.setTimeout(timeout);
-    if (sizeof(temp) != nexSerial.readBytes((char *)temp, sizeof(temp)))
+    nexTxFlush();
+    start = millis();
+    while (nexRxAckPending != 0 && millis() - start <= timeout)
     {
-        ret = false;
-    }
-
-    if (temp[0] == NEX_RET_CMD_FINISHED
-        && temp[1] == 0xFF
-        && temp[2] == 0xFF
-        && temp[3] == 0xFF
-        )
-    {
-        ret = true;
+        nexRxPoll();
     }
+    ret = (nexRxAckPending == 0);
+    nexRxAckPending = 0;
 
     if (ret) 
     {
@@ -232,36 +631,340 @@ bool nexInit(long Speed)
     return ret1 && ret2;
 }
 
-void nexLoop(NexTouch *nex_listen_list[])
+/*
+ * Length of a return frame, including the 0xFF 0xFF 0xFF terminator, found from its header. 
+ * Frames with binary data are a fixed length because the data can include 0xFF. 
+ * Returns 0 for frames that end at the first terminator (strings, acks, errors and events). 
+ */
+static uint8_t nexRxFrameLength(uint8_t header)
 {
-    static uint8_t __buffer[10];
-    
-    uint16_t i;
-    uint8_t c;  
-    
-    while (nexSerial.available() > 0)
-    {   
-        delay(10);
-        c = nexSerial.read();
-        
-        if (NEX_RET_EVENT_TOUCH_HEAD == c)
+    switch (header)
+    {
+        case NEX_RET_EVENT_TOUCH_HEAD:
+            return 7;
+        case NEX_RET_CURRENT_PAGE_ID_HEAD:
+            return 5;
+        case NEX_RET_EVENT_POSITION_HEAD:
+        case NEX_RET_EVENT_SLEEP_POSITION_HEAD:
+            return 9;
+        case NEX_RET_NUMBER_HEAD:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+/*
+ * Give a number or error return frame to the oldest "get" query still owed a reply. 
+ * A late query's reply is dropped. 
+ * Returns false if no query is owed a reply. 
+ */
+static bool nexGetReply(bool ok, uint32_t number)
+{
+    uint8_t cntr;
+    NexPendingGet *get;
+
+    for (cntr = 0; cntr < nexGetCount; cntr++)
+    {
+        get = &nexGetQueue[(nexGetHead + cntr) % NEX_GET_QUEUE_SIZE];
+        if (get->state == NEX_GET_LATE)
         {
-            if (nexSerial.available() >= 6)
+            get->state = NEX_GET_FINISHED;
+            return true;
+        }
+        if (get->state == NEX_GET_WAITING)
+        {
+            get->number = number;
+            get->state = ok ? NEX_GET_DONE : NEX_GET_FAILED;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+ * Act on a complete return frame. 
+ * frame[0] is the header; len includes the terminator. 
+ */
+static void nexRxDispatch(uint8_t *frame, uint8_t len)
+{
+    uint8_t index;
+    uint32_t number;
+
+    switch (frame[0])
+    {
+        case NEX_RET_EVENT_TOUCH_HEAD:
+            if (nexTouchCount < NEX_TOUCH_QUEUE_SIZE)
             {
-                __buffer[0] = c;  
-                for (i = 1; i < 7; i++)
-                {
-                    __buffer[i] = nexSerial.read();
-                }
-                __buffer[i] = 0x00;
-                
-                if (0xFF == __buffer[4] && 0xFF == __buffer[5] && 0xFF == __buffer[6])
+                index = (nexTouchHead + nexTouchCount) % NEX_TOUCH_QUEUE_SIZE;
+                nexTouchQueue[index].pid = frame[1];
+                nexTouchQueue[index].cid = frame[2];
+                nexTouchQueue[index].event = frame[3];
+                nexTouchCount++;
+            }
+            break;
+
+        case NEX_RET_NUMBER_HEAD:
+            number = ((uint32_t)frame[4] << 24) | ((uint32_t)frame[3] << 16) | ((uint32_t)frame[2] << 8) | (frame[1]);
+            if (nexGetReply(true, number))
+            {
+                return;
+            }
+            if (nexSyncNumberWanted)
+            {
+                nexSyncNumber = number;
+                nexSyncNumberReady = true;
+            }
+            break;
+
+        case NEX_RET_STRING_HEAD:
+            if (nexSyncString)
+            {
+                nexSyncStringReady = true;
+            }
+            break;
+
+        case NEX_RET_CURRENT_PAGE_ID_HEAD:
+            nexCurrentPageId = frame[1];
+            break;
+
+        case NEX_RET_CMD_FINISHED:
+            nexRxAckCount++;
+            if (nexRxAckPending != 0)
+            {
+                nexRxAckPending--;
+            }
+            break;
+
+        case NEX_RET_EVENT_LAUNCHED:
+            nexRxLaunchCount++;
+            break;
+
+        case NEX_RET_TRANSPARENT_READY:
+            nexRxTransparentReady = true;
+            break;
+
+        case NEX_RET_TRANSPARENT_DONE:
+            nexRxTransparentDone = true;
+            break;
+
+        case NEX_RET_EVENT_POSITION_HEAD:
+        case NEX_RET_EVENT_SLEEP_POSITION_HEAD:
+        case NEX_RET_EVENT_UPGRADED:
+            break;
+
+        default:
+            if (frame[0] == NEX_RET_INVALID_CMD && len == NEX_RET_STARTUP_LEN && frame[1] == 0 && frame[2] == 0)
+            {
+                /* the display has just powered up: nothing sent before will be acknowledged */
+                nexRxAckPending = 0;
+            }
+            else if (frame[0] < NEX_RET_ERROR_LIMIT)
+            {
+                /* an error is a get's reply, or sent instead of an ack (bkcmd=2 or 3) */
+                nexRxErrorCount++;
+                if (!nexGetReply(false, 0) && nexRxAckPending != 0)
                 {
-                    NexTouch::iterate(nex_listen_list, __buffer[1], __buffer[2], (int32_t)__buffer[3]);
+                    nexRxAckPending--;
                 }
-                
             }
+            break;
+    }
+}
+
+/*
+ * Return frame parser state. 
+ * Bytes are added one at a time so a frame can arrive over several calls of nexLoop(). 
+ */
+static uint8_t nexRxFrame[NEX_RX_FRAME_MAX];
+static uint8_t nexRxCount = 0;                  /* bytes received in this frame */
+static uint8_t nexRxExpected = 0;               /* frame length, or 0 if ended by terminator */
+static uint8_t nexRxFFCount = 0;                /* consecutive 0xFF bytes received */
+
+/*
+ * Discard any partly received frame. 
+ */
+void nexRxReset(void)
+{
+    nexRxCount = 0;
+    nexRxFFCount = 0;
+}
+
+/*
+ * Add one received byte to the frame. 
+ * Dispatches the frame when it is complete. 
+ */
+static void nexRxByte(uint8_t c)
+{
+    uint8_t len;
+
+    if (nexRxCount == 0)
+    {
+        nexRxExpected = nexRxFrameLength(c);
+        nexRxFFCount = 0;
+    }
+    if (nexRxCount < NEX_RX_FRAME_MAX)
+    {
+        nexRxFrame[nexRxCount] = c;
+    }
+    if (nexSyncString && !nexSyncStringReady && nexRxFrame[0] == NEX_RET_STRING_HEAD
+        && nexRxCount != 0 && c != 0xFF && nexSyncStringLen < nexSyncStringMax)
+    {
+        /* strings can be longer than the frame buffer, so copy straight to the caller */
+        nexSyncString[nexSyncStringLen++] = c;
+    }
+    if (nexRxCount < 255)
+    {
+        nexRxCount++;
+    }
+    nexRxFFCount = (c == 0xFF) ? nexRxFFCount + 1 : 0;
+
+    if (nexRxExpected != 0)
+    {
+        if (nexRxCount < nexRxExpected)
+        {
+            return;
+        }
+        len = nexRxCount;
+        if (nexRxFFCount < 3)
+        {
+            /* bad terminator: drop the frame; the parser resynchronises on a later frame */
+            nexRxReset();
+            nexRxFrameErrorCount++;
+            return;
         }
+        nexRxReset();
     }
+    else
+    {
+        if (nexRxFFCount < 3 || nexRxCount < 4)
+        {
+            return;
+        }
+        len = nexRxCount;
+        nexRxReset();
+    }
+    nexRxDispatch(nexRxFrame, len);
 }
 
+/*
+ * Parse every byte received so far. 
+ */
+static void nexRxPoll(void)
+{
+    while (nexSerial.available() > 0)
+    {
+        nexRxByte(nexSerial.read());
+    }
+}
+
+
+
+/*
+ * Send a "get" query without waiting for the reply. 
+ *
+ * @param var - the variable or attribute to read, eg "p1bt0.val". 
+ * @param callback - called from nexLoop() with the number, or with ok false on timeout. 
+ * @param ptr - passed to the callback. 
+ * @param timeout - ms to wait for the reply. 
+ *
+ * @retval true - query sent. 
+ * @retval false - too many queries waiting, or the transmit queue is full. 
+ */
+bool nexGetNumberAsync(const char *var, NexNumberCallback callback, void *ptr, uint16_t timeout)
+{
+    char cmd[NEX_GET_CMD_MAX];
+    NexPendingGet *get;
+
+    if (nexGetCount >= NEX_GET_QUEUE_SIZE || strlen(var) + 5 > sizeof(cmd))
+    {
+        return false;
+    }
+    strcpy(cmd, "get ");
+    strcat(cmd, var);
+    if (!nexTrySendCommand(cmd))
+    {
+        return false;
+    }
+
+    get = &nexGetQueue[(nexGetHead + nexGetCount) % NEX_GET_QUEUE_SIZE];
+    get->callback = callback;
+    get->ptr = ptr;
+    get->start = millis();
+    get->timeout = timeout;
+    get->state = NEX_GET_WAITING;
+    nexGetCount++;
+    return true;
+}
+
+/*
+ * Number of "get" queries waiting for their reply or timeout. 
+ */
+uint8_t nexGetPending(void)
+{
+    return nexGetCount;
+}
+
+void nexLoop(NexTouch *nex_listen_list[])
+{
+    NexTouchEvent touch;
+    NexPendingGet *get;
+    NexNumberCallback callback;
+    uint8_t cntr;
+    bool ok;
+
+    nexRxPoll();
+/*
+ * pass touch events to their callbacks.
+ * each is removed first, as a callback may itself wait for a return frame
+ */
+    while (nexTouchCount != 0)
+    {
+        touch = nexTouchQueue[nexTouchHead];
+        nexTouchHead = (nexTouchHead + 1) % NEX_TOUCH_QUEUE_SIZE;
+        nexTouchCount--;
+        NexTouch::iterate(nex_listen_list, touch.pid, touch.cid, (int32_t)touch.event);
+    }
+/*
+ * complete "get" queries that have their reply or have timed out.
+ * each is marked first, as a callback may send another query
+ */
+    for (cntr = 0; cntr < nexGetCount; cntr++)
+    {
+        get = &nexGetQueue[(nexGetHead + cntr) % NEX_GET_QUEUE_SIZE];
+        if (get->state == NEX_GET_WAITING && millis() - get->start > get->timeout)
+        {
+            get->state = NEX_GET_LATE;
+            get->start = millis();
+            ok = false;
+        }
+        else if (get->state == NEX_GET_DONE || get->state == NEX_GET_FAILED)
+        {
+            ok = (get->state == NEX_GET_DONE);
+            get->state = NEX_GET_FINISHED;
+        }
+        else
+        {
+            continue;
+        }
+        callback = get->callback;
+        if (callback)
+        {
+            callback(get->ptr, ok, ok ? get->number : 0);
+        }
+    }
+/*
+ * then remove the oldest, once finished or too late for their reply
+ */
+    while (nexGetCount != 0)
+    {
+        get = &nexGetQueue[nexGetHead];
+        if (get->state != NEX_GET_FINISHED
+            && !(get->state == NEX_GET_LATE && millis() - get->start > NEX_GET_LATE_MS))
+        {
+            break;
+        }
+        nexGetHead = (nexGetHead + 1) % NEX_GET_QUEUE_SIZE;
+        nexGetCount--;
+    }
+}
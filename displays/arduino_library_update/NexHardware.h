@@ -23,6 +23,25 @@
  * @{ 
  */
 
+/**
+ * Command builder state, for nexCmdBegin() etc. 
+ */
+struct NexCmdBuilder
+{
+    uint8_t len;                    /* characters written */
+    uint8_t cap;                    /* characters reserved */
+    bool overflow;                  /* true if the command didn't fit */
+};
+
+/**
+ * Callback type for nexGetNumberAsync(). 
+ * 
+ * @param ptr - the pointer given with the query. 
+ * @param ok - true if the number arrived, false on timeout or an error frame. 
+ * @param number - the number returned. 
+ */
+typedef void (*NexNumberCallback)(void *ptr, bool ok, uint32_t number);
+
 /**
  * Init Nextion.  
  * 
@@ -35,6 +54,10 @@ bool nexInit(long Speed = 9600);
  * 
  * Supports push and pop at present. 
  *
+ * Processes the bytes already received and returns without waiting; a frame can 
+ * arrive over several calls. All return frames are consumed: touch events call 
+ * callbacks, page numbers update nexCurrentPageId and the rest update counters. 
+ *
  * @param nex_listen_list - index to Nextion Components list. 
  * @return none. 
  *
@@ -43,6 +66,131 @@ bool nexInit(long Speed = 9600);
  */
 void nexLoop(NexTouch *nex_listen_list[]);
 
+/**
+ * Count of bytes sent to the display since power up. 
+ * 
+ * Includes the three 0xFF terminators on each command. Use the difference
+ * between two readings to find the display traffic rate. 
+ */
+extern uint32_t nexTxByteCount;
+
+/**
+ * Add a command to the display transmit queue without waiting. 
+ * 
+ * @param cmd - the command, without the 0xFF terminators. 
+ * @return true if queued, false if there is not enough space (nothing is queued). 
+ */
+bool nexTrySendCommand(const char* cmd);
+
+/**
+ * Add binary data to the display transmit queue without waiting. 
+ * 
+ * For the data of a transparent transfer ("addt"): no terminator is added. 
+ * Send it once nexRxTransparentReady is set. 
+ * 
+ * @return true if queued, false if there is not enough space (nothing is queued). 
+ */
+bool nexTrySendData(const uint8_t *data, uint16_t len);
+
+/**
+ * Build a command directly in the transmit queue, without a string buffer. 
+ * 
+ * nexCmdBegin() reserves space for maxLen characters; nexCmdChar(), nexCmdText() 
+ * and nexCmdInt() add to the command; nexCmdEnd() adds the terminator and sends it. 
+ * A command longer than maxLen is not sent. Nothing else may be sent between 
+ * nexCmdBegin() and nexCmdEnd(). 
+ * 
+ * @param wait - if true, wait for space in the queue; if false, fail if there is none. 
+ * @return nexCmdBegin: true if space reserved; nexCmdEnd: true if the command was queued. 
+ */
+bool nexCmdBegin(NexCmdBuilder *cmd, uint8_t maxLen, bool wait = false);
+void nexCmdChar(NexCmdBuilder *cmd, char c);
+void nexCmdText(NexCmdBuilder *cmd, const char *text);
+void nexCmdInt(NexCmdBuilder *cmd, int16_t value, uint8_t decimals = 0);
+bool nexCmdEnd(NexCmdBuilder *cmd);
+
+/**
+ * Pass queued bytes to the display serial port without blocking. 
+ * 
+ * @warning Call this from a periodic interrupt, at least every 1ms at 115200 baud. 
+ */
+void nexTxService(void);
+
+/**
+ * Wait until the transmit queue is empty. 
+ */
+void nexTxFlush(void);
+
+/**
+ * Free space in the transmit queue, in bytes. 
+ */
+uint16_t nexTxFree(void);
+
+/**
+ * Bytes waiting in the transmit queue. 
+ */
+uint16_t nexTxUsed(void);
+
+/**
+ * Most bytes ever waiting in the transmit queue; use to size NEX_TX_RING_SIZE. 
+ */
+extern uint16_t nexTxHighWater;
+
+/**
+ * Number of commands nexTrySendCommand() could not queue. 
+ */
+extern uint16_t nexTxRejectCount;
+
+/**
+ * Return frame counts from nexLoop(): command acks, error returns, 
+ * display (re)starts and frames with a bad terminator. 
+ */
+extern uint16_t nexRxAckCount;
+extern uint16_t nexRxErrorCount;
+extern uint16_t nexRxLaunchCount;
+extern uint16_t nexRxFrameErrorCount;
+
+/**
+ * Transparent transfer state: set by nexLoop() when the display reports 
+ * it is ready for the data (0xFE frame) and when it has all the data (0xFD). 
+ * Clear them before sending the "addt" command. 
+ */
+extern bool nexRxTransparentReady;
+extern bool nexRxTransparentDone;
+
+/**
+ * Last page number reported by the display (0x66 frame). 
+ */
+extern uint8_t nexCurrentPageId;
+
+/**
+ * Discard any partly received return frame. 
+ */
+void nexRxReset(void);
+
+/**
+ * Send a "get" query and return without waiting for the reply. 
+ * 
+ * The callback is called from nexLoop() when the number arrives, or with ok 
+ * false if the display returns an error (eg 0x1A, bad variable name) or after 
+ * the timeout. Other return frames are processed as normal meanwhile. 
+ * 
+ * @param var - the variable or attribute to read, eg "p1bt0.val". 
+ * @param callback - function called with the result. 
+ * @param ptr - passed to the callback. 
+ * @param timeout - ms to wait for the reply. 
+ * @return true if sent; false if too many queries are waiting or the transmit queue is full. 
+ */
+bool nexGetNumberAsync(const char *var, NexNumberCallback callback, void *ptr, uint16_t timeout = 100);
+
+/**
+ * Number of "get" queries still waiting to be completed by nexLoop(), 
+ * including ones that timed out whose reply may still arrive (for up to 
+ * NEX_GET_LATE_MS). A synchronous get must not be sent while any are waiting, 
+ * as the oldest waiting query takes the next number returned. 
+ */
+uint8_t nexGetPending(void);
+
 /**
  * @}
  */
@@ -0,0 +1,680 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// analogue_harness.cpp
+// test harness for the sketch's ADC code. It builds analogueio.cpp against
+// shim/Arduino.h, with the settings and meter ballistics replaced by simple
+// stand-ins. It checks the conversions from ADC readings to dBm, volts,
+// watts and VSWR against the float maths the sketch used to do, and against
+// exact maths to 0.05dB for several detector and coupler settings, then plays
+// the ADC itself to check the interrupt driven acquisition: each conversion
+// is of the input the sketch selected, and its result is passed to the
+// result ready interrupt handler. A stress test raises that "interrupt"
+// from a timer signal, so it lands anywhere in the sketch's code, and a
+// noisy low power trace is played in both ADC modes to measure the
+// resolution the readings keep. Last, a sudden high VSWR is played at every
+// point in the conversion sequence to find the worst case protection trip time.
+//
+// build (from host/):
+//   g++ -std=c++17 -O2 -Wall -Ishim -I../sketch/Log_VSWR_sketch -o analogue_harness analogue_harness.cpp
+//       shim/Arduino.cpp ../sketch/Log_VSWR_sketch/analogueio.cpp
+// run: ./analogue_harness   (exit status 0 if every check passes)
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "globalinclude.h"
+#include "analogueio.h"
+#include "ballistics.h"
+#include "configdata.h"
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <ctime>
+#include <random>
+#include <string>
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// stand-ins for the rest of the sketch
+//
+byte GBandInUse = e20m;
+bool GOversampleInUse;
+CalibrationSet GCalibrationSets[VNUMBANDS];
+ProtectionParams GProtection;
+DetectorParams GDetector;
+
+void BallisticsInit(void) {}
+void BallisticsTick(unsigned int, unsigned int, unsigned int, unsigned int) {}
+
+//
+// the conversions in analogueio.cpp, which its header doesn't declare
+//
+long GetdBmQ8(unsigned int Reading);
+int GetTenthdBm(long dBmQ8);
+unsigned int GetLineVoltageTenth(long dBmQ8);
+unsigned int GetLinePowerTenth(long dBmQ8);
+unsigned int GetVSWR(long FwddBmQ8, long RevdBmQ8);
+unsigned long Exp2Q12(long Exponent);
+extern unsigned int GFwdAvgPowerTenth, GFwdPeakPowerTenth;
+extern unsigned int GConversionSequence;
+extern unsigned int GSamplesLost, GBlocksTorn;
+extern PORT_t* GTripPort;
+extern byte GTripPinMask;
+
+
+//
+// the default settings (configdata.cpp): a 50dB coupler and a detector giving
+// -96dBm at code 0 and 0.1253dB per code, with no correction
+//
+void DefaultSettings(void)
+{
+  for (CalibrationSet& Set : GCalibrationSets)
+  {
+    Set.CouplingQ8 = 50 * 256;
+    memset(Set.Correction, 0, sizeof(Set.Correction));
+  }
+  GDetector.dBScaleQ20 = 131387;
+  GDetector.dBmOffsetQ8 = -96 * 256;
+  GProtection = {0, 30, 2, 0, 25};
+  GBandInUse = e20m;
+  GOversampleInUse = false;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// the sketch's old float conversions, from a whole ADC code
+// (the line voltage came from a table of floats worked out for each code)
+//
+struct FloatReading
+{
+  int TenthdBm;
+  float Voltage;
+  unsigned int VoltageTenth;
+  unsigned int PowerTenth;
+};
+
+FloatReading FloatConvert(int Code)
+{
+  FloatReading R;
+  float Power;
+
+  R.TenthdBm = (int)((-96.0f + (float)Code * 0.1253f + 50.0f) * 10.0f);
+  R.Voltage = (float)sqrt(50.0 * pow(10.0, (-96.0 + Code * 0.1253 + 50.0 - 30.0) / 10.0));
+  R.VoltageTenth = (unsigned int)(R.Voltage * 10.0f);
+  Power = 10.0f * R.Voltage * R.Voltage / 50.0f;
+  R.PowerTenth = Power > 60000.0f ? 60000 : (unsigned int)Power;
+  return R;
+}
+
+unsigned int FloatVSWR(float FwdVoltage, float RevVoltage)
+{
+  if (FwdVoltage < 0.1f)
+    return 10;
+  if (FwdVoltage == RevVoltage)
+    return 9999;
+  return (unsigned int)fabs(10.0f * (FwdVoltage + RevVoltage) / (FwdVoltage - RevVoltage));
+}
+
+
+int Failures;
+
+void Check(bool Ok, const std::string& What)
+{
+  printf("%s  %s\n", Ok ? "pass" : "FAIL", What.c_str());
+  if (!Ok)
+    Failures++;
+}
+
+//
+// the amount by which an integer result is further from the float one than one LSB, in dB
+// (Scale is 10 for a power, 20 for a voltage)
+//
+double ExcessdB(unsigned int Value, double Expected, double Scale)
+{
+  double Difference = fabs(Value - Expected);
+  if (Difference <= 1.0)
+    return 0.0;
+  return Scale * log10(1.0 + (Difference - 1.0) / Expected);
+}
+
+
+//
+// golden test: every ADC code through the integer conversions and the old float ones
+//
+void GoldenTest(void)
+{
+  int WorstdBm = 0, WorstVSWR = 0;
+  double WorstVoltage = 0.0, WorstPower = 0.0;
+  int WorstVSWRCode = 0;
+
+  DefaultSettings();
+  AnalogueIOInit();
+  for (int Code = 0; Code < 1024; Code++)
+  {
+    FloatReading F = FloatConvert(Code);
+    long dBmQ8 = GetdBmQ8(Code << 4);
+    WorstdBm = std::max(WorstdBm, abs(GetTenthdBm(dBmQ8) - F.TenthdBm));
+    WorstVoltage = std::max(WorstVoltage, ExcessdB(GetLineVoltageTenth(dBmQ8), F.VoltageTenth, 20.0));
+    if (F.PowerTenth < 60000)
+      WorstPower = std::max(WorstPower, ExcessdB(GetLinePowerTenth(dBmQ8), F.PowerTenth, 10.0));
+    else
+      WorstPower = std::max(WorstPower, GetLinePowerTenth(dBmQ8) == 60000 ? 0.0 : 99.0);
+  }
+  printf("      worst beyond one LSB: voltage %.4fdB, power %.4fdB\n", WorstVoltage, WorstPower);
+  Check(WorstdBm <= 1, "tenths of dBm within one LSB for every code");
+  Check(WorstVoltage < 0.01, "line voltage within one LSB (or 0.01dB) for every code");
+  Check(WorstPower < 0.01, "line power within one LSB (or 0.01dB) for every code, clipped the same");
+
+//
+// VSWR from a forward code and every reverse code below it, from 1.1:1 to 20:1
+// (a difference of one code is 138:1, where the float result was down to rounding noise)
+//
+  for (int Fwd = 400; Fwd < 1024; Fwd += 41)
+    for (int Rev = 0; Rev < Fwd; Rev++)
+    {
+      FloatReading F = FloatConvert(Fwd), R = FloatConvert(Rev);
+      unsigned int Expected = FloatVSWR(F.Voltage, R.Voltage);
+      if (Expected > 200)
+        continue;
+      unsigned int VSWR = GetVSWR(GetdBmQ8(Fwd << 4), GetdBmQ8(Rev << 4));
+      int Error = abs((int)VSWR - (int)Expected);
+      if (Error > WorstVSWR)
+      {
+        WorstVSWR = Error;
+        WorstVSWRCode = Fwd - Rev;
+      }
+    }
+  printf("      worst VSWR error %d tenths, at a code difference of %d\n", WorstVSWR, WorstVSWRCode);
+  Check(WorstVSWR <= 1, "VSWR within one LSB up to 20:1");
+}
+
+
+//
+// accuracy sweep: every reading (1/16 code) against exact maths, for detector slopes
+// and coupler losses either side of the defaults. Volts and watts must be within
+// 0.05dB, beyond the one LSB lost by rounding down to an integer.
+//
+void AccuracyTest(void)
+{
+  const unsigned long Scales[] = {104858, 131387, 157286};  // 0.1, 0.1253, 0.15dB per code
+  const int Couplings[] = {30, 40, 50};
+  double WorstExp2 = 0.0, WorstdBm = 0.0, WorstVoltage = 0.0, WorstPower = 0.0;
+  bool Clipped = true;
+
+//
+// the power of 2 evaluator on its own, over the range the conversions use
+//
+  for (long Exponent = -14 * 4096; Exponent < 32 * 4096; Exponent++)
+  {
+    unsigned long Value = Exp2Q12(Exponent);
+    double Exact = pow(2.0, Exponent / 4096.0);
+    if (Exact >= 4294967295.0)
+      continue;
+    WorstExp2 = std::max(WorstExp2, ExcessdB((unsigned int)std::min(Value, 0xFFFFFFFFUL), Exact, 20.0));
+  }
+
+  for (unsigned long Scale : Scales)
+    for (int Coupling : Couplings)
+    {
+      DefaultSettings();
+      GDetector.dBScaleQ20 = Scale;
+      GCalibrationSets[GBandInUse].CouplingQ8 = Coupling * 256;
+      AnalogueIOInit();
+      for (unsigned int Reading = 0; Reading < 1024 * 16; Reading++)
+      {
+        long dBmQ8 = GetdBmQ8(Reading);
+        double dBm = -96.0 + Reading / 16.0 * Scale / 1048576.0 + Coupling;
+        double Voltage = 10.0 * sqrt(50.0 * pow(10.0, (dBm - 30.0) / 10.0));
+        double Power = pow(10.0, (dBm - 20.0) / 10.0);
+        WorstdBm = std::max(WorstdBm, fabs(dBmQ8 / 256.0 - dBm));
+        WorstVoltage = std::max(WorstVoltage, ExcessdB(GetLineVoltageTenth(dBmQ8), Voltage, 20.0));
+        if (Power < 60000.0)
+          WorstPower = std::max(WorstPower, ExcessdB(GetLinePowerTenth(dBmQ8), Power, 10.0));
+        else if (GetLinePowerTenth(dBmQ8) != 60000)
+          Clipped = false;
+      }
+    }
+  printf("      worst error: power of 2 %.4fdB; dBm %.4fdB; beyond one LSB: voltage %.4fdB, power %.4fdB\n",
+         WorstExp2, WorstdBm, WorstVoltage, WorstPower);
+  Check(WorstExp2 < 0.0025, "power of 2 evaluator within 0.0025dB");
+  Check(WorstdBm < 0.01, "line dBm within 0.01dB for every reading");
+  Check(WorstVoltage < 0.05 && WorstPower < 0.05, "line voltage and power within 0.05dB for every reading");
+  Check(Clipped, "power clipped to 6000W");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// the mock ADC
+// InputCode[] holds the level on each input (0 forward, 1 reverse) in ADC codes, and
+// InputNoise the RMS noise added to each sample. At StepTime (us) the inputs step to
+// StepCode[]. A conversion must have been started by the sketch; it converts the input
+// MUXPOS selects, summed 16 times if CTRLB selects accumulation, then calls the interrupt
+// handler. A conversion takes 60us, or 240us accumulating (13 ADC clocks at 250KHz, or
+// 16 x 13 at 1MHz, plus the interrupt); each sample is taken at the start of its 13 clocks.
+//
+double InputCode[2];
+double InputNoise;
+double StepTime = INFINITY, StepCode[2];
+double AdcTime;                                 // us, when the next conversion starts
+std::mt19937 NoiseSource(3);
+unsigned Conversions, NotStarted;
+
+unsigned int Sample(unsigned Input, double Time)
+{
+  std::normal_distribution<double> Noise(0.0, InputNoise);
+  double Level = (Time >= StepTime ? StepCode[Input] : InputCode[Input])
+                 + (InputNoise > 0.0 ? Noise(NoiseSource) : 0.0);
+  return (unsigned int)std::min(std::max(floor(Level + 0.5), 0.0), 1023.0);
+}
+
+void Convert(void)
+{
+  unsigned Input = (ADC0.MUXPOS >> ADC_MUXPOS_gp) & 1;
+  unsigned int Result = 0;
+
+  if (!(ADC0.COMMAND & ADC_STCONV_bm))
+    NotStarted++;
+  ADC0.COMMAND = 0;
+  if (ADC0.CTRLB == ADC_SAMPNUM_ACC16_gc)
+  {
+    for (int i = 0; i < 16; i++)
+      Result += Sample(Input, AdcTime + i * 15.0);
+    AdcTime += 240.0;
+  }
+  else
+  {
+    Result = Sample(Input, AdcTime);
+    AdcTime += 60.0;
+  }
+  ADC0.RES = Result;
+  Conversions++;
+  ADC0_RESRDY_vect();
+}
+
+void Convert(unsigned Count)
+{
+  while (Count--)
+    Convert();
+}
+
+//
+// run the ADC for a time: as many conversions as fit, carrying part conversions over
+//
+unsigned long ConversionCarry;
+
+void ConvertFor(unsigned long Us)
+{
+  ConversionCarry += Us;
+  for (;;)
+  {
+    unsigned long Time = (ADC0.CTRLB == ADC_SAMPNUM_ACC16_gc) ? 240 : 60;
+    if (ConversionCarry < Time)
+      break;
+    ConversionCarry -= Time;
+    Convert();
+  }
+}
+
+int TenthdBm(unsigned int Code)
+{
+  return GetTenthdBm(GetdBmQ8(Code << 4));
+}
+
+//
+// the input level for a line power, with the default settings
+//
+double CodeFordBm(double dBm)
+{
+  return (dBm + 96.0 - 50.0) / 0.1253;
+}
+
+
+//
+// the acquisition: results go to the right input's sample block, and the
+// tick takes the block while the interrupt carries on in the other one
+//
+void AcquisitionTest(void)
+{
+  TelemetryData Telemetry;
+  unsigned long Processed;
+
+  DefaultSettings();
+  AnalogueIOInit();
+  AnalogueIOTick();                             // empty the blocks
+  Check((ADC0.CTRLA & ADC_ENABLE_bm) && (ADC0.INTCTRL & ADC_RESRDY_bm) && CPUINT.LVL1VEC == ADC0_RESRDY_vect_num,
+        "ADC enabled with a high priority result ready interrupt");
+  Check(ADC0.MUXPOS == 0 && (ADC0.COMMAND & ADC_STCONV_bm), "first conversion started on the forward input");
+
+  InputCode[0] = 800;
+  InputCode[1] = 500;
+  Processed = GSamplesProcessed;
+  Conversions = NotStarted = 0;
+  Convert(334);                                 // one 20ms tick at 60us a conversion
+  AnalogueIOTick();
+  Check(NotStarted == 0, "every result starts the next conversion");
+  Check(GForwardTenthdBm == TenthdBm(800) && GReverseTenthdBm == TenthdBm(500),
+        "forward and reverse results go to their own input");
+  Check(GSamplesProcessed - Processed == 334 && GSamplesLost == 0, "every conversion used, none lost");
+  Check(ADC0.MUXPOS == 0, "inputs alternate: forward next after an even number");
+
+//
+// the block the tick takes holds only what was converted since the last tick
+//
+  InputCode[0] = 300;
+  Convert(100);
+  AnalogueIOTick();
+  Check(GForwardTenthdBm == TenthdBm(300), "next tick has only the new readings");
+  AnalogueIOTick();
+  Check(GForwardTenthdBm == TenthdBm(0) && GFwdAvgPowerTenth == 0, "a tick with no conversions reads zero");
+
+//
+// average and peak from the same block
+//
+  InputCode[0] = 400;
+  Convert(98);
+  InputCode[0] = 900;
+  Convert(2);                                   // one forward, one reverse sample
+  InputCode[0] = 400;
+  AnalogueIOTick();
+  Check(GFwdPeakPowerTenth == GetLinePowerTenth(GetdBmQ8(900 << 4)), "peak from the single high sample");
+  Check(GForwardTenthdBm == GetTenthdBm(GetdBmQ8((49 * 400 + 900) * 16 / 50)), "average over all 50 forward samples");
+
+//
+// telemetry blocks are filled alongside, and claimed on their own
+//
+  AnalogueIOEnableTelemetry(true);
+  InputCode[0] = 700;
+  InputCode[1] = 200;
+  Convert(40);
+  AnalogueIOTick();
+  Convert(20);
+  AnalogueIOGetTelemetry(&Telemetry);
+  Check(Telemetry.FwdCount == 30 && Telemetry.RevCount == 30, "telemetry block holds conversions across ticks");
+  Check(Telemetry.FwdSum == 30UL * 700 * 16 && Telemetry.FwdPeak == 700 * 16 && Telemetry.FwdTenthdBm == TenthdBm(700),
+        "telemetry sums and values");
+  Convert(10);
+  AnalogueIOGetTelemetry(&Telemetry);
+  Check(Telemetry.FwdCount == 5 && Telemetry.EndSequence == GConversionSequence, "next telemetry claim starts afresh");
+  AnalogueIOEnableTelemetry(false);
+  AnalogueIOTick();
+}
+
+
+//
+// stress test: conversions interrupting the sketch at random points
+// a timer signals every 20us (a little faster than the ADC), and the signal handler does a
+// conversion. Like the ADC interrupt on the AVR it can land anywhere in AnalogueIOTick()
+// or AnalogueIOGetTelemetry(), and can't itself be interrupted by them. (A thread
+// signalling this one would do the same, but with one CPU it only runs every few ms.)
+// every conversion must be counted by the tick once, and be in one telemetry frame.
+//
+volatile sig_atomic_t InSketch;                 // set while the sketch's code is running
+unsigned long InterruptsInSketch;
+unsigned long long FwdSumConverted, RevSumConverted;
+
+void ConversionSignal(int)
+{
+  if (InSketch)
+    InterruptsInSketch++;
+  InputCode[0] = (Conversions * 7) & 1023;      // every reading different
+  InputCode[1] = (Conversions * 3) & 511;
+  if ((ADC0.MUXPOS >> ADC_MUXPOS_gp) & 1)
+    RevSumConverted += (unsigned)InputCode[1] * 16;
+  else
+    FwdSumConverted += (unsigned)InputCode[0] * 16;
+  Convert();
+}
+
+void StressTest(void)
+{
+  TelemetryData Telemetry;
+  timer_t Timer;
+  sigevent Event = {};
+  itimerspec Period = {{0, 20000}, {0, 20000}}, Off = {};
+  unsigned long Processed, Ticks = 0, Claims = 0;
+  unsigned long long TelemetrySamples = 0, FwdSum = 0, RevSum = 0;
+  unsigned int Lost, Torn;
+
+  DefaultSettings();
+  AnalogueIOInit();
+  AnalogueIOTick();
+  AnalogueIOTick();
+  AnalogueIOEnableTelemetry(true);
+  Processed = GSamplesProcessed;
+  Lost = GSamplesLost;
+  Torn = GBlocksTorn;
+  Conversions = NotStarted = 0;
+  signal(SIGALRM, ConversionSignal);
+  Event.sigev_notify = SIGEV_SIGNAL;
+  Event.sigev_signo = SIGALRM;
+  if (timer_create(CLOCK_MONOTONIC, &Event, &Timer) != 0)
+  {
+    perror("timer_create");
+    Failures++;
+    return;
+  }
+  timer_settime(Timer, 0, &Period, nullptr);
+
+  auto End = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+  while (std::chrono::steady_clock::now() < End)
+  {
+    InSketch = 1;
+    AnalogueIOTick();
+    if (++Ticks % 8 == 0)
+    {
+      AnalogueIOGetTelemetry(&Telemetry);
+      Claims++;
+      TelemetrySamples += Telemetry.FwdCount + Telemetry.RevCount;
+      FwdSum += Telemetry.FwdSum;
+      RevSum += Telemetry.RevSum;
+    }
+    InSketch = 0;
+  }
+  timer_settime(Timer, 0, &Off, nullptr);
+  timer_delete(Timer);
+  signal(SIGALRM, SIG_IGN);                     // drops one still pending
+  AnalogueIOTick();                             // collect the last samples
+  AnalogueIOGetTelemetry(&Telemetry);
+  TelemetrySamples += Telemetry.FwdCount + Telemetry.RevCount;
+  FwdSum += Telemetry.FwdSum;
+  RevSum += Telemetry.RevSum;
+  AnalogueIOEnableTelemetry(false);
+
+  printf("      %u conversions in %lu ticks and %lu telemetry claims, %lu of them during sketch code\n",
+         Conversions, Ticks, Claims, InterruptsInSketch);
+  Check(InterruptsInSketch > 1000, "conversions landed inside the tick and telemetry claims");
+  Check(GSamplesProcessed - Processed == Conversions && GSamplesLost == Lost && GBlocksTorn == Torn,
+        "tick used every conversion once: none lost, no torn blocks");
+  Check(TelemetrySamples == Conversions && FwdSum == FwdSumConverted && RevSum == RevSumConverted,
+        "telemetry frames hold every conversion once, with the right sums");
+  Check(NotStarted == 0, "every result started the next conversion");
+}
+
+
+//
+// resolution at low power: a slow ramp from 0.25W to 2.5W (ADC codes 560 to 640) over
+// 40s, with 0.5 code RMS of noise on every sample, played in both ADC modes.
+// each tick's averaged reading is compared with the input level, and with what the
+// old code made of the same samples: it divided the summed whole codes by the count,
+// throwing away the fraction the averaging had gained.
+//
+struct TraceResult
+{
+  double ReadingRMS;                            // codes
+  double PowerWrong;                            // fraction of ticks not showing the right 0.1W
+  unsigned long Samples;
+};
+
+void TraceTest(bool Oversample, TraceResult& New, TraceResult& Old)
+{
+  TelemetryData Telemetry;
+  double NewSquares = 0.0, OldSquares = 0.0;
+  unsigned NewWrong = 0, OldWrong = 0;
+  const int Ticks = 2000;
+
+  DefaultSettings();
+  AnalogueIOInit();
+  AnalogueIOSetOversampling(Oversample);
+  InputNoise = 0.5;
+  InputCode[0] = InputCode[1] = 560.0;
+  ConvertFor(1000);                             // settle into the mode
+  AnalogueIOTick();
+  AnalogueIOEnableTelemetry(true);              // for the sums of each tick's samples
+  New.Samples = 0;
+  for (int Tick = 0; Tick < Ticks; Tick++)
+  {
+    InputCode[0] = 560.0 + 80.0 * Tick / Ticks;
+    ConvertFor(20000);
+    AnalogueIOTick();
+    AnalogueIOGetTelemetry(&Telemetry);
+    New.Samples += Telemetry.FwdCount;
+//
+// the reading the sketch carries (1/16 code), and the old whole code one
+//
+    unsigned int Reading = (unsigned int)(Telemetry.FwdSum / Telemetry.FwdCount);
+    unsigned int OldCode = (unsigned int)(Telemetry.FwdSum / 16 / Telemetry.FwdCount);
+    unsigned int Power = (unsigned int)pow(10.0, (-96.0 + InputCode[0] * 0.1253 + 50.0 - 20.0) / 10.0);
+    NewSquares += pow(Reading / 16.0 - InputCode[0], 2);
+    OldSquares += pow(OldCode - InputCode[0], 2);
+    NewWrong += GFwdAvgPowerTenth != Power;
+    OldWrong += GetLinePowerTenth(GetdBmQ8(OldCode << 4)) != Power;
+  }
+  AnalogueIOEnableTelemetry(false);
+  AnalogueIOSetOversampling(false);
+  ConvertFor(1000);
+  InputNoise = 0.0;
+  New.ReadingRMS = sqrt(NewSquares / Ticks);
+  New.PowerWrong = (double)NewWrong / Ticks;
+  Old.ReadingRMS = sqrt(OldSquares / Ticks);
+  Old.PowerWrong = (double)OldWrong / Ticks;
+  New.Samples /= Ticks;
+}
+
+void ResolutionTest(void)
+{
+  TraceResult Normal, Oversampled, Old, OldUnused;
+
+  TraceTest(false, Normal, Old);
+  TraceTest(true, Oversampled, OldUnused);
+  printf("      0.25-2.5W, 0.5 code noise: reading error RMS (codes), ticks not showing the right 0.1W\n");
+  printf("        old, whole codes      %6.3f  %5.1f%%  (%lu samples a tick)\n", Old.ReadingRMS,
+         100.0 * Old.PowerWrong, Normal.Samples);
+  printf("        normal                %6.3f  %5.1f%%  %.1f bits gained\n", Normal.ReadingRMS,
+         100.0 * Normal.PowerWrong, log2(Old.ReadingRMS / Normal.ReadingRMS));
+  printf("        oversampling          %6.3f  %5.1f%%  %.1f bits gained (%lu results a tick)\n",
+         Oversampled.ReadingRMS, 100.0 * Oversampled.PowerWrong, log2(Old.ReadingRMS / Oversampled.ReadingRMS),
+         Oversampled.Samples);
+  Check(Normal.ReadingRMS < Old.ReadingRMS / 4, "averaged reading keeps 2 bits more than whole codes");
+  Check(Oversampled.ReadingRMS < Old.ReadingRMS / 4, "oversampled reading keeps 2 bits more than whole codes");
+  Check(Normal.PowerWrong < Old.PowerWrong / 2 && Oversampled.PowerWrong < Old.PowerWrong / 2,
+        "2W scale shows the right power at least twice as often");
+}
+
+
+//
+// protection trip time: forward at 500W with a good match (1.1:1), then the reverse
+// steps up to give 5:1 (return loss 3.5dB). The step is played at every 5us through
+// two conversion periods, and the time from the step to the result ready interrupt
+// that sets the trip output is measured. The AVR's interrupt latency (a few us) isn't
+// included. The inputs take turns, so the worst case is 3 conversions: the step
+// just misses a reverse conversion, then the forward one, then the next reverse.
+//
+double WorstTripTime(bool Oversample, bool& AlwaysTripped)
+{
+  double Worst = 0.0, Period = Oversample ? 240.0 : 60.0;
+  const double FwdCode = CodeFordBm(57.0), RevCode = CodeFordBm(57.0 - 26.4), FaultCode = CodeFordBm(57.0 - 3.52);
+
+  AlwaysTripped = true;
+  for (double Offset = 0.0; Offset < 2 * Period; Offset += 5.0)
+  {
+    DefaultSettings();
+    GProtection = {VPROTECTENABLE | VPROTECTLATCH, 30, 2, 30, 25};
+    AnalogueIOInit();
+    AnalogueIOSetOversampling(Oversample);
+    InputCode[0] = StepCode[0] = FwdCode;
+    InputCode[1] = RevCode;
+    StepCode[1] = FaultCode;
+    Convert(20);                                // settle into the mode
+    AnalogueIOResetTrip();
+    Convert(20);
+    if (GTripped)
+    {
+      AlwaysTripped = false;                    // tripped without the fault
+      break;
+    }
+    StepTime = AdcTime + Offset;
+    PORTA.OUTSET = 0;
+    while (!GTripped && AdcTime < StepTime + 10 * Period)
+      Convert();
+    if (!GTripped || !(PORTA.OUTSET & GTripPinMask))
+      AlwaysTripped = false;
+    Worst = std::max(Worst, AdcTime - StepTime);
+    StepTime = INFINITY;
+  }
+  AnalogueIOSetOversampling(false);
+  Convert(4);
+  return Worst;
+}
+
+void TripTest(void)
+{
+  bool Tripped, OversampleTripped;
+  unsigned int Trips;
+
+  double Normal = WorstTripTime(false, Tripped);
+  double Oversampled = WorstTripTime(true, OversampleTripped);
+  printf("      worst trip time %.0fus, %.0fus oversampling\n", Normal, Oversampled);
+  Check(Tripped && OversampleTripped, "5:1 trips the output, wherever the step lands");
+  Check(Normal <= 3 * 60.0 && Oversampled <= 3 * 240.0, "within 3 conversions: 180us, 720us oversampling");
+
+//
+// what shouldn't trip, and what happens after a trip
+//
+  DefaultSettings();
+  GProtection = {VPROTECTENABLE, 30, 2, 30, 2};
+  AnalogueIOInit();
+  AnalogueIOResetTrip();
+  Trips = GTripCount;
+  InputCode[0] = CodeFordBm(57.0);
+  InputCode[1] = CodeFordBm(57.0 - 9.54) - 2;   // just under 2:1
+  Convert(100);
+  Check(!GTripped, "2:1 doesn't trip a 3:1 threshold");
+  InputCode[0] = CodeFordBm(0.0);               // below the 30dBm minimum
+  InputCode[1] = CodeFordBm(0.0) - 1;
+  Convert(100);
+  Check(!GTripped, "no trip below the minimum forward power");
+  InputCode[0] = CodeFordBm(57.0);
+  InputCode[1] = CodeFordBm(57.0 - 3.52);
+  Convert(100);
+  Check(GTripped && GTripCount == Trips + 1, "trip counted once, however many samples are over");
+  InputCode[1] = CodeFordBm(57.0 - 26.4);
+  PORTA.OUTCLR = 0;
+  for (int Tick = 0; Tick < 4 && GTripped; Tick++)
+  {
+    Convert(334);
+    AnalogueIOTick();
+  }
+  Check(!GTripped && (PORTA.OUTCLR & GTripPinMask), "unlatched trip resets after the reset delay");
+  GProtection.Flags = 0;
+  AnalogueIOSetProtection();
+}
+
+
+int main(void)
+{
+  GoldenTest();
+  AccuracyTest();
+  AcquisitionTest();
+  StressTest();
+  ResolutionTest();
+  TripTest();
+
+  printf("\n%s: %d failure(s)\n", Failures ? "FAILED" : "passed", Failures);
+  return Failures ? 1 : 0;
+}
@@ -0,0 +1,357 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// bridge_logd.cpp
+// long running capture of bridge telemetry into a chunked columnar log
+// (columnlog.h), for burn-in and antenna monitoring. At 500 frames/s a
+// CSV log grows by ~40MB an hour; this is typically well under a tenth
+// of that.
+//
+// usage: bridge_logd [-r rate] [-b baud] [-c rows] [-f seconds] [-v] -o log input
+//   -o  log file: created if new, appended to if not
+//   -r  ask the bridge for this many frames per second
+//   -b  serial rate (default 500000)
+//   -c  rows per chunk (default 4096)
+//   -f  write a part chunk after this many seconds (default 10), so a crash
+//       or power cut loses little, even at low frame rates
+//   -v  print statistics every minute
+//   input is the bridge's serial port (or a pty), or a file holding a
+//   capture of the serial stream, which is read to the end.
+//
+// each row is timestamped from the bridge's own microsecond clock, anchored
+// to the PC clock at the first frame. The bridge's clock is only good to
+// about 1%, so the anchor follows the PC clock over ~10s, taking the earliest
+// arrivals as the truth so that USB delays and slow disk writes don't show;
+// if the two are more than 2s apart (or the bridge restarts) it is anchored
+// again. If the port goes
+// away (USB unplugged) it is reopened once a second until it comes back.
+// SIGINT or SIGTERM writes the last part chunk and exits.
+/////////////////////////////////////////////////////////////////////////
+
+#include "bridgeproto.h"
+#include "columnlog.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <poll.h>
+#include <signal.h>
+#include <thread>
+
+using namespace bridge;
+using namespace columnlog;
+
+static volatile sig_atomic_t Stop = 0;
+constexpr int64_t ReanchorMicros = 2000000;
+constexpr int64_t FollowMicros = 10000000;
+
+
+static int64_t WallMicros(void)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static double SteadySeconds(void)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//
+// turns the bridge's 32 bit micros() and 16 bit sequence number into
+// wall clock time and an unwrapped sequence
+//
+class FrameClock
+{
+public:
+  bool FollowWallClock = true;                      // false for a capture file
+  uint64_t Reanchors = 0;
+
+  void Add(const Telemetry& T, int64_t (&Row)[NumColumns])
+  {
+    int64_t Now = WallMicros();
+    bool Anchor = !Started;
+    if (Started)
+    {
+      uint32_t Step = T.Micros - LastMicros;
+      if (Step > 0x80000000u)                       // went backwards: the bridge restarted
+      {
+        Anchor = true;
+        Sequence++;                                 // gap unknown: keep the sequence rising
+      }
+      else
+      {
+        BridgeMicros += Step;
+        Sequence += (uint16_t)(T.Sequence - LastSequence);
+        if (FollowWallClock)
+        {
+          int64_t Lag = Now - (AnchorTime + BridgeMicros);
+          if (std::llabs(Lag) > ReanchorMicros)
+            Anchor = true;                          // PC clock stepped, or a long stall
+          else if (Lag < 0)
+            AnchorTime += Lag;                      // the quickest delivery so far
+          else
+            AnchorTime += Lag * std::min<int64_t>(Step, FollowMicros) / FollowMicros;
+        }
+      }
+    }
+    if (Anchor)
+    {
+      if (Started)
+        Reanchors++;
+      AnchorTime = (FollowWallClock || LastTime == 0) ? Now : LastTime + 1;
+      BridgeMicros = 0;
+      Started = true;
+    }
+    LastMicros = T.Micros;
+    LastSequence = T.Sequence;
+    LastTime = std::max(AnchorTime + BridgeMicros, LastTime + 1);
+    Row[Time] = LastTime;
+    Row[columnlog::Sequence] = Sequence;
+  }
+
+  // carry on from the end of an existing log
+  void Continue(int64_t Time, int64_t LastSequence)
+  {
+    LastTime = Time;
+    Sequence = LastSequence + 1;
+  }
+
+  // the port was reopened: anchor again on the next frame
+  void Restart(void)
+  {
+    if (Started)
+    {
+      Reanchors++;
+      Sequence++;
+    }
+    Started = false;
+  }
+
+private:
+  bool Started = false;
+  int64_t AnchorTime = 0, BridgeMicros = 0, LastTime = 0;
+  int64_t Sequence = 0;
+  uint32_t LastMicros = 0;
+  uint16_t LastSequence = 0;
+};
+
+
+//
+// the log file being appended to
+//
+class LogWriter
+{
+public:
+  uint64_t Chunks = 0, Rows = 0, Bytes = 0;
+  bool Appending = false;
+  int64_t LastTime = 0, LastSequence = 0;             // of the existing log
+
+  bool Open(const std::string& Path)
+  {
+    struct stat St;
+    if (stat(Path.c_str(), &St) == 0 && St.st_size > 0)
+    {
+      Reader Existing;
+      if (!Existing.Open(Path, true))
+      {
+        fprintf(stderr, "%s\n", Existing.Error.c_str());
+        return false;
+      }
+      if (Existing.GoodBytes < Existing.FileBytes)
+      {
+        fprintf(stderr, "%s: removing %llu bytes of incomplete chunk at the end\n", Path.c_str(),
+                (unsigned long long)(Existing.FileBytes - Existing.GoodBytes));
+        if (truncate(Path.c_str(), (off_t)Existing.GoodBytes) != 0)
+        {
+          perror(Path.c_str());
+          return false;
+        }
+      }
+      if (!Existing.Chunks.empty())
+      {
+        Appending = true;
+        LastTime = Existing.Chunks.back().Index[Time].Max;
+        LastSequence = Existing.Chunks.back().Index[Sequence].Max;
+      }
+      Fd = open(Path.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+    }
+    else
+    {
+      Fd = open(Path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+      if (Fd >= 0 && !WriteAll(Fd, EncodeFileHeader(WallMicros())))
+        return false;
+    }
+    if (Fd < 0)
+      perror(Path.c_str());
+    return Fd >= 0;
+  }
+
+  //
+  // write the rows collected so far as a chunk, in one write, and make sure it's on disk
+  //
+  bool Flush(ChunkBuilder& Chunk)
+  {
+    if (Chunk.Rows() == 0)
+      return true;
+    Rows += Chunk.Rows();
+    std::vector<uint8_t> Data = Chunk.Encode();
+    if (!WriteAll(Fd, Data))
+    {
+      perror("log write");
+      return false;
+    }
+    fdatasync(Fd);
+    Chunks++;
+    Bytes += Data.size();
+    return true;
+  }
+
+private:
+  int Fd = -1;
+};
+
+
+int main(int argc, char** argv)
+{
+  std::string LogPath;
+  int Rate = -1;
+  long Baud = DefaultBaud;
+  size_t ChunkRows = 4096;
+  double FlushSeconds = 10.0;
+  bool Verbose = false;
+
+  int Opt;
+  while ((Opt = getopt(argc, argv, "o:r:b:c:f:v")) != -1)
+  {
+    switch (Opt)
+    {
+    case 'o': LogPath = optarg; break;
+    case 'r': Rate = atoi(optarg); break;
+    case 'b': Baud = atol(optarg); break;
+    case 'c': ChunkRows = std::clamp<size_t>(strtoul(optarg, nullptr, 0), 1, MaxChunkRows); break;
+    case 'f': FlushSeconds = atof(optarg); break;
+    case 'v': Verbose = true; break;
+    default: optind = argc + 1; break;
+    }
+  }
+  if (optind != argc - 1 || LogPath.empty() || Rate > (int)MaxRate)
+  {
+    fprintf(stderr, "usage: %s [-r rate] [-b baud] [-c rows] [-f seconds] [-v] -o log input\n", argv[0]);
+    return 1;
+  }
+  std::string InputPath = argv[optind];
+  signal(SIGINT, [](int) { Stop = 1; });
+  signal(SIGTERM, [](int) { Stop = 1; });
+  signal(SIGPIPE, SIG_IGN);
+
+  LogWriter Log;
+  if (!Log.Open(LogPath))
+    return 1;
+
+  struct stat St;
+  bool IsFile = stat(InputPath.c_str(), &St) == 0 && S_ISREG(St.st_mode);
+  FrameClock Clock;
+  Clock.FollowWallClock = !IsFile;
+  if (Log.Appending)
+    Clock.Continue(Log.LastTime, Log.LastSequence);
+  FrameReader Framer;
+  SequenceTracker Tracker;
+  ChunkBuilder Chunk;
+  uint64_t CrcErrors = 0;
+  double ChunkStart = 0.0;
+  double NextStats = SteadySeconds() + 60.0;
+  int Fd = -1;
+  bool Ok = true;
+
+  auto OnFrame = [&](const std::vector<uint8_t>& Frame) {
+    Telemetry T;
+    if (!ParseTelemetry(Frame, T))
+    {
+      CrcErrors++;                                  // console replies land here too
+      return;
+    }
+    Tracker.Add(T.Sequence);
+    int64_t Row[NumColumns];
+    Clock.Add(T, Row);
+    Row[FwdTenthdBm] = T.FwdTenthdBm;
+    Row[RevTenthdBm] = T.RevTenthdBm;
+    Row[FwdAvgPowerTenth] = T.FwdAvgPowerTenth;
+    Row[RevAvgPowerTenth] = T.RevAvgPowerTenth;
+    Row[FwdPeakPowerTenth] = T.FwdPeakPowerTenth;
+    Row[RevPeakPowerTenth] = T.RevPeakPowerTenth;
+    Row[columnlog::VSWRTenth] = T.VSWRTenth;
+    Row[columnlog::Flags] = T.Flags;
+    if (Chunk.Rows() == 0)
+      ChunkStart = SteadySeconds();
+    Chunk.Add(Row);
+    if (Chunk.Rows() >= ChunkRows)
+      Ok = Ok && Log.Flush(Chunk);
+  };
+
+  while (!Stop && Ok)
+  {
+    if (Fd < 0)
+    {
+      Fd = IsFile ? open(InputPath.c_str(), O_RDONLY | O_CLOEXEC) : OpenSerial(InputPath, Baud);
+      if (Fd < 0)
+      {
+        if (IsFile)
+        {
+          perror(InputPath.c_str());
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        continue;
+      }
+      if (!IsFile)
+        tcflush(Fd, TCIFLUSH);                      // frames left over from before are stale
+      if (!IsFile && Rate >= 0)
+        WriteAll(Fd, EncodeSetRate((unsigned)Rate));
+    }
+
+    pollfd P{Fd, POLLIN, 0};
+    if (IsFile || poll(&P, 1, 200) > 0)
+    {
+      uint8_t Buffer[8192];
+      ssize_t n = read(Fd, Buffer, sizeof(Buffer));
+      if (n > 0)
+        Framer.Feed(Buffer, (size_t)n, OnFrame);
+      else if (IsFile)
+        break;                                      // end of the capture
+      else if (n == 0 || errno != EINTR)
+      {
+        fprintf(stderr, "%s: lost the port, reopening\n", InputPath.c_str());
+        close(Fd);
+        Fd = -1;
+        Clock.Restart();
+        uint64_t Missing = Tracker.Missing;         // don't count the gap while it was away
+        Tracker = SequenceTracker();
+        Tracker.Missing = Missing;
+        Ok = Log.Flush(Chunk);
+      }
+    }
+
+    if (Chunk.Rows() != 0 && SteadySeconds() - ChunkStart >= FlushSeconds)
+      Ok = Ok && Log.Flush(Chunk);
+    if (Verbose && SteadySeconds() >= NextStats)
+    {
+      NextStats += 60.0;
+      fprintf(stderr, "rows %llu  chunks %llu  bytes %llu (%.2f per row)  missing %llu  bad frames %llu\n",
+              (unsigned long long)Log.Rows, (unsigned long long)Log.Chunks, (unsigned long long)Log.Bytes,
+              Log.Rows ? (double)Log.Bytes / Log.Rows : 0.0, (unsigned long long)Tracker.Missing,
+              (unsigned long long)(CrcErrors + Framer.BadFrames));
+    }
+  }
+
+  Ok = Log.Flush(Chunk) && Ok;
+  if (Fd >= 0)
+    close(Fd);
+  fprintf(stderr, "rows %llu  chunks %llu  bytes %llu (%.2f per row)  missing %llu  bad frames %llu  re-anchored %llu\n",
+          (unsigned long long)Log.Rows, (unsigned long long)Log.Chunks, (unsigned long long)Log.Bytes,
+          Log.Rows ? (double)Log.Bytes / Log.Rows : 0.0, (unsigned long long)Tracker.Missing,
+          (unsigned long long)(CrcErrors + Framer.BadFrames), (unsigned long long)Clock.Reanchors);
+  return Ok ? 0 : 1;
+}
@@ -0,0 +1,450 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// bridge_merge.cpp
+// reads several bridges at once (eg exciter output, amplifier output and
+// antenna switch output), puts their readings on one timeline and prints
+// merged records with the gain or loss between each bridge and the next.
+//
+// usage: bridge_merge [-r rate] [-b baud] [-t dBm] [-m ms] [-n records] [-q] name=device ...
+//   -r  ask every bridge for this many frames per second (default 500)
+//   -b  serial rate (default 500000)
+//   -t  leave the gain and loss out below this forward level (default 0dBm),
+//       where they mean nothing (the transmitter is unkeyed)
+//   -m  wait this long for a slow bridge before merging without it (default 100)
+//   -n  stop after this many records
+//   -q  no CSV, summary only
+//   name=device, in signal order: name is used in the column headings
+//
+// one CSV record is printed per frame from the first bridge: time (seconds
+// on the PC's monotonic clock), each bridge's forward and reflected dBm and
+// VSWR, interpolated to that time, then for each pair "a_b_db", the forward
+// level at b less that at a: positive is gain (an amplifier), negative is
+// loss (a feedline). A summary of each bridge goes to stderr every second.
+//
+// each port has its own reader thread, which passes frames to the merge
+// through a queue of its own, so nothing is shared between the ports and
+// the merge takes no lock.
+//
+// bridge time: each bridge's micros() is unwrapped, then mapped onto the PC's
+// clock. The bridge's clock is only good to about 1% (it runs from the
+// ATmega4809's internal oscillator), so the mapping is a straight line
+// fitted to the earliest arrival in each second over the last minute: USB
+// delays only ever make a frame late, so the earliest arrivals show the
+// true offset, and their slope shows the drift.
+/////////////////////////////////////////////////////////////////////////
+
+#include "bridgeproto.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <poll.h>
+#include <signal.h>
+#include <thread>
+
+using namespace bridge;
+
+static std::atomic<bool> Stop{false};
+constexpr int64_t BucketMicros = 1000000;          // one earliest arrival per second of bridge time
+constexpr size_t FitBuckets = 60;
+
+
+static int64_t MonotonicNanos(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+//
+// one bridge's reading, on the common timeline
+//
+struct Sample
+{
+  int64_t Time;                                     // ns, PC monotonic clock
+  int16_t FwdTenthdBm, RevTenthdBm;
+  uint16_t VSWRTenth;
+};
+
+
+//
+// single producer, single consumer queue: a port's thread to the merge
+//
+template <typename T, size_t Size>
+class SpscQueue
+{
+  static_assert((Size & (Size - 1)) == 0, "queue size must be a power of 2");
+
+public:
+  bool Push(const T& Item)
+  {
+    uint64_t Tail = Back.load(std::memory_order_relaxed);
+    if (Tail - Front.load(std::memory_order_acquire) >= Size)
+      return false;
+    Items[Tail & (Size - 1)] = Item;
+    Back.store(Tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T& Item)
+  {
+    uint64_t Head = Front.load(std::memory_order_relaxed);
+    if (Head == Back.load(std::memory_order_acquire))
+      return false;
+    Item = Items[Head & (Size - 1)];
+    Front.store(Head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  alignas(64) std::atomic<uint64_t> Front{0};
+  alignas(64) std::atomic<uint64_t> Back{0};
+  alignas(64) T Items[Size];
+};
+
+
+//
+// maps a bridge's unwrapped micros() onto the PC clock
+//
+class DriftEstimator
+{
+public:
+  double Ppm = 0.0;                                 // how fast the bridge clock runs
+
+  int64_t Map(int64_t BridgeMicros, int64_t ArrivalNanos)
+  {
+    double Offset = ArrivalNanos - BridgeMicros * 1000.0;
+    int64_t Bucket = BridgeMicros / BucketMicros;
+    Earliest = std::min(Earliest, Offset);
+    if (!HaveCurrent || Bucket != CurrentBucket)
+    {
+      if (HaveCurrent)
+        AddBucket();
+      CurrentBucket = Bucket;
+      CurrentX = BridgeMicros;
+      CurrentMin = Offset;
+      HaveCurrent = true;
+    }
+    else if (Offset < CurrentMin)
+    {
+      CurrentMin = Offset;
+      CurrentX = BridgeMicros;
+    }
+    if (Buckets.size() < 2)
+      return (int64_t)(BridgeMicros * 1000.0 + Earliest);   // until there's a line to fit
+    double x = (double)(BridgeMicros - Origin);
+    return (int64_t)(BridgeMicros * 1000.0 + Intercept + Slope * x);
+  }
+
+  void Reset(void)
+  {
+    Buckets.clear();
+    HaveCurrent = false;
+    Earliest = HUGE_VAL;
+    Ppm = 0.0;
+  }
+
+private:
+  std::deque<std::pair<int64_t, double>> Buckets;  // bridge micros, earliest arrival offset (ns)
+  int64_t CurrentBucket = 0, CurrentX = 0, Origin = 0;
+  double CurrentMin = 0.0, Earliest = HUGE_VAL;
+  bool HaveCurrent = false;
+  double Slope = 0.0, Intercept = 0.0;              // offset = Intercept + Slope * (micros - Origin)
+
+  // a second has finished: refit the line
+  void AddBucket(void)
+  {
+    Buckets.emplace_back(CurrentX, CurrentMin);
+    if (Buckets.size() > FitBuckets)
+      Buckets.pop_front();
+    if (Buckets.size() < 2)
+      return;
+    Origin = Buckets.front().first;
+    double n = (double)Buckets.size(), Sx = 0, Sy = 0, Sxx = 0, Sxy = 0;
+    for (const auto& B : Buckets)
+    {
+      double x = (double)(B.first - Origin), y = B.second;
+      Sx += x;
+      Sy += y;
+      Sxx += x * x;
+      Sxy += x * y;
+    }
+    double Denominator = n * Sxx - Sx * Sx;
+    Slope = Denominator > 0 ? (n * Sxy - Sx * Sy) / Denominator : 0.0;
+    Intercept = (Sy - Slope * Sx) / n;
+    //
+    // the earliest arrivals lie on or above the true line: move it down to the lowest
+    //
+    double Lowest = 0.0;
+    for (const auto& B : Buckets)
+      Lowest = std::min(Lowest, B.second - (Intercept + Slope * (double)(B.first - Origin)));
+    Intercept += Lowest;
+    Ppm = -Slope / 1000.0 * 1e6 / (1.0 + Slope / 1000.0);
+  }
+};
+
+
+//
+// one bridge: its port, its reader thread and its queue
+//
+struct Port
+{
+  std::string Name, Device;
+  SpscQueue<Sample, 16384> Queue;
+  std::thread Thread;
+  DriftEstimator Drift;
+  SequenceTracker Sequence;
+  std::atomic<uint64_t> Frames{0}, Missing{0}, Dropped{0}, BadFrames{0};
+  std::atomic<double> Ppm{0.0};
+};
+
+
+static void ReadPort(Port& P, long Baud, int Rate)
+{
+  FrameReader Reader;
+  int64_t Unwrapped = 0, LastTime = 0;
+  uint32_t LastMicros = 0;
+  bool Started = false;
+  int Fd = -1;
+
+  while (!Stop)
+  {
+    if (Fd < 0)
+    {
+      if ((Fd = OpenSerial(P.Device, Baud)) < 0)
+      {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        continue;
+      }
+      tcflush(Fd, TCIFLUSH);
+      WriteAll(Fd, EncodeSetRate((unsigned)Rate));
+    }
+    pollfd Poll{Fd, POLLIN, 0};
+    if (poll(&Poll, 1, 100) <= 0)
+      continue;
+    uint8_t Buffer[4096];
+    ssize_t n = read(Fd, Buffer, sizeof(Buffer));
+    int64_t Arrival = MonotonicNanos();
+    if (n <= 0)
+    {
+      if (n < 0 && errno == EINTR)
+        continue;
+      fprintf(stderr, "%s: lost %s, reopening\n", P.Name.c_str(), P.Device.c_str());
+      close(Fd);
+      Fd = -1;
+      continue;
+    }
+    Reader.Feed(Buffer, (size_t)n, [&](const std::vector<uint8_t>& Frame) {
+      Telemetry T;
+      if (!ParseTelemetry(Frame, T))
+      {
+        P.BadFrames++;
+        return;
+      }
+      uint32_t Step = T.Micros - LastMicros;
+      if (Started && Step > 0x80000000u)            // went backwards: the bridge restarted
+      {
+        P.Drift.Reset();
+        Unwrapped = 0;
+      }
+      else if (Started)
+        Unwrapped += Step;
+      Started = true;
+      LastMicros = T.Micros;
+      P.Missing += P.Sequence.Add(T.Sequence);
+      P.Frames++;
+
+      Sample S;
+      S.Time = std::max(P.Drift.Map(Unwrapped, Arrival), LastTime + 1);
+      LastTime = S.Time;
+      S.FwdTenthdBm = T.FwdTenthdBm;
+      S.RevTenthdBm = T.RevTenthdBm;
+      S.VSWRTenth = T.VSWRTenth;
+      if (!P.Queue.Push(S))
+        P.Dropped++;
+      P.Ppm.store(P.Drift.Ppm, std::memory_order_relaxed);
+    });
+  }
+  if (Fd >= 0)
+    close(Fd);
+}
+
+
+//
+// a port's samples at the merge: enough to interpolate at the time being merged
+//
+struct Pending
+{
+  std::deque<Sample> Samples;
+
+  // the reading at Time, interpolated; false if there's nothing near enough
+  bool At(int64_t Time, double& Fwd, double& Rev, double& VSWR)
+  {
+    while (Samples.size() > 1 && Samples[1].Time <= Time)
+      Samples.pop_front();                          // keep the last one at or before Time
+    if (Samples.empty())
+      return false;
+    const Sample& A = Samples[0];
+    const Sample& B = Samples.size() > 1 ? Samples[1] : Samples[0];
+    double f = B.Time > A.Time ? std::clamp((double)(Time - A.Time) / (B.Time - A.Time), 0.0, 1.0) : 0.0;
+    Fwd = (A.FwdTenthdBm + f * (B.FwdTenthdBm - A.FwdTenthdBm)) / 10.0;
+    Rev = (A.RevTenthdBm + f * (B.RevTenthdBm - A.RevTenthdBm)) / 10.0;
+    VSWR = (A.VSWRTenth + f * (B.VSWRTenth - A.VSWRTenth)) / 10.0;
+    return true;
+  }
+};
+
+
+int main(int argc, char** argv)
+{
+  int Rate = 500;
+  long Baud = DefaultBaud;
+  double MinimumdBm = 0.0;
+  int64_t MaxWaitNanos = 100000000;
+  uint64_t MaxRecords = 0;
+  bool Quiet = false;
+
+  int Opt;
+  while ((Opt = getopt(argc, argv, "r:b:t:m:n:q")) != -1)
+  {
+    switch (Opt)
+    {
+    case 'r': Rate = atoi(optarg); break;
+    case 'b': Baud = atol(optarg); break;
+    case 't': MinimumdBm = atof(optarg); break;
+    case 'm': MaxWaitNanos = (int64_t)(atof(optarg) * 1e6); break;
+    case 'n': MaxRecords = strtoull(optarg, nullptr, 0); break;
+    case 'q': Quiet = true; break;
+    default: optind = argc + 1; break;
+    }
+  }
+  std::vector<std::unique_ptr<Port>> Ports;
+  for (int i = optind; i < argc; i++)
+  {
+    const char* Equals = strchr(argv[i], '=');
+    if (!Equals || Equals == argv[i] || !Equals[1])
+      break;
+    Ports.push_back(std::make_unique<Port>());
+    Ports.back()->Name.assign(argv[i], (size_t)(Equals - argv[i]));
+    Ports.back()->Device = Equals + 1;
+  }
+  if (optind > argc || Ports.size() != (size_t)(argc - optind) || Ports.empty() || Rate <= 0 || Rate > (int)MaxRate)
+  {
+    fprintf(stderr, "usage: %s [-r rate] [-b baud] [-t dBm] [-m ms] [-n records] [-q] name=device ...\n", argv[0]);
+    return 1;
+  }
+  signal(SIGINT, [](int) { Stop = true; });
+  signal(SIGTERM, [](int) { Stop = true; });
+
+  for (auto& P : Ports)
+    P->Thread = std::thread(ReadPort, std::ref(*P), Baud, Rate);
+
+  if (!Quiet)
+  {
+    printf("time");
+    for (auto& P : Ports)
+      printf(",%s_fwd_dbm,%s_rev_dbm,%s_vswr", P->Name.c_str(), P->Name.c_str(), P->Name.c_str());
+    for (size_t i = 1; i < Ports.size(); i++)
+      printf(",%s_%s_db", Ports[i - 1]->Name.c_str(), Ports[i]->Name.c_str());
+    printf("\n");
+  }
+
+  //
+  // merge: for each frame from the first bridge, once every other bridge has a
+  // frame at or after its time (or has been waited for long enough)
+  //
+  std::vector<Pending> Merge(Ports.size());
+  std::vector<double> Fwd(Ports.size()), Rev(Ports.size()), VSWR(Ports.size());
+  std::vector<bool> Have(Ports.size());
+  std::deque<Sample> Reference;
+  uint64_t Records = 0, LastRecords = 0, Incomplete = 0;
+  int64_t NextSummary = MonotonicNanos() + 1000000000;
+
+  while (!Stop && (MaxRecords == 0 || Records < MaxRecords))
+  {
+    bool Any = false;
+    Sample S;
+    while (Ports[0]->Queue.Pop(S))
+    {
+      Reference.push_back(S);
+      Any = true;
+    }
+    for (size_t i = 1; i < Ports.size(); i++)
+      while (Ports[i]->Queue.Pop(S))
+      {
+        Merge[i].Samples.push_back(S);
+        Any = true;
+      }
+
+    int64_t Now = MonotonicNanos();
+    while (!Reference.empty() && (MaxRecords == 0 || Records < MaxRecords))
+    {
+      int64_t Time = Reference.front().Time;
+      bool Ready = true;
+      for (size_t i = 1; i < Ports.size(); i++)
+        if (Merge[i].Samples.empty() || Merge[i].Samples.back().Time < Time)
+          Ready = false;
+      if (!Ready && Now - Time < MaxWaitNanos)
+        break;
+      Merge[0].Samples.assign(1, Reference.front());
+      Reference.pop_front();
+      bool Complete = true;
+      for (size_t i = 0; i < Ports.size(); i++)
+      {
+        Have[i] = Merge[i].At(Time, Fwd[i], Rev[i], VSWR[i]);
+        if (Have[i] && i > 0 && Merge[i].Samples.back().Time < Time
+            && Time - Merge[i].Samples.back().Time > MaxWaitNanos)
+          Have[i] = false;                          // its last frame is too old to use
+        Complete = Complete && Have[i];
+      }
+      if (!Complete)
+        Incomplete++;
+      Records++;
+      if (Quiet)
+        continue;
+      printf("%.6f", Time * 1e-9);
+      for (size_t i = 0; i < Ports.size(); i++)
+        if (Have[i])
+          printf(",%.2f,%.2f,%.2f", Fwd[i], Rev[i], VSWR[i]);
+        else
+          printf(",,,");
+      for (size_t i = 1; i < Ports.size(); i++)
+        if (Have[i - 1] && Have[i] && Fwd[i - 1] >= MinimumdBm && Fwd[i] >= MinimumdBm)
+          printf(",%.2f", Fwd[i] - Fwd[i - 1]);
+        else
+          printf(",");
+      printf("\n");
+    }
+
+    if (Now >= NextSummary)
+    {
+      NextSummary += 1000000000;
+      fprintf(stderr, "records/s %llu  incomplete %llu", (unsigned long long)(Records - LastRecords),
+              (unsigned long long)Incomplete);
+      for (auto& P : Ports)
+        fprintf(stderr, " | %s frames %llu missing %llu dropped %llu drift %+.0fppm", P->Name.c_str(),
+                (unsigned long long)P->Frames.load(), (unsigned long long)P->Missing.load(),
+                (unsigned long long)P->Dropped.load(), P->Ppm.load());
+      fprintf(stderr, "\n");
+      LastRecords = Records;
+      fflush(stdout);
+    }
+    if (!Any)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  Stop = true;
+  for (auto& P : Ports)
+    P->Thread.join();
+  fflush(stdout);
+  fprintf(stderr, "total: records %llu  incomplete %llu\n", (unsigned long long)Records,
+          (unsigned long long)Incomplete);
+  return 0;
+}
@@ -0,0 +1,282 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// bridge_query.cpp
+// answers questions from a bridge_logd log file
+//
+// usage: bridge_query log info
+//        bridge_query log peak|min column [from [to]]
+//        bridge_query log dump [from [to]] [column ...]
+//   info   rows, chunks, time span and size
+//   peak   largest value of a column (eg vswr, rev_pk_w) between two times,
+//          and when it happened
+//   min    smallest value
+//   dump   rows between two times as CSV (all columns unless some are listed)
+// times are unix seconds (1760000000.5), local time as "2026-10-17T14:05:00"
+// or "2026-10-17 14:05:00", a time before the end of the log ("-90s", "-10m",
+// "-2h", "-1d"), or "start" / "end".
+//
+// peak and min read only the chunk headers, then the data of chunks that
+// overlap the time range and could hold a better value than the best so
+// far; the bytes read are reported so the saving can be seen.
+/////////////////////////////////////////////////////////////////////////
+
+#include "columnlog.h"
+
+#include <cinttypes>
+#include <climits>
+#include <cmath>
+#include <ctime>
+
+using namespace columnlog;
+
+
+//
+// parse a time; returns false if it can't be understood
+//
+static bool ParseTime(const std::string& Text, int64_t LogStart, int64_t LogEnd, int64_t& Micros)
+{
+  char* End;
+  if (Text == "start" || Text == "end")
+  {
+    Micros = Text == "start" ? LogStart : LogEnd;
+    return true;
+  }
+  if (Text.size() > 1 && Text[0] == '-')
+  {
+    double Count = strtod(Text.c_str() + 1, &End);
+    double Unit = *End == 's' ? 1 : *End == 'm' ? 60 : *End == 'h' ? 3600 : *End == 'd' ? 86400 : 0;
+    if (Unit == 0 || End[1] != 0)
+      return false;
+    Micros = LogEnd - (int64_t)(Count * Unit * 1e6);
+    return true;
+  }
+  struct tm Tm = {};
+  const char* Rest = strptime(Text.c_str(), "%Y-%m-%d", &Tm);
+  if (Rest && (*Rest == 'T' || *Rest == ' '))
+  {
+    Rest = strptime(Rest + 1, "%H:%M:%S", &Tm);
+    if (!Rest)
+      return false;
+    double Fraction = *Rest == '.' ? strtod(Rest, &End) : 0.0;
+    if (*Rest == '.' && *End != 0)
+      return false;
+    if (*Rest != '.' && *Rest != 0)
+      return false;
+    Tm.tm_isdst = -1;
+    Micros = (int64_t)mktime(&Tm) * 1000000 + (int64_t)(Fraction * 1e6);
+    return true;
+  }
+  double Seconds = strtod(Text.c_str(), &End);
+  if (End == Text.c_str() || *End != 0)
+    return false;
+  Micros = (int64_t)llround(Seconds * 1e6);
+  return true;
+}
+
+static std::string FormatTime(int64_t Micros)
+{
+  time_t Seconds = (time_t)(Micros / 1000000);
+  struct tm Tm;
+  char Text[48];
+  localtime_r(&Seconds, &Tm);
+  size_t n = strftime(Text, sizeof(Text), "%Y-%m-%d %H:%M:%S", &Tm);
+  snprintf(Text + n, sizeof(Text) - n, ".%03d", (int)(Micros % 1000000 / 1000));
+  return Text;
+}
+
+static void PrintValue(int Column, int64_t Value)
+{
+  if (Column == Time)
+    printf("%s", FormatTime(Value).c_str());
+  else if (Columns[Column].Scale == 1)
+    printf("%" PRId64, Value);
+  else
+    printf("%.1f", Value * Columns[Column].Scale);
+}
+
+static void PrintBytesRead(const Reader& Log)
+{
+  printf("read %.1f kB of %.1f kB\n", (Log.HeaderBytesRead + Log.DataBytesRead) / 1e3,
+         Log.FileBytes / 1e3);
+}
+
+
+static int Info(Reader& Log)
+{
+  uint64_t Rows = 0;
+  for (const ChunkInfo& C : Log.Chunks)
+    Rows += C.Rows;
+  printf("created  %s\n", FormatTime(Log.Created).c_str());
+  if (Rows)
+  {
+    int64_t Start = Log.Chunks.front().Index[Time].Min;
+    int64_t End = Log.Chunks.back().Index[Time].Max;
+    printf("from     %s\nto       %s (%.1f hours)\n", FormatTime(Start).c_str(), FormatTime(End).c_str(),
+           (End - Start) / 3.6e9);
+  }
+  printf("rows     %" PRIu64 " in %zu chunks\n", Rows, Log.Chunks.size());
+  printf("size     %" PRIu64 " bytes (%.2f per row)\n", Log.FileBytes, Rows ? (double)Log.FileBytes / Rows : 0.0);
+  if (Log.GoodBytes < Log.FileBytes)
+    printf("         last %" PRIu64 " bytes are an incomplete chunk\n", Log.FileBytes - Log.GoodBytes);
+  return 0;
+}
+
+
+//
+// largest (or smallest) value of a column in a time range
+//
+static int Extreme(Reader& Log, int Column, bool Peak, int64_t From, int64_t To)
+{
+  bool Found = false;
+  int64_t Best = 0, BestTime = 0;
+  uint64_t ChunksRead = 0;
+  std::vector<int64_t> Times, Values;
+
+  for (const ChunkInfo& C : Log.Chunks)
+  {
+    const ChunkIndex& T = C.Index[Time];
+    const ChunkIndex& V = C.Index[Column];
+    if (T.Max < From || T.Min > To)
+      continue;                                     // outside the time range
+    if (Found && (Peak ? V.Max <= Best : V.Min >= Best))
+      continue;                                     // can't beat what we have
+    if (!Log.ReadColumn(C, Time, Times) || !Log.ReadColumn(C, Column, Values))
+    {
+      fprintf(stderr, "chunk at %" PRIu64 " is damaged, skipped\n", C.FileOffset);
+      continue;
+    }
+    ChunksRead++;
+    for (uint32_t r = 0; r < C.Rows; r++)
+      if (Times[r] >= From && Times[r] <= To && (!Found || (Peak ? Values[r] > Best : Values[r] < Best)))
+      {
+        Found = true;
+        Best = Values[r];
+        BestTime = Times[r];
+      }
+  }
+  if (!Found)
+  {
+    printf("no rows between %s and %s\n", FormatTime(From).c_str(), FormatTime(To).c_str());
+    return 1;
+  }
+  printf("%s %s ", Columns[Column].Name, Peak ? "peak" : "min");
+  PrintValue(Column, Best);
+  printf(" at %s\n", FormatTime(BestTime).c_str());
+  printf("%" PRIu64 " of %zu chunks decoded, ", ChunksRead, Log.Chunks.size());
+  PrintBytesRead(Log);
+  return 0;
+}
+
+
+//
+// rows in a time range as CSV
+//
+static int Dump(Reader& Log, const std::vector<int>& Wanted, int64_t From, int64_t To)
+{
+  std::vector<int64_t> Values[NumColumns];
+  for (size_t i = 0; i < Wanted.size(); i++)
+    printf("%s%s", i ? "," : "", Columns[Wanted[i]].Name);
+  printf("\n");
+  for (const ChunkInfo& C : Log.Chunks)
+  {
+    if (C.Index[Time].Max < From || C.Index[Time].Min > To)
+      continue;
+    bool Ok = Log.ReadColumn(C, Time, Values[Time]);
+    for (int Column : Wanted)
+      Ok = Ok && Log.ReadColumn(C, Column, Values[Column]);
+    if (!Ok)
+    {
+      fprintf(stderr, "chunk at %" PRIu64 " is damaged, skipped\n", C.FileOffset);
+      continue;
+    }
+    for (uint32_t r = 0; r < C.Rows; r++)
+    {
+      if (Values[Time][r] < From || Values[Time][r] > To)
+        continue;
+      for (size_t i = 0; i < Wanted.size(); i++)
+      {
+        if (i)
+          printf(",");
+        if (Wanted[i] == Time)
+          printf("%.6f", Values[Time][r] * 1e-6);
+        else
+          PrintValue(Wanted[i], Values[Wanted[i]][r]);
+      }
+      printf("\n");
+    }
+  }
+  return 0;
+}
+
+
+static int Usage(const char* Name)
+{
+  fprintf(stderr, "usage: %s log info\n"
+                  "       %s log peak|min column [from [to]]\n"
+                  "       %s log dump [from [to]] [column ...]\n"
+                  "columns:", Name, Name, Name);
+  for (const ColumnInfo& C : Columns)
+    fprintf(stderr, " %s", C.Name);
+  fprintf(stderr, "\ntimes: unix seconds, 2026-10-17T14:05:00, -10m (before the end), start, end\n");
+  return 1;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3)
+    return Usage(argv[0]);
+  Reader Log;
+  if (!Log.Open(argv[1]))
+  {
+    fprintf(stderr, "%s\n", Log.Error.c_str());
+    return 1;
+  }
+  std::string Command = argv[2];
+  int64_t Start = Log.Chunks.empty() ? 0 : Log.Chunks.front().Index[Time].Min;
+  int64_t End = Log.Chunks.empty() ? 0 : Log.Chunks.back().Index[Time].Max;
+  int64_t From = INT64_MIN, To = INT64_MAX;
+  int Arg = 3;
+
+  if (Command == "info" && argc == 3)
+    return Info(Log);
+
+  if ((Command == "peak" || Command == "min") && argc >= 4 && argc <= 6)
+  {
+    int Column = FindColumn(argv[3]);
+    if (Column < 0)
+      return Usage(argv[0]);
+    if ((argc > 4 && !ParseTime(argv[4], Start, End, From)) || (argc > 5 && !ParseTime(argv[5], Start, End, To)))
+    {
+      fprintf(stderr, "can't understand the time\n");
+      return 1;
+    }
+    return Extreme(Log, Column, Command == "peak", From, To);
+  }
+
+  if (Command == "dump")
+  {
+    int64_t* Times[2] = {&From, &To};
+    for (int i = 0; i < 2 && Arg < argc && FindColumn(argv[Arg]) < 0; i++, Arg++)
+      if (!ParseTime(argv[Arg], Start, End, *Times[i]))
+      {
+        fprintf(stderr, "can't understand the time %s\n", argv[Arg]);
+        return 1;
+      }
+    std::vector<int> Wanted;
+    for (; Arg < argc; Arg++)
+    {
+      int Column = FindColumn(argv[Arg]);
+      if (Column < 0)
+        return Usage(argv[0]);
+      Wanted.push_back(Column);
+    }
+    if (Wanted.empty())
+      for (int c = 0; c < NumColumns; c++)
+        Wanted.push_back(c);
+    return Dump(Log, Wanted, From, To);
+  }
+  return Usage(argv[0]);
+}
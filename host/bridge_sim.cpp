@@ -0,0 +1,323 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// bridge_sim.cpp
+// a stand-in for a bridge on a pseudo terminal, for testing the host programs
+// without hardware. It answers rate requests and sends telemetry frames the
+// way the sketch does, from a simulated transmitter keyed on and off. Like the
+// sketch it never waits for the reader: if the last frame hasn't been taken,
+// the next is skipped and the sequence number shows the gap.
+//
+// usage: bridge_sim [-l link] [-r rate] [-p dBm] [-s vswr] [-k keyed_ms] [-u unkeyed_ms]
+//                   [-f capture] [-g dB] [-d ppm] [-t micros] [-a start]
+//   -l  also make a symbolic link to the pty with this name
+//   -r  frame rate at start (default 0: wait for a rate request, like the bridge)
+//   -p  keyed forward power, dBm (default 50 = 100W)
+//   -s  load VSWR (default 1.5)
+//   -k, -u  keyed and unkeyed times (default 500ms each; -u 0 for a steady carrier)
+//   -f  replay the readings in a capture (telemetry_decode -w) instead, in
+//       step with the time they were recorded, round and round
+//   -g  add this many dB to every level (an amplifier, or a feedline if negative)
+//   -d  make the bridge's clock this many parts per million fast (or slow)
+//   -t  the bridge's micros() at start (default 0; 4294000000 tests the wrap)
+//   -a  start the transmitter (or replay) at this time, unix seconds, so that
+//       several simulators can stand in for bridges on the same signal
+/////////////////////////////////////////////////////////////////////////
+
+#include "bridgeproto.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+#include <random>
+#include <signal.h>
+#include <thread>
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+//
+// the default calibration in the sketch: line dBm = -46 + 0.1253 x ADC code
+//
+constexpr double dBPerCode = 131387.0 / 1048576.0;
+constexpr double dBmAtZero = -96.0 + 50.0;
+constexpr unsigned ConversionsPerSecond = 8000;     // each input
+constexpr double NoiseFloordBm = -30.0;
+
+static volatile sig_atomic_t Stop = 0;
+
+
+static uint16_t ReadingFordBm(double dBm)
+{
+  double Code = (dBm - dBmAtZero) / dBPerCode;
+  Code = std::clamp(Code, 0.0, 1023.0);
+  return (uint16_t)std::lround(Code * 16.0);
+}
+
+static double dBmForReading(double Reading)
+{
+  return dBmAtZero + Reading / 16.0 * dBPerCode;
+}
+
+static uint16_t PowerTenth(double dBm)
+{
+  return (uint16_t)std::min(60000.0, std::pow(10.0, (dBm - 20.0) / 10.0));
+}
+
+
+//
+// a recording to replay: the frames, and when they came relative to the first
+//
+struct Recording
+{
+  std::vector<Telemetry> Frames;
+  std::vector<double> Ms;
+  double LengthMs = 0.0;
+
+  bool Load(const char* Path)
+  {
+    int Fd = open(Path, O_RDONLY | O_CLOEXEC);
+    if (Fd < 0)
+      return false;
+    FrameReader Reader;
+    uint8_t Buffer[8192];
+    ssize_t n;
+    while ((n = read(Fd, Buffer, sizeof(Buffer))) > 0)
+      Reader.Feed(Buffer, (size_t)n, [&](const std::vector<uint8_t>& Frame) {
+        Telemetry T;
+        if (!ParseTelemetry(Frame, T))
+          return;
+        Ms.push_back(Frames.empty() ? 0.0 : Ms.back() + (uint32_t)(T.Micros - Frames.back().Micros) / 1000.0);
+        Frames.push_back(T);
+      });
+    close(Fd);
+    if (Frames.size() > 1)                          // one more frame period before it repeats
+      LengthMs = Ms.back() + Ms.back() / (Frames.size() - 1);
+    return true;
+  }
+
+  // the frame recorded at this time since the start
+  const Telemetry& At(double Time) const
+  {
+    double Position = std::fmod(Time, LengthMs);
+    size_t i = std::upper_bound(Ms.begin(), Ms.end(), Position) - Ms.begin();
+    return Frames[i ? i - 1 : 0];
+  }
+};
+
+
+int main(int argc, char** argv)
+{
+  std::string Link;
+  unsigned Rate = 0;
+  double KeyeddBm = 50.0, VSWR = 1.5;
+  double KeyedMs = 500, UnkeyedMs = 500;
+  double Gain = 0.0, ClockPpm = 0.0, StartAt = 0.0;
+  uint32_t StartMicros = 0;
+  Recording Replay;
+
+  int Opt;
+  while ((Opt = getopt(argc, argv, "l:r:p:s:k:u:f:g:d:t:a:")) != -1)
+  {
+    switch (Opt)
+    {
+    case 'l': Link = optarg; break;
+    case 'r': Rate = std::min((unsigned)atoi(optarg), MaxRate); break;
+    case 'p': KeyeddBm = atof(optarg); break;
+    case 's': VSWR = std::max(1.0, atof(optarg)); break;
+    case 'k': KeyedMs = atof(optarg); break;
+    case 'u': UnkeyedMs = atof(optarg); break;
+    case 'f':
+      if (!Replay.Load(optarg) || Replay.LengthMs <= 0.0)
+      {
+        fprintf(stderr, "%s: no telemetry to replay\n", optarg);
+        return 1;
+      }
+      break;
+    case 'g': Gain = atof(optarg); break;
+    case 'd': ClockPpm = atof(optarg); break;
+    case 't': StartMicros = (uint32_t)strtoul(optarg, nullptr, 0); break;
+    case 'a': StartAt = atof(optarg); break;
+    default:
+      fprintf(stderr, "usage: %s [-l link] [-r rate] [-p dBm] [-s vswr] [-k keyed_ms] [-u unkeyed_ms]\n"
+                      "       [-f capture] [-g dB] [-d ppm] [-t micros] [-a start]\n", argv[0]);
+      return 1;
+    }
+  }
+  signal(SIGINT, [](int) { Stop = 1; });
+  signal(SIGTERM, [](int) { Stop = 1; });
+  signal(SIGPIPE, SIG_IGN);
+
+  int Master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (Master < 0 || grantpt(Master) != 0 || unlockpt(Master) != 0)
+  {
+    perror("pty");
+    return 1;
+  }
+  std::string SlavePath = ptsname(Master);
+  fcntl(Master, F_SETFL, fcntl(Master, F_GETFL) | O_NONBLOCK);
+  //
+  // hold the slave open in raw mode: with no line discipline processing, bytes pass
+  // unchanged, and the master doesn't see a hang up when a reader closes it
+  //
+  int Slave = OpenSerial(SlavePath);
+  if (Slave < 0)
+  {
+    perror(SlavePath.c_str());
+    return 1;
+  }
+  if (!Link.empty())
+  {
+    unlink(Link.c_str());
+    if (symlink(SlavePath.c_str(), Link.c_str()) != 0)
+      perror(Link.c_str());
+  }
+  printf("%s\n", SlavePath.c_str());
+  fflush(stdout);
+
+  double ReflectiondB = -20.0 * std::log10((VSWR - 1.0) / (VSWR + 1.0));
+  std::mt19937 Random(1);
+  std::normal_distribution<double> Noise(0.0, 0.3);
+  FrameReader Reader;
+  std::vector<uint8_t> Pending;                     // encoded frame not yet taken by the pty
+  size_t PendingPos = 0;
+  uint16_t Sequence = 0, AdcSequence = 0;
+  uint64_t Sent = 0, Skipped = 0;
+  double ClockRate = 1.0 + ClockPpm * 1e-6;         // bridge microseconds per real one
+  if (StartAt > 0.0)
+  {
+    auto Wall = std::chrono::system_clock::now().time_since_epoch();
+    std::this_thread::sleep_for(std::chrono::duration<double>(StartAt) - Wall);
+  }
+  auto Start = Clock::now();
+  auto NextFrame = Start;
+  auto LastClaim = Start;
+  double Carry = 0.0;
+
+  while (!Stop)
+  {
+    //
+    // rate requests
+    //
+    uint8_t In[256];
+    ssize_t n;
+    while ((n = read(Master, In, sizeof(In))) > 0)
+    {
+      Reader.Feed(In, (size_t)n, [&](const std::vector<uint8_t>& Frame) {
+        if (CheckFrame(Frame) == 3 && Frame[0] == FrameSetRate)
+        {
+          unsigned NewRate = std::min((unsigned)GetWord(&Frame[1]), MaxRate);
+          if (Rate == 0)                            // the sketch empties its telemetry blocks when starting
+            LastClaim = Clock::now();
+          Rate = NewRate;
+          NextFrame = Clock::now();
+          fprintf(stderr, "rate %u\n", Rate);
+        }
+      });
+    }
+
+    auto Now = Clock::now();
+    if (Rate != 0 && Now >= NextFrame)
+    {
+      // the bridge times its frames by its own clock
+      auto Period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::micro>(
+          (1000000 / Rate) / ClockRate));
+      NextFrame += Period;
+      if (NextFrame <= Now)
+        NextFrame = Now + Period;
+      if (PendingPos < Pending.size())
+        Skipped++;
+      else
+      {
+        //
+        // the readings since the last frame claimed
+        //
+        double Seconds = std::chrono::duration<double>(Now - LastClaim).count();
+        LastClaim = Now;
+        Carry += Seconds * ConversionsPerSecond;
+        unsigned Count = (unsigned)Carry;
+        Carry -= Count;
+        double Ms = std::chrono::duration<double, std::milli>(Now - Start).count();
+        bool Keyed = UnkeyedMs <= 0 || std::fmod(Ms, KeyedMs + UnkeyedMs) < KeyedMs;
+
+        Telemetry T{};
+        T.Sequence = Sequence;
+        T.Micros = StartMicros + (uint32_t)(int64_t)(Ms * 1000.0 * ClockRate);
+        double FwdAvg, RevAvg, FwdPk, RevPk;
+        if (!Replay.Frames.empty())
+        {
+          //
+          // the recorded readings, shifted by the gain
+          //
+          const Telemetry& R = Replay.At(Ms);
+          FwdAvg = R.FwdTenthdBm / 10.0 + Gain;
+          RevAvg = R.RevTenthdBm / 10.0 + Gain;
+          FwdPk = dBmForReading(R.FwdPeak) + Gain;
+          RevPk = dBmForReading(R.RevPeak) + Gain;
+          T.FwdPeak = ReadingFordBm(FwdPk);
+          T.RevPeak = ReadingFordBm(RevPk);
+          T.FwdSum = (uint32_t)ReadingFordBm(FwdAvg) * Count;
+          T.RevSum = (uint32_t)ReadingFordBm(RevAvg) * Count;
+        }
+        else
+        {
+          for (unsigned i = 0; i < Count; i++)
+          {
+            double Fwd = Keyed ? KeyeddBm + Gain + Noise(Random) : NoiseFloordBm + Noise(Random);
+            double Rev = Keyed ? Fwd - ReflectiondB + Noise(Random) : NoiseFloordBm + Noise(Random);
+            uint16_t FwdReading = ReadingFordBm(Fwd), RevReading = ReadingFordBm(Rev);
+            T.FwdSum += FwdReading;
+            T.RevSum += RevReading;
+            T.FwdPeak = std::max(T.FwdPeak, FwdReading);
+            T.RevPeak = std::max(T.RevPeak, RevReading);
+          }
+          FwdAvg = dBmForReading(Count ? (double)(T.FwdSum / Count) : 0.0);
+          RevAvg = dBmForReading(Count ? (double)(T.RevSum / Count) : 0.0);
+          FwdPk = dBmForReading(T.FwdPeak);
+          RevPk = dBmForReading(T.RevPeak);
+        }
+        T.FwdCount = T.RevCount = (uint16_t)Count;
+        AdcSequence += (uint16_t)(2 * Count);
+        T.AdcSequence = AdcSequence;
+        T.FwdTenthdBm = (int16_t)(FwdAvg * 10.0);
+        T.RevTenthdBm = (int16_t)(RevAvg * 10.0);
+        T.FwdAvgPowerTenth = PowerTenth(FwdAvg);
+        T.RevAvgPowerTenth = PowerTenth(RevAvg);
+        T.FwdPeakPowerTenth = PowerTenth(FwdPk);
+        T.RevPeakPowerTenth = PowerTenth(RevPk);
+        double Rho = std::pow(10.0, -std::fabs(FwdPk - RevPk) / 20.0);
+        T.VSWRTenth = (uint16_t)std::min(9999.0, 10.0 * (1.0 + Rho) / (1.0 - Rho));
+        if (FwdPk < 0.0)                            // line voltage below 0.1V
+          T.VSWRTenth = 10;
+        Pending = EncodeTelemetry(T);
+        PendingPos = 0;
+        Sent++;
+      }
+      Sequence++;
+    }
+
+    //
+    // pass as much as the pty takes, without waiting
+    //
+    if (PendingPos < Pending.size())
+    {
+      n = write(Master, Pending.data() + PendingPos, Pending.size() - PendingPos);
+      if (n > 0)
+        PendingPos += (size_t)n;
+    }
+
+    pollfd P{Master, POLLIN, 0};
+    poll(&P, 1, 1);
+  }
+  fprintf(stderr, "frames sent %llu, skipped %llu\n", (unsigned long long)Sent, (unsigned long long)Skipped);
+  if (!Link.empty())
+    unlink(Link.c_str());
+  close(Slave);
+  close(Master);
+  return 0;
+}
@@ -0,0 +1,359 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// bridgeproto.h
+// the USB serial telemetry protocol, shared by the host programs:
+// COBS framing, CRC16, frame layouts and serial port setup.
+// see sketch/Log_VSWR_sketch/telemetry.cpp for the frame layout.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __BRIDGEPROTO_H
+#define __BRIDGEPROTO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+namespace bridge
+{
+
+constexpr uint8_t FrameTelemetry = 0x01;        // telemetry, version 1
+constexpr uint8_t FrameSetRate = 0x81;          // set frame rate (to the bridge)
+constexpr uint8_t FlagTripped = 1;              // VSWR protection tripped
+constexpr uint8_t FlagOversample = 2;           // ADC oversampling selected
+constexpr size_t TelemetryPayload = 40;         // telemetry bytes before the CRC
+constexpr unsigned MaxRate = 500;               // frames per second
+constexpr long DefaultBaud = 500000;
+
+
+//
+// one telemetry frame
+// readings are in units of 1/16 ADC code; powers in tenths of a watt
+//
+struct Telemetry
+{
+  uint16_t Sequence;                            // frame period number
+  uint32_t Micros;                              // bridge micros() when the readings were claimed
+  uint32_t FwdSum, RevSum;
+  uint16_t FwdCount, RevCount;
+  uint16_t FwdPeak, RevPeak;
+  uint16_t AdcSequence;                         // ADC conversion number of the last reading
+  int16_t FwdTenthdBm, RevTenthdBm;
+  uint16_t FwdAvgPowerTenth, RevAvgPowerTenth;
+  uint16_t FwdPeakPowerTenth, RevPeakPowerTenth;
+  uint16_t VSWRTenth;
+  uint8_t Flags;
+};
+
+
+//
+// CRC16, CCITT polynomial, initial value 0xFFFF
+//
+inline uint16_t Crc16(const uint8_t* Data, size_t Length, uint16_t Crc = 0xFFFF)
+{
+  for (size_t i = 0; i < Length; i++)
+  {
+    Crc ^= (uint16_t)(Data[i] << 8);
+    for (int Bit = 0; Bit < 8; Bit++)
+      Crc = (Crc & 0x8000) ? (uint16_t)((Crc << 1) ^ 0x1021) : (uint16_t)(Crc << 1);
+  }
+  return Crc;
+}
+
+
+//
+// COBS encode, adding the zero delimiter
+//
+inline std::vector<uint8_t> CobsEncode(const uint8_t* Data, size_t Length)
+{
+  std::vector<uint8_t> Out;
+  Out.reserve(Length + Length / 254 + 2);
+  size_t Code = 0;
+  Out.push_back(0);
+  for (size_t i = 0; i < Length; i++)
+  {
+    if (Data[i] == 0)
+    {
+      Out[Code] = (uint8_t)(Out.size() - Code);
+      Code = Out.size();
+      Out.push_back(0);
+    }
+    else
+    {
+      Out.push_back(Data[i]);
+      if (Out.size() - Code == 0xFF)
+      {
+        Out[Code] = 0xFF;
+        Code = Out.size();
+        Out.push_back(0);
+      }
+    }
+  }
+  Out[Code] = (uint8_t)(Out.size() - Code);
+  Out.push_back(0);
+  return Out;
+}
+
+
+//
+// COBS decode a frame without its delimiter
+// returns false if the encoding is invalid
+//
+inline bool CobsDecode(const uint8_t* Data, size_t Length, std::vector<uint8_t>& Out)
+{
+  Out.clear();
+  size_t In = 0;
+  while (In < Length)
+  {
+    uint8_t Code = Data[In++];
+    if (Code == 0 || In + Code - 1 > Length)
+      return false;
+    for (uint8_t i = 1; i < Code; i++)
+      Out.push_back(Data[In++]);
+    if (Code != 0xFF && In < Length)
+      Out.push_back(0);
+  }
+  return true;
+}
+
+
+inline uint16_t GetWord(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+inline uint32_t GetLong(const uint8_t* p) { return GetWord(p) | ((uint32_t)GetWord(p + 2) << 16); }
+inline void PutWord(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+inline void PutLong(uint8_t* p, uint32_t v) { PutWord(p, (uint16_t)v); PutWord(p + 2, (uint16_t)(v >> 16)); }
+
+
+//
+// add the CRC to a payload and COBS encode it
+//
+inline std::vector<uint8_t> EncodeFrame(std::vector<uint8_t> Payload)
+{
+  uint16_t Crc = Crc16(Payload.data(), Payload.size());
+  Payload.push_back((uint8_t)Crc);
+  Payload.push_back((uint8_t)(Crc >> 8));
+  return CobsEncode(Payload.data(), Payload.size());
+}
+
+
+//
+// check the CRC of a decoded frame; returns the payload length, or -1 if bad
+//
+inline int CheckFrame(const std::vector<uint8_t>& Frame)
+{
+  if (Frame.size() < 3)
+    return -1;
+  size_t Length = Frame.size() - 2;
+  uint16_t Crc = Crc16(Frame.data(), Length);
+  if (GetWord(&Frame[Length]) != Crc)
+    return -1;
+  return (int)Length;
+}
+
+
+inline bool ParseTelemetry(const std::vector<uint8_t>& Frame, Telemetry& T)
+{
+  if (CheckFrame(Frame) != (int)TelemetryPayload || Frame[0] != FrameTelemetry)
+    return false;
+  const uint8_t* p = Frame.data();
+  T.Sequence = GetWord(p + 1);
+  T.Micros = GetLong(p + 3);
+  T.FwdSum = GetLong(p + 7);
+  T.RevSum = GetLong(p + 11);
+  T.FwdCount = GetWord(p + 15);
+  T.RevCount = GetWord(p + 17);
+  T.FwdPeak = GetWord(p + 19);
+  T.RevPeak = GetWord(p + 21);
+  T.AdcSequence = GetWord(p + 23);
+  T.FwdTenthdBm = (int16_t)GetWord(p + 25);
+  T.RevTenthdBm = (int16_t)GetWord(p + 27);
+  T.FwdAvgPowerTenth = GetWord(p + 29);
+  T.RevAvgPowerTenth = GetWord(p + 31);
+  T.FwdPeakPowerTenth = GetWord(p + 33);
+  T.RevPeakPowerTenth = GetWord(p + 35);
+  T.VSWRTenth = GetWord(p + 37);
+  T.Flags = p[39];
+  return true;
+}
+
+
+inline std::vector<uint8_t> EncodeTelemetry(const Telemetry& T)
+{
+  std::vector<uint8_t> Payload(TelemetryPayload);
+  uint8_t* p = Payload.data();
+  p[0] = FrameTelemetry;
+  PutWord(p + 1, T.Sequence);
+  PutLong(p + 3, T.Micros);
+  PutLong(p + 7, T.FwdSum);
+  PutLong(p + 11, T.RevSum);
+  PutWord(p + 15, T.FwdCount);
+  PutWord(p + 17, T.RevCount);
+  PutWord(p + 19, T.FwdPeak);
+  PutWord(p + 21, T.RevPeak);
+  PutWord(p + 23, T.AdcSequence);
+  PutWord(p + 25, (uint16_t)T.FwdTenthdBm);
+  PutWord(p + 27, (uint16_t)T.RevTenthdBm);
+  PutWord(p + 29, T.FwdAvgPowerTenth);
+  PutWord(p + 31, T.RevAvgPowerTenth);
+  PutWord(p + 33, T.FwdPeakPowerTenth);
+  PutWord(p + 35, T.RevPeakPowerTenth);
+  PutWord(p + 37, T.VSWRTenth);
+  p[39] = T.Flags;
+  return EncodeFrame(Payload);
+}
+
+
+inline std::vector<uint8_t> EncodeSetRate(unsigned Rate)
+{
+  std::vector<uint8_t> Payload(3);
+  Payload[0] = FrameSetRate;
+  PutWord(&Payload[1], (uint16_t)Rate);
+  return EncodeFrame(Payload);
+}
+
+
+//
+// splits a byte stream into frames at the zero delimiters
+// call Feed() with whatever has been read; it calls OnFrame(decoded bytes) for each
+// frame that decodes. Anything that isn't a valid frame (a partial frame at start up,
+// line noise) is counted and dropped.
+//
+class FrameReader
+{
+public:
+  static constexpr size_t MaxFrame = 256;
+  uint64_t BadFrames = 0;                       // invalid COBS or too long
+  uint64_t Frames = 0;
+
+  template <class F> void Feed(const uint8_t* Data, size_t Length, F&& OnFrame)
+  {
+    for (size_t i = 0; i < Length; i++)
+    {
+      uint8_t Ch = Data[i];
+      if (Ch != 0)
+      {
+        if (Buffer.size() < MaxFrame)
+          Buffer.push_back(Ch);
+        else
+          Overflow = true;
+        continue;
+      }
+      if (!Buffer.empty())
+      {
+        if (!Overflow && CobsDecode(Buffer.data(), Buffer.size(), Decoded))
+        {
+          Frames++;
+          OnFrame(Decoded);
+        }
+        else
+          BadFrames++;
+      }
+      Buffer.clear();
+      Overflow = false;
+    }
+  }
+
+private:
+  std::vector<uint8_t> Buffer;
+  std::vector<uint8_t> Decoded;
+  bool Overflow = false;
+};
+
+
+//
+// counts frames missing from the sequence numbers
+//
+class SequenceTracker
+{
+public:
+  uint64_t Received = 0;
+  uint64_t Missing = 0;
+
+  // returns the number of frames missed before this one
+  unsigned Add(uint16_t Sequence)
+  {
+    unsigned Gap = 0;
+    if (Received != 0)
+      Gap = (uint16_t)(Sequence - Last - 1);
+    if (Gap > 0x8000)                           // went backwards: the bridge has restarted
+      Gap = 0;
+    Missing += Gap;
+    Received++;
+    Last = Sequence;
+    return Gap;
+  }
+
+private:
+  uint16_t Last = 0;
+};
+
+
+//
+// open a serial port (or pty) in raw mode
+// returns the file descriptor, or -1 with errno set
+//
+inline speed_t BaudConstant(long Baud)
+{
+  switch (Baud)
+  {
+  case 9600: return B9600;
+  case 19200: return B19200;
+  case 38400: return B38400;
+  case 57600: return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  case 460800: return B460800;
+  case 500000: return B500000;
+  case 921600: return B921600;
+  case 1000000: return B1000000;
+  default: return B0;
+  }
+}
+
+inline int OpenSerial(const std::string& Path, long Baud = DefaultBaud)
+{
+  int Fd = open(Path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC);
+  if (Fd < 0)
+    return -1;
+  termios Tio;
+  if (tcgetattr(Fd, &Tio) == 0)
+  {
+    cfmakeraw(&Tio);
+    Tio.c_cflag |= CLOCAL | CREAD;
+    Tio.c_cc[VMIN] = 1;
+    Tio.c_cc[VTIME] = 0;
+    speed_t Speed = BaudConstant(Baud);
+    if (Speed != B0)
+    {
+      cfsetispeed(&Tio, Speed);
+      cfsetospeed(&Tio, Speed);
+    }
+    tcsetattr(Fd, TCSANOW, &Tio);
+  }
+  return Fd;
+}
+
+
+inline bool WriteAll(int Fd, const std::vector<uint8_t>& Data)
+{
+  size_t Done = 0;
+  while (Done < Data.size())
+  {
+    ssize_t n = write(Fd, Data.data() + Done, Data.size() - Done);
+    if (n <= 0)
+      return false;
+    Done += (size_t)n;
+  }
+  return true;
+}
+
+}   // namespace bridge
+
+#endif      // file sentry
@@ -0,0 +1,386 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// columnlog.h
+// the chunked columnar log written by bridge_logd and read by bridge_query.
+//
+// the file is a header then chunks, only ever appended to. Each chunk holds
+// up to a few thousand rows, stored column by column: each column is a
+// first value then zigzag varint deltas (the timestamp column stores deltas
+// of deltas, as frames are evenly spaced). Readings change slowly from frame
+// to frame, so most values take one byte.
+//
+// file header (little endian):
+//   char[8] "VSWRLOG" and a zero, u16 version, u16 column count, u32 zero,
+//   i64 creation time (us since the epoch), then per column: char[15] name
+//   (zero padded) and u8 encoding
+// chunk:
+//   u32 "VCHK", u32 rows, u32 payload bytes, u32 CRC32 of what follows,
+//   per column: i64 min, i64 max, i64 first value, u32 offset into the
+//   payload, u32 bytes; then the payload
+// the min/max index in each chunk header lets a query skip chunks outside its
+// time range, and chunks that can't hold a new peak, without reading their data.
+// a chunk cut short by a crash fails its length or CRC check and is ignored;
+// the daemon truncates it when it next appends.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __COLUMNLOG_H
+#define __COLUMNLOG_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace columnlog
+{
+
+constexpr char Magic[8] = {'V', 'S', 'W', 'R', 'L', 'O', 'G', 0};
+constexpr uint32_t ChunkMagic = 0x4B484356;         // "VCHK"
+constexpr uint16_t Version = 1;
+constexpr size_t FileHeaderSize = 24;
+constexpr size_t ColumnNameSize = 16;
+constexpr size_t ChunkHeaderSize = 16;
+constexpr size_t ColumnIndexSize = 32;
+constexpr uint32_t MaxChunkRows = 1u << 20;
+
+enum Encoding : uint8_t
+{
+  Delta = 1,                                        // first value, then deltas
+  DeltaOfDelta = 2                                  // first value, then changes in the delta
+};
+
+
+//
+// the columns, in file order
+//
+enum Column
+{
+  Time,                                             // us since the epoch
+  Sequence,                                         // bridge frame sequence, unwrapped
+  FwdTenthdBm,
+  RevTenthdBm,
+  FwdAvgPowerTenth,                                 // tenths of a watt
+  RevAvgPowerTenth,
+  FwdPeakPowerTenth,
+  RevPeakPowerTenth,
+  VSWRTenth,
+  Flags,
+  NumColumns
+};
+
+struct ColumnInfo
+{
+  const char* Name;
+  Encoding Enc;
+  double Scale;                                     // multiply the stored value by this to show it
+};
+
+const ColumnInfo Columns[NumColumns] =
+{
+  {"time", DeltaOfDelta, 1e-6},
+  {"seq", DeltaOfDelta, 1},
+  {"fwd_dbm", Delta, 0.1},
+  {"rev_dbm", Delta, 0.1},
+  {"fwd_avg_w", Delta, 0.1},
+  {"rev_avg_w", Delta, 0.1},
+  {"fwd_pk_w", Delta, 0.1},
+  {"rev_pk_w", Delta, 0.1},
+  {"vswr", Delta, 0.1},
+  {"flags", Delta, 1}
+};
+
+inline int FindColumn(const std::string& Name)
+{
+  for (int i = 0; i < NumColumns; i++)
+    if (Name == Columns[i].Name)
+      return i;
+  return -1;
+}
+
+
+//
+// little endian and varint helpers
+//
+inline void Put(std::vector<uint8_t>& Out, uint64_t Value, int Bytes)
+{
+  for (int i = 0; i < Bytes; i++)
+    Out.push_back((uint8_t)(Value >> (8 * i)));
+}
+
+inline uint64_t Get(const uint8_t* p, int Bytes)
+{
+  uint64_t Value = 0;
+  for (int i = 0; i < Bytes; i++)
+    Value |= (uint64_t)p[i] << (8 * i);
+  return Value;
+}
+
+inline void PutVarint(std::vector<uint8_t>& Out, int64_t Value)
+{
+  uint64_t Zigzag = ((uint64_t)Value << 1) ^ (uint64_t)(Value >> 63);
+  while (Zigzag >= 0x80)
+  {
+    Out.push_back((uint8_t)(Zigzag | 0x80));
+    Zigzag >>= 7;
+  }
+  Out.push_back((uint8_t)Zigzag);
+}
+
+// returns false if the data runs out
+inline bool GetVarint(const uint8_t*& p, const uint8_t* End, int64_t& Value)
+{
+  uint64_t Zigzag = 0;
+  for (int Shift = 0; p < End && Shift < 64; Shift += 7)
+  {
+    uint8_t Byte = *p++;
+    Zigzag |= (uint64_t)(Byte & 0x7F) << Shift;
+    if (!(Byte & 0x80))
+    {
+      Value = (int64_t)(Zigzag >> 1) ^ -(int64_t)(Zigzag & 1);
+      return true;
+    }
+  }
+  return false;
+}
+
+inline uint32_t Crc32(const uint8_t* Data, size_t Length, uint32_t Crc = 0)
+{
+  static uint32_t Table[256];
+  if (Table[1] == 0)
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      Table[i] = c;
+    }
+  Crc = ~Crc;
+  for (size_t i = 0; i < Length; i++)
+    Crc = Table[(Crc ^ Data[i]) & 0xFF] ^ (Crc >> 8);
+  return ~Crc;
+}
+
+
+inline std::vector<uint8_t> EncodeFileHeader(int64_t CreatedMicros)
+{
+  std::vector<uint8_t> Out(Magic, Magic + 8);
+  Put(Out, Version, 2);
+  Put(Out, NumColumns, 2);
+  Put(Out, 0, 4);
+  Put(Out, (uint64_t)CreatedMicros, 8);
+  for (const ColumnInfo& C : Columns)
+  {
+    char Name[ColumnNameSize - 1] = {};
+    strncpy(Name, C.Name, sizeof(Name) - 1);
+    Out.insert(Out.end(), Name, Name + sizeof(Name));
+    Out.push_back(C.Enc);
+  }
+  return Out;
+}
+
+inline size_t FileHeaderBytes(void)
+{
+  return FileHeaderSize + NumColumns * ColumnNameSize;
+}
+
+
+//
+// one chunk's rows, column by column
+//
+struct ChunkIndex
+{
+  int64_t Min, Max, First;
+  uint32_t Offset, Bytes;
+};
+
+class ChunkBuilder
+{
+public:
+  std::vector<int64_t> Values[NumColumns];
+
+  size_t Rows(void) const { return Values[0].size(); }
+
+  void Add(const int64_t (&Row)[NumColumns])
+  {
+    for (int c = 0; c < NumColumns; c++)
+      Values[c].push_back(Row[c]);
+  }
+
+  std::vector<uint8_t> Encode(void)
+  {
+    std::vector<uint8_t> Payload;
+    ChunkIndex Index[NumColumns];
+    for (int c = 0; c < NumColumns; c++)
+    {
+      const std::vector<int64_t>& V = Values[c];
+      Index[c] = {V[0], V[0], V[0], (uint32_t)Payload.size(), 0};
+      int64_t Last = V[0], LastDelta = 0;
+      for (size_t i = 1; i < V.size(); i++)
+      {
+        int64_t Delta = V[i] - Last;
+        PutVarint(Payload, Columns[c].Enc == DeltaOfDelta ? Delta - LastDelta : Delta);
+        LastDelta = Delta;
+        Last = V[i];
+        Index[c].Min = std::min(Index[c].Min, V[i]);
+        Index[c].Max = std::max(Index[c].Max, V[i]);
+      }
+      Index[c].Bytes = (uint32_t)(Payload.size() - Index[c].Offset);
+    }
+    std::vector<uint8_t> Body;
+    for (const ChunkIndex& I : Index)
+    {
+      Put(Body, (uint64_t)I.Min, 8);
+      Put(Body, (uint64_t)I.Max, 8);
+      Put(Body, (uint64_t)I.First, 8);
+      Put(Body, I.Offset, 4);
+      Put(Body, I.Bytes, 4);
+    }
+    Body.insert(Body.end(), Payload.begin(), Payload.end());
+    std::vector<uint8_t> Out;
+    Put(Out, ChunkMagic, 4);
+    Put(Out, (uint32_t)Rows(), 4);
+    Put(Out, (uint32_t)Payload.size(), 4);
+    Put(Out, Crc32(Body.data(), Body.size()), 4);
+    Out.insert(Out.end(), Body.begin(), Body.end());
+    for (auto& V : Values)
+      V.clear();
+    return Out;
+  }
+};
+
+
+//
+// reads a log file: the chunk headers first, then column data on request
+//
+struct ChunkInfo
+{
+  uint64_t FileOffset;                              // start of the chunk header
+  uint32_t Rows;
+  ChunkIndex Index[NumColumns];
+};
+
+class Reader
+{
+public:
+  std::vector<ChunkInfo> Chunks;
+  uint64_t GoodBytes = 0;                           // file length up to the end of the last good chunk
+  uint64_t FileBytes = 0;
+  int64_t Created = 0;
+  uint64_t HeaderBytesRead = 0;                     // how much of the file a query has read
+  uint64_t DataBytesRead = 0;
+  std::string Error;
+
+  ~Reader() { if (Fd >= 0) close(Fd); }
+
+  //
+  // open and read the chunk headers; with CheckData, also check every chunk's CRC
+  // (the daemon does, before appending; a query trusts the lengths and checks what it reads)
+  //
+  bool Open(const std::string& Path, bool CheckData = false)
+  {
+    Fd = open(Path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (Fd < 0)
+    {
+      Error = Path + ": " + strerror(errno);
+      return false;
+    }
+    struct stat St;
+    fstat(Fd, &St);
+    FileBytes = (uint64_t)St.st_size;
+    std::vector<uint8_t> Header(FileHeaderBytes());
+    if (!ReadAt(0, Header.data(), Header.size()) || memcmp(Header.data(), Magic, 8) != 0)
+    {
+      Error = Path + ": not a bridge log";
+      return false;
+    }
+    if (Get(&Header[8], 2) != Version || Get(&Header[10], 2) != NumColumns)
+    {
+      Error = Path + ": unsupported log version or columns";
+      return false;
+    }
+    Created = (int64_t)Get(&Header[16], 8);
+    uint64_t Offset = Header.size();
+    GoodBytes = Offset;
+    const size_t IndexBytes = NumColumns * ColumnIndexSize;
+    std::vector<uint8_t> Buffer(ChunkHeaderSize + IndexBytes);
+    while (Offset + Buffer.size() <= FileBytes)
+    {
+      if (!ReadAt(Offset, Buffer.data(), Buffer.size()))
+        break;
+      HeaderBytesRead += Buffer.size();
+      uint32_t Rows = (uint32_t)Get(&Buffer[4], 4);
+      uint32_t PayloadBytes = (uint32_t)Get(&Buffer[8], 4);
+      uint64_t End = Offset + Buffer.size() + PayloadBytes;
+      if (Get(&Buffer[0], 4) != ChunkMagic || Rows == 0 || Rows > MaxChunkRows || End > FileBytes)
+        break;
+      ChunkInfo Info;
+      Info.FileOffset = Offset;
+      Info.Rows = Rows;
+      for (int c = 0; c < NumColumns; c++)
+      {
+        const uint8_t* p = &Buffer[ChunkHeaderSize + c * ColumnIndexSize];
+        Info.Index[c] = {(int64_t)Get(p, 8), (int64_t)Get(p + 8, 8), (int64_t)Get(p + 16, 8),
+                         (uint32_t)Get(p + 24, 4), (uint32_t)Get(p + 28, 4)};
+      }
+      if (CheckData)
+      {
+        std::vector<uint8_t> Body(IndexBytes + PayloadBytes);
+        if (!ReadAt(Offset + ChunkHeaderSize, Body.data(), Body.size())
+            || Crc32(Body.data(), Body.size()) != Get(&Buffer[12], 4))
+          break;
+      }
+      Chunks.push_back(Info);
+      Offset = End;
+      GoodBytes = End;
+    }
+    return true;
+  }
+
+  //
+  // decode one column of a chunk
+  //
+  bool ReadColumn(const ChunkInfo& Chunk, int Column, std::vector<int64_t>& Values)
+  {
+    const ChunkIndex& I = Chunk.Index[Column];
+    std::vector<uint8_t> Data(I.Bytes);
+    uint64_t Start = Chunk.FileOffset + ChunkHeaderSize + NumColumns * ColumnIndexSize + I.Offset;
+    if (!ReadAt(Start, Data.data(), Data.size()))
+      return false;
+    DataBytesRead += Data.size();
+    Values.resize(Chunk.Rows);
+    Values[0] = I.First;
+    const uint8_t* p = Data.data();
+    const uint8_t* End = p + Data.size();
+    int64_t Delta = 0;
+    for (uint32_t r = 1; r < Chunk.Rows; r++)
+    {
+      int64_t Value;
+      if (!GetVarint(p, End, Value))
+        return false;
+      Delta = Columns[Column].Enc == DeltaOfDelta ? Delta + Value : Value;
+      Values[r] = Values[r - 1] + Delta;
+    }
+    return p == End;
+  }
+
+private:
+  int Fd = -1;
+
+  bool ReadAt(uint64_t Offset, uint8_t* Data, size_t Length)
+  {
+    return pread(Fd, Data, Length, (off_t)Offset) == (ssize_t)Length;
+  }
+};
+
+}   // namespace columnlog
+
+#endif      // file sentry
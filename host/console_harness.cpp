@@ -0,0 +1,355 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// console_harness.cpp
+// test harness for the USB serial console. It builds the sketch's
+// console.cpp and telemetry.cpp against shim/Arduino.h, with the rest of
+// the sketch replaced by simple stand-ins, and drives them through a pty
+// exactly as a PC would: commands are written to the pty, and the replies
+// (and telemetry frames) read back from it. The sketch code runs in this
+// thread, one loop() pass at a time, so every run is the same.
+//
+// build (from host/):
+//   g++ -std=c++17 -O2 -Wall -Ishim -I../sketch/Log_VSWR_sketch -o console_harness console_harness.cpp
+//       shim/Arduino.cpp ../sketch/Log_VSWR_sketch/console.cpp ../sketch/Log_VSWR_sketch/telemetry.cpp
+// run: ./console_harness   (exit status 0 if every check passes)
+/////////////////////////////////////////////////////////////////////////
+
+#include "bridgeproto.h"
+
+#include "globalinclude.h"
+#include "console.h"
+#include "telemetry.h"
+#include "analogueio.h"
+#include "ballistics.h"
+#include "configdata.h"
+#include "display.h"
+#include "displaymodel.h"
+#include <Nextion.h>
+
+#include <cstdio>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <string>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// stand-ins for the rest of the sketch
+//
+int GForwardTenthdBm = 432;
+int GReverseTenthdBm = -5;
+unsigned int GFwdLineVoltageTenth, GRevLineVoltageTenth;
+unsigned int GVSWR = 16;
+unsigned long GSamplesProcessed = 123456;
+unsigned int GSamplesLost = 3;
+unsigned int GBlocksTorn = 1;
+volatile bool GTripped;
+unsigned int GTripCount = 2;
+unsigned int GDisplayBytesPerSecond = 1500;
+uint16_t nexTxHighWater = 90, nexTxRejectCount = 4, nexRxErrorCount = 7, nexRxFrameErrorCount = 9;
+
+byte GDisplayPageInUse = 1, GDisplayScaleInUse, GMeterModeInUse, GBandInUse = 5, GDisplayBaudInUse;
+bool GOversampleInUse;
+CalibrationSet GCalibrationSets[VNUMBANDS];
+BallisticsParams GBallistics = {100, 3, 3, 0, 5};
+ProtectionParams GProtection;
+DetectorParams GDetector;
+unsigned int GPowerFullScale[VNUMSCALES] = {2, 20, 200, 2000};
+const char* GMeterModeNames[VNUMMETERMODES] = {"Average", "Peak", "PEP", "EMA", "SSB"};
+
+bool PageBusy;                                  // DisplaySetPage() fails while set
+unsigned TelemetryEnables, BandSelects, CalibrationSets;
+byte Image[104];
+
+unsigned int GetPowerReading(bool IsFwd, bool) { return IsFwd ? 209 : 20; }
+unsigned int FindPeakPower(bool IsFwd, bool) { return IsFwd ? 250 : 25; }
+unsigned int GetMeterPower(bool IsFwd, bool) { return IsFwd ? 215 : 21; }
+void AnalogueIOSetOversampling(bool) {}
+void AnalogueIOSetCalibration(void) { CalibrationSets++; }
+void AnalogueIOSelectBand(byte) { BandSelects++; }
+void AnalogueIOEnableTelemetry(bool) { TelemetryEnables++; }
+void AnalogueIOGetTelemetry(TelemetryData* Data)
+{
+  memset(Data, 0, sizeof(*Data));
+  Data->FwdCount = Data->RevCount = 10;
+  Data->FwdSum = 10 * 12000;
+  Data->FwdTenthdBm = 432;
+  Data->VSWR = 16;
+}
+void BallisticsLoadPreset(byte Preset) { const BallisticsParams P[3] = {{100, 3, 3, 0, 5}, {25, 2, 2, 0, 3}, {250, 4, 5, 1, 6}}; GBallistics = P[Preset]; }
+bool DisplaySetPage(byte Page) { if (PageBusy) return false; GDisplayPageInUse = Page; return true; }
+void DisplaySetScale(byte Scale) { GDisplayScaleInUse = Scale; }
+void DisplaySetMeterMode(byte Mode) { GMeterModeInUse = Mode; }
+void EEWriteBand(byte Value) { GBandInUse = Value; }
+void EEWriteCalibrationSets(void) {}
+void EEWriteBallistics(void) {}
+void ConfigCheckSettings(void) { if (GBandInUse >= VNUMBANDS) GBandInUse = e20m; }
+byte ConfigImageLength(void) { return sizeof(Image); }
+byte ConfigGetImageByte(byte Position) { return Image[Position]; }
+void ConfigSetImageByte(byte Position, byte Value) { Image[Position] = Value; }
+unsigned int CRC16Update(unsigned int CRC, byte Data) { return bridge::Crc16(&Data, 1, (uint16_t)CRC); }
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// the PC side
+//
+int Pc;                                         // pty slave: the PC end
+std::vector<uint8_t> PcChunk;                  // received since the last line or frame ended
+std::vector<std::string> Lines;                 // reply lines received
+unsigned FramesGood, FramesBad;
+unsigned MaxReadsPerPass;
+uint64_t PcBytesSent, PcBytesReceived;
+int Failures;
+
+//
+// split what the PC receives into text lines and telemetry frames
+// text is printable; every frame has a control character (its type byte) in it
+//
+bool IsText(const std::vector<uint8_t>& Chunk)
+{
+  for (uint8_t Ch : Chunk)
+    if ((Ch < 0x20 || Ch >= 0x7F) && Ch != '\r')
+      return false;
+  return true;
+}
+
+void PcReceive(void)
+{
+  uint8_t Buffer[4096];
+  ssize_t n;
+  while ((n = read(Pc, Buffer, sizeof(Buffer))) > 0)
+  {
+    PcBytesReceived += n;
+    for (ssize_t i = 0; i < n; i++)
+    {
+      uint8_t Ch = Buffer[i];
+      if (Ch == '\n' && IsText(PcChunk))
+      {
+        std::string Line(PcChunk.begin(), PcChunk.end());
+        if (!Line.empty() && Line.back() == '\r')
+          Line.pop_back();
+        Lines.push_back(Line);
+        PcChunk.clear();
+      }
+      else if (Ch == 0)
+      {
+        if (!PcChunk.empty())
+        {
+          std::vector<uint8_t> Decoded;
+          bridge::Telemetry T;
+          if (bridge::CobsDecode(PcChunk.data(), PcChunk.size(), Decoded) && bridge::ParseTelemetry(Decoded, T))
+            FramesGood++;
+          else
+            FramesBad++;
+        }
+        PcChunk.clear();
+      }
+      else
+        PcChunk.push_back(Ch);
+    }
+  }
+}
+
+//
+// run the sketch for a number of loop() passes, 100us apart
+// the pty passes data on a little later, so if anything written to it hasn't
+// reached the other end yet, wait for it
+//
+void Run(unsigned Passes)
+{
+  for (unsigned i = 0; i < Passes; i++)
+  {
+    Serial.ReadsThisPass = 0;
+    ConsoleService();
+    TelemetryService();
+    MaxReadsPerPass = std::max(MaxReadsPerPass, Serial.ReadsThisPass);
+    Serial.Drain();
+    ShimMicros += 100;
+    PcReceive();
+    if ((PcBytesSent > Serial.BytesRead && Serial.available() == 0) || Serial.BytesWritten > PcBytesReceived)
+    {
+      pollfd P[2] = {{Serial.Fd, POLLIN, 0}, {Pc, POLLIN, 0}};
+      poll(P, 2, 10);
+      PcReceive();
+    }
+  }
+}
+
+void PcSend(const std::vector<uint8_t>& Data)
+{
+  bridge::WriteAll(Pc, Data);
+  PcBytesSent += Data.size();
+}
+
+void PcSend(const std::string& Text)
+{
+  PcSend(std::vector<uint8_t>(Text.begin(), Text.end()));
+}
+
+//
+// send a command and collect the reply lines
+//
+std::vector<std::string> Command(const std::string& Line, unsigned Passes = 200)
+{
+  Lines.clear();
+  PcSend(Line + "\r\n");
+  Run(Passes);
+  return Lines;
+}
+
+void Check(bool Ok, const std::string& What)
+{
+  printf("%s  %s\n", Ok ? "pass" : "FAIL", What.c_str());
+  if (!Ok)
+    Failures++;
+}
+
+void Expect(const std::string& Line, const std::string& Reply)
+{
+  std::vector<std::string> Got = Command(Line);
+  bool Ok = Got.size() == 1 && Got[0] == Reply;
+  Check(Ok, "\"" + Line + "\" -> \"" + Reply + "\"");
+  if (!Ok)
+    for (auto& G : Got)
+      printf("      got \"%s\"\n", G.c_str());
+}
+
+bool StartsWith(const std::string& S, const std::string& Prefix)
+{
+  return S.compare(0, Prefix.size(), Prefix) == 0;
+}
+
+
+int main(void)
+{
+  int Master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (Master < 0 || grantpt(Master) != 0 || unlockpt(Master) != 0)
+  {
+    perror("pty");
+    return 1;
+  }
+  Pc = bridge::OpenSerial(ptsname(Master));
+  if (Pc < 0)
+  {
+    perror("pty slave");
+    return 1;
+  }
+  fcntl(Master, F_SETFL, fcntl(Master, F_GETFL) | O_NONBLOCK);
+  fcntl(Pc, F_SETFL, fcntl(Pc, F_GETFL) | O_NONBLOCK);
+  Serial.Fd = Master;
+  for (size_t i = 0; i < sizeof(Image); i++)
+    Image[i] = (byte)(i * 7);
+  TelemetryInit();
+
+  //
+  // queries and settings
+  //
+  Expect("ver", "ver product 4 sw 2 hw 1");
+  Expect("read", "read fwddbm 43.2 revdbm -0.5 fwdavg 20.9 fwdpk 25.0 revavg 2.0 revpk 2.5 meter 21.5 vswr 1.6 trip 0");
+  Expect("scale 2", "scale 2 fullscale 200");
+  Expect("scale", "scale 2 fullscale 200");
+  Expect("scale 4", "ERR bad value");
+  Expect("scale x", "ERR bad value");
+  Expect("page 3", "page 3");
+  Expect("page 0", "ERR bad value");
+  PageBusy = true;
+  Expect("page 2", "ERR busy");
+  PageBusy = false;
+  Expect("mode 2", "mode 2 PEP");
+  Expect("ball 50 2 3 0 4", "ball hold 50 decay 2 ema 3 attack 0 release 4");
+  Expect("ball 50 2 3 0 16", "ERR bad value");
+  Expect("ball preset 1", "ball hold 25 decay 2 ema 2 attack 0 release 3");
+  Expect("band 3", "band 3");
+  Expect("band 11", "ERR bad value");
+  Expect("cal 3 12900 1 2 3 -4 -128", "cal 3 coupling 12900 corr 1 2 3 -4 -128");
+  Expect("cal 4", "cal 4 coupling 0 corr 0 0 0 0 0");
+  Expect("cal 3 12900 1 2", "ERR bad value");
+  Expect("cal 3 12900 1 2 3 4 128", "ERR bad value");
+  Check(BandSelects == 2, "band in use reselected after band and cal commands");
+  Expect("rate", "rate 0");
+  Expect("  SCALE   1  ", "scale 1 fullscale 20");
+  Expect("vex\bx\x7fr", "ver product 4 sw 2 hw 1");
+  Expect("frobnicate", "ERR unknown command");
+  Expect("cal 1 2 3 4 5 6 7 8", "ERR too many values");
+  Expect(std::string(60, 'a'), "ERR line too long");
+  Expect("ver", "ver product 4 sw 2 hw 1");
+
+  //
+  // settings image: dump, write, dump again
+  //
+  std::vector<std::string> Dump = Command("image", 2000);
+  Check(Dump.size() == 8 && Dump[0] == "image length 104", "image dump is a length and 7 lines");
+  Check(Dump.size() > 1 && Dump[1] == "image 0 00070E151C232A31383F464D545B6269", "image dump first line");
+  Check(Dump.size() > 7 && Dump[7] == "image 96 A0A7AEB5BCC3CAD1", "image dump last line");
+  Expect("image 10 a5B6", "image 10 A5B6");
+  Check(Image[10] == 0xA5 && Image[11] == 0xB6, "image bytes written");
+  Expect("image 103 0102", "ERR bad value");
+  Expect("image 10 a5b", "ERR bad value");
+  Expect("image 10 zz", "ERR bad value");
+  Check(Image[10] == 0xA5, "bad image write changes nothing");
+  Check(CalibrationSets == 1, "settings applied after an image write");
+
+  //
+  // statistics
+  //
+  std::vector<std::string> Stats = Command("stats", 500);
+  Check(Stats.size() == 3 && Stats[0] == "stats samples 123456 lost 3 torn 1 trips 2", "stats line 1");
+  Check(Stats.size() == 3 && Stats[1] == "stats displaybytes 1500 queuehigh 90 rejected 4 rxerrors 7 frameerrors 9", "stats line 2");
+  Check(Stats.size() == 3 && StartsWith(Stats[2], "stats framessent 0 framesskipped 0 commands "), "stats line 3");
+  Stats = Command("stats clear", 500);
+  Check(Stats.size() == 3 && Stats[0] == "stats samples 0 lost 0 torn 0 trips 0", "stats cleared");
+  Check(Stats.size() == 3 && Stats[1] == "stats displaybytes 1500 queuehigh 0 rejected 0 rxerrors 0 frameerrors 0", "display errors cleared");
+  Check(nexRxErrorCount == 7, "display link error counts left alone");
+  Check(Stats.size() == 3 && Stats[2] == "stats framessent 0 framesskipped 0 commands 0 errors 0", "console counts cleared");
+
+  //
+  // flood: a lot of input at once must only ever be read a few bytes per pass
+  //
+  std::string Flood;
+  for (int i = 0; i < 200; i++)
+    Flood += (i % 3) ? "junk\r\n" : std::string(70, 'z') + "\n";
+  Lines.clear();
+  MaxReadsPerPass = 0;
+  PcSend(Flood);
+  Run(4000);
+  Check(MaxReadsPerPass <= VCONSOLEBYTESPERPASS, "flood read at most " + std::to_string(VCONSOLEBYTESPERPASS) +
+        " bytes per pass (max " + std::to_string(MaxReadsPerPass) + ")");
+  Check(Lines.size() == 200, "one reply per flood line (" + std::to_string(Lines.size()) + ")");
+  Expect("ver", "ver product 4 sw 2 hw 1");
+
+  //
+  // telemetry on the same port: a binary rate request holding a LF byte (rate 10),
+  // then commands while frames are being sent at the full rate
+  //
+  Lines.clear();
+  PcSend(bridge::EncodeSetRate(10));
+  Run(100);
+  Check(TelemetryGetRate() == 10 && Lines.empty(), "binary rate request (rate 10) taken by telemetry");
+  Expect("rate 500", "rate 500");
+  FramesGood = FramesBad = 0;
+  unsigned SentBefore = GTelemetryFramesSent;
+  Lines.clear();
+  for (int i = 0; i < 20; i++)
+  {
+    PcSend("read\r\nstats\r\n");
+    Run(500);
+  }
+  Check(Lines.size() == 80, "all replies received with telemetry running (" + std::to_string(Lines.size()) + ")");
+  bool AllGood = true;
+  for (auto& L : Lines)
+    if (!StartsWith(L, "read fwddbm") && !StartsWith(L, "stats "))
+      AllGood = false;
+  Check(AllGood, "replies intact with telemetry running");
+  Expect("rate 0", "rate 0");
+  Check(FramesBad == 0 && FramesGood >= 450, "telemetry frames intact over 1s at 500/s (" + std::to_string(FramesGood) +
+        " good, " + std::to_string(FramesBad) + " bad, " + std::to_string(GTelemetryFramesSkipped) + " skipped for replies)");
+  Check(GTelemetryFramesSent - SentBefore == FramesGood, "every frame sent was received");
+
+  printf("%s: %d failure(s)\n", Failures ? "FAILED" : "passed", Failures);
+  return Failures ? 1 : 0;
+}
@@ -0,0 +1,129 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// displaymodel_harness.cpp
+// test harness for the display model's byte budget. It builds the sketch's
+// displaymodel.cpp and the display library against shim/Arduino.h, with the
+// display item values set by this end, and checks what each tick sends when
+// the transmit queue already holds bytes from the needles or trend page.
+//
+// build (from host/):
+//   g++ -std=c++17 -O2 -Wall -Ishim -I../sketch/Log_VSWR_sketch -I../displays/arduino_library_update
+//       -o displaymodel_harness displaymodel_harness.cpp shim/Arduino.cpp
+//       ../sketch/Log_VSWR_sketch/displaymodel.cpp ../displays/arduino_library_update/NexHardware.cpp
+// run: ./displaymodel_harness   (exit status 0 if every check passes)
+/////////////////////////////////////////////////////////////////////////
+
+#include "displaymodel.h"
+#include "display.h"
+#include "NexHardware.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+int Failures;
+
+void NexTouch::iterate(NexTouch**, uint8_t, uint8_t, int32_t) {}
+
+//
+// the display item values, as display.cpp would find them
+//
+int ItemValues[VNUMDISPLAYITEMS];
+
+int GetDisplayItemValue(EDisplayItem Item)
+{
+  return ItemValues[Item];
+}
+
+void Check(bool Ok, const std::string& What)
+{
+  printf("%s  %s\n", Ok ? "pass" : "FAIL", What.c_str());
+  if (!Ok)
+    Failures++;
+}
+
+//
+// send everything queued, as the UART would in a tick at a fast rate (the shim drops it)
+//
+void EmptyQueue(void)
+{
+  while (nexTxUsed() != 0)
+  {
+    nexTxService();
+    Serial1.Drain();
+  }
+}
+
+//
+// queue bytes from something else (needle lines or trend data) until Used are waiting
+//
+void FillQueue(unsigned Used)
+{
+  std::vector<uint8_t> Data(Used > nexTxUsed() ? Used - nexTxUsed() : 0, 'x');
+  nexTrySendData(Data.data(), (uint16_t)Data.size());
+}
+
+//
+// bytes one page update puts in the queue, with Queued bytes already waiting
+//
+unsigned UpdateBytes(long Baud, unsigned Queued)
+{
+  EmptyQueue();
+  DisplayModelInit(Baud);
+  FillQueue(Queued);
+  DisplayModelUpdate(ePowerBargraphPage);
+  return nexTxUsed() - Queued;
+}
+
+
+int main(void)
+{
+  uint16_t Rejects = nexTxRejectCount;
+
+  //
+  // one update, every page 2 item not yet drawn (72 bytes for all five)
+  //
+  unsigned Bytes = UpdateBytes(921600, 0);
+  Check(Bytes > 50 && Bytes <= 640, "921600 baud, empty queue: the whole page is sent (" + std::to_string(Bytes)
+                                    + " bytes)");
+  Bytes = UpdateBytes(921600, 128);
+  Check(Bytes > 50, "921600 baud, half full queue: the page is still sent (" + std::to_string(Bytes) + " bytes)");
+  Bytes = UpdateBytes(921600, 240);
+  Check(Bytes <= 14, "921600 baud, nearly full queue: no more than the free space (" + std::to_string(Bytes)
+                     + " bytes)");
+  Bytes = UpdateBytes(115200, 128);
+  Check(Bytes <= 230 - 128, "115200 baud, half full queue: no more than the tick's budget left ("
+                            + std::to_string(Bytes) + " bytes)");
+  Bytes = UpdateBytes(19200, 0);
+  Check(Bytes <= 38, "19200 baud, empty queue: no more than the tick's budget (" + std::to_string(Bytes)
+                     + " bytes)");
+  Check(nexTxRejectCount == Rejects, "no command rejected for want of queue space");
+
+  //
+  // a second at 921600 baud with 128 bytes of trend data waiting every tick and the
+  // bars changing every tick: the forward bar (period 1 tick) must keep 50Hz
+  //
+  EmptyQueue();
+  DisplayModelInit(921600);
+  DisplayModelInvalidate();
+  for (int Tick = 0; Tick < 100; Tick++)
+  {
+    ItemValues[eItemP2FwdBar] = 10 + (Tick % 2) * 10;
+    ItemValues[eItemP2VSWRBar] = Tick;
+    FillQueue(128);
+    DisplayModelUpdate(ePowerBargraphPage);
+    DisplayModelTick();
+    EmptyQueue();
+  }
+  printf("      rates with 128 bytes waiting: forward bar %dHz, VSWR bar %dHz\n",
+         GetDisplayItemRate(eItemP2FwdBar), GetDisplayItemRate(eItemP2VSWRBar));
+  Check(GetDisplayItemRate(eItemP2FwdBar) == 50, "921600 baud: forward bar at 50Hz with the queue half full");
+  Check(GetDisplayItemRate(eItemP2VSWRBar) == 25, "and the VSWR bar at its 25Hz target");
+
+  printf("\n%s: %d failure(s)\n", Failures ? "FAILED" : "passed", Failures);
+  return Failures ? 1 : 0;
+}
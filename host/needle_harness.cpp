@@ -0,0 +1,196 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// needle_harness.cpp
+// checks the crossed needle end point tables in crossedneedle.cpp against
+// the float sin() and cos() calculation display.cpp used to make on every
+// redraw. The AVR's double is a 32 bit float, so that calculation is done
+// here in float too; every table entry must give the same pixel.
+// It then builds every crossed needle frame the sketch can send, from every
+// pair of old angles to every pair of new ones, with crossedneedle.cpp and
+// the display library, and measures the bytes each puts in the transmit queue.
+//
+// build (from host/):
+//   g++ -std=c++17 -O2 -Wall -Ishim -I../sketch/Log_VSWR_sketch -I../displays/arduino_library_update
+//       -o needle_harness needle_harness.cpp shim/Arduino.cpp ../sketch/Log_VSWR_sketch/crossedneedle.cpp
+//       ../displays/arduino_library_update/NexHardware.cpp
+// run: ./needle_harness   (exit status 0 if every check passes)
+/////////////////////////////////////////////////////////////////////////
+
+#include "crossedneedle.h"
+#include "NexHardware.h"
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+
+int Failures;
+
+void NexTouch::iterate(NexTouch**, uint8_t, uint8_t, int32_t) {}
+
+void Check(bool Ok, const std::string& What)
+{
+  printf("%s  %s\n", Ok ? "pass" : "FAIL", What.c_str());
+  if (!Ok)
+    Failures++;
+}
+
+//
+// the old DisplayTick() calculation, for one needle
+//
+struct NeedleEnd
+{
+  int X2, Y2;
+};
+
+NeedleEnd FloatNeedle(bool IsForward, int Degrees)
+{
+  float X, Y;
+  float Angle;
+  int X1, Y1;
+  NeedleEnd End;
+
+  Y1 = VXNEEDLEY1;
+  Angle = (float)Degrees * (float)M_PI / 180.0f;
+  if (IsForward)
+  {
+    X1 = VXNEEDLEFWDX1;
+    X = X1 - (float)VNEEDLESIZE * cosf(Angle);
+  }
+  else
+  {
+    X1 = VXNEEDLEREVX1;
+    X = X1 + (float)VNEEDLESIZE * cosf(Angle);
+  }
+  End.X2 = (int)X;
+  Y = Y1 - (float)VNEEDLESIZE * sinf(Angle);
+  End.Y2 = (int)Y;
+  return End;
+}
+
+//
+// the same in double, to show which pixels depend on float rounding
+//
+NeedleEnd DoubleNeedle(bool IsForward, int Degrees)
+{
+  double Angle = Degrees * M_PI / 180.0;
+  double Offset = VNEEDLESIZE * cos(Angle);
+  NeedleEnd End;
+
+  End.X2 = (int)(IsForward ? VXNEEDLEFWDX1 - Offset : VXNEEDLEREVX1 + Offset);
+  End.Y2 = (int)(VXNEEDLEY1 - VNEEDLESIZE * sin(Angle));
+  return End;
+}
+
+
+//
+// bytes per crossed needle frame. Each frame starts with an empty transmit queue, as
+// DisplayTick() only sends one with VNEEDLEFRAMESPACE bytes free, and must fit in that.
+// Picture 22 (2KW scale) is a two digit picture number, the longest erase command.
+//
+#define VPICTURE 22
+#define VTICKMS 20                                  // display tick
+#define VBAUD 115200
+
+struct FrameBytes
+{
+  unsigned Frames = 0, Worst = 0, OverSpace = 0;
+  uint64_t Total = 0;
+  void Add(unsigned Bytes)
+  {
+    Frames++;
+    Total += Bytes;
+    Worst = std::max(Worst, Bytes);
+    if (Bytes > VNEEDLEFRAMESPACE)
+      OverSpace++;
+  }
+};
+
+unsigned Frame(int Forward, int Reverse, int OldForward, int OldReverse)
+{
+  uint32_t Start = nexTxByteCount;
+
+  SendCrossedNeedleFrame(Forward, Reverse, OldForward, OldReverse, VPICTURE);
+  while (nexTxUsed() != 0)                          // the shim drops what is sent
+  {
+    nexTxService();
+    Serial1.Drain();
+  }
+  return nexTxByteCount - Start;
+}
+
+void Report(const char* What, const FrameBytes& Bytes)
+{
+  printf("      %-22s %9u frames: mean %5.1f, worst %3u bytes (%.1fms at %d baud)\n", What, Bytes.Frames,
+         (double)Bytes.Total / Bytes.Frames, Bytes.Worst, Bytes.Worst * 10.0 * 1000.0 / VBAUD, VBAUD);
+}
+
+void FrameTest(void)
+{
+  FrameBytes First, OneMoves, BothMove;
+  uint16_t Rejects = nexTxRejectCount;
+  const int Low = VMINNEEDLEANGLE, High = VMINNEEDLEANGLE + VNUMNEEDLEANGLES;
+
+  for (int Forward = Low; Forward < High; Forward++)
+    for (int Reverse = Low; Reverse < High; Reverse++)
+      First.Add(Frame(Forward, Reverse, -100, -100));    // nothing to erase: after the page is shown
+  for (int Old = Low; Old < High; Old++)
+    for (int New = Low; New < High; New++)
+      for (int Other = Low; New != Old && Other < High; Other++)
+      {
+        OneMoves.Add(Frame(New, Other, Old, Other));
+        OneMoves.Add(Frame(Other, New, Other, Old));
+      }
+  for (int OldForward = Low; OldForward < High; OldForward++)
+    for (int OldReverse = Low; OldReverse < High; OldReverse++)
+      for (int Forward = Low; Forward < High; Forward++)
+        for (int Reverse = Low; Forward != OldForward && Reverse < High; Reverse++)
+          if (Reverse != OldReverse)
+            BothMove.Add(Frame(Forward, Reverse, OldForward, OldReverse));
+
+  Report("first frame", First);
+  Report("one needle moves", OneMoves);
+  Report("both needles move", BothMove);
+  Check(First.OverSpace + OneMoves.OverSpace + BothMove.OverSpace == 0 && nexTxRejectCount == Rejects,
+        "every frame fits in VNEEDLEFRAMESPACE (" + std::to_string(VNEEDLEFRAMESPACE) + " bytes)");
+  Check(BothMove.Worst * 10 * 1000 < VTICKMS * VBAUD, "the worst frame is sent within one 20ms tick at 115200 baud");
+}
+
+
+int main(void)
+{
+  unsigned Mismatches = 0, OffScreen = 0;
+
+  for (int Index = 0; Index < VNUMNEEDLEANGLES; Index++)
+  {
+    int Degrees = VMINNEEDLEANGLE + Index;
+    NeedleEnd Rev = FloatNeedle(false, Degrees);
+    NeedleEnd Fwd = FloatNeedle(true, Degrees);
+    NeedleEnd DoubleRev = DoubleNeedle(false, Degrees);
+    NeedleEnd DoubleFwd = DoubleNeedle(true, Degrees);
+
+    if ((int)GRevNeedleX[Index] != Rev.X2 || (int)GFwdNeedleX[Index] != Fwd.X2 || (int)GNeedleY[Index] != Rev.Y2
+        || Rev.Y2 != Fwd.Y2)
+    {
+      printf("      %d degrees: table (%u,%u) (%u,%u), float (%d,%d) (%d,%d)\n", Degrees, GRevNeedleX[Index],
+             GNeedleY[Index], GFwdNeedleX[Index], GNeedleY[Index], Rev.X2, Rev.Y2, Fwd.X2, Fwd.Y2);
+      Mismatches++;
+    }
+    if (DoubleRev.X2 != Rev.X2 || DoubleRev.Y2 != Rev.Y2 || DoubleFwd.X2 != Fwd.X2 || DoubleFwd.Y2 != Fwd.Y2)
+      printf("      %d degrees: double maths would give (%d,%d) (%d,%d); the table follows float\n", Degrees,
+             DoubleRev.X2, DoubleRev.Y2, DoubleFwd.X2, DoubleFwd.Y2);
+    if (GRevNeedleX[Index] >= 320 || GFwdNeedleX[Index] >= 320 || GNeedleY[Index] >= 240)
+      OffScreen++;
+  }
+  Check(Mismatches == 0, std::to_string(VNUMNEEDLEANGLES) + " angles from " + std::to_string(VMINNEEDLEANGLE)
+                         + " to 90 degrees: every end point is the float calculation's pixel");
+  Check(OffScreen == 0, "every end point is on the 320 x 240 display");
+
+  FrameTest();
+
+  printf("\n%s: %d failure(s)\n", Failures ? "FAILED" : "passed", Failures);
+  return Failures ? 1 : 0;
+}
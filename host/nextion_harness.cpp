@@ -0,0 +1,346 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// nextion_harness.cpp
+// test harness for the display library's return frame handling. It builds
+// NexHardware.cpp against shim/Arduino.h with Serial1 connected to a socket;
+// this end plays the display, reading the commands sent and writing return
+// frames back, in a set order with time moved on by hand. Last, a capture
+// of every frame type is played back split at random points, and the time
+// each nexLoop() call takes is measured.
+//
+// build (from host/):
+//   g++ -std=c++17 -O2 -Wall -Ishim -I../displays/arduino_library_update -o nextion_harness
+//       nextion_harness.cpp shim/Arduino.cpp ../displays/arduino_library_update/NexHardware.cpp
+// run: ./nextion_harness   (exit status 0 if every check passes)
+/////////////////////////////////////////////////////////////////////////
+
+#include "NexHardware.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+
+int Display;                                    // the display's end of Serial1
+int Failures;
+
+//
+// touch events passed on by nexLoop()
+//
+unsigned Touches;
+void NexTouch::iterate(NexTouch**, uint8_t, uint8_t, int32_t)
+{
+  Touches++;
+}
+
+//
+// results of the async gets: one per query, in the order the callbacks came
+//
+struct GetResult
+{
+  const char* Name;
+  bool Ok;
+  uint32_t Number;
+};
+std::vector<GetResult> Results;
+
+void GetCallback(void* Ptr, bool Ok, uint32_t Number)
+{
+  Results.push_back({(const char*)Ptr, Ok, Number});
+}
+
+
+//
+// one display tick: pass queued commands on, then handle what has come back
+//
+void Loop(void)
+{
+  nexTxService();
+  Serial1.Drain();
+  nexLoop(nullptr);
+}
+
+void Advance(unsigned Ms)
+{
+  ShimMicros += Ms * 1000UL;
+}
+
+void DisplaySend(const std::vector<uint8_t>& Frame)
+{
+  if (write(Display, Frame.data(), Frame.size()) != (ssize_t)Frame.size())
+    perror("display");
+}
+
+void DisplayNumber(uint32_t Number)
+{
+  DisplaySend({0x71, (uint8_t)Number, (uint8_t)(Number >> 8), (uint8_t)(Number >> 16), (uint8_t)(Number >> 24),
+               0xFF, 0xFF, 0xFF});
+}
+
+//
+// commands the display has been sent since last asked, terminators removed
+//
+std::vector<std::string> DisplayReceive(void)
+{
+  static std::string Partial;
+  std::vector<std::string> Commands;
+  uint8_t Buffer[256];
+  ssize_t n;
+  while ((n = read(Display, Buffer, sizeof(Buffer))) > 0)
+    Partial.append((const char*)Buffer, n);
+  size_t End;
+  while ((End = Partial.find("\xFF\xFF\xFF")) != std::string::npos)
+  {
+    Commands.push_back(Partial.substr(0, End));
+    Partial.erase(0, End + 3);
+  }
+  return Commands;
+}
+
+void Check(bool Ok, const std::string& What)
+{
+  printf("%s  %s\n", Ok ? "pass" : "FAIL", What.c_str());
+  if (!Ok)
+    Failures++;
+}
+
+void CheckResult(size_t Index, const char* Name, bool Ok, uint32_t Number, const std::string& What)
+{
+  bool Good = Index < Results.size() && Results[Index].Name == std::string(Name) && Results[Index].Ok == Ok
+              && (!Ok || Results[Index].Number == Number);
+  Check(Good, What);
+  if (!Good && Index < Results.size())
+    printf("      got %s ok %d number %u\n", Results[Index].Name, Results[Index].Ok, Results[Index].Number);
+}
+
+
+//
+// a capture of the display's return frames, one of each type, played back split at random
+// points so frames arrive over several nexLoop() calls. The number frame and the position
+// event have 0xFF bytes in their data. Each capture starts with a get query for its number.
+//
+std::vector<uint8_t> Capture(unsigned Index)
+{
+  uint32_t Number = 0x00FFFF00 | (Index & 0xFF);
+  return {0x65, 0x01, 0x02, 0x01, 0xFF, 0xFF, 0xFF,                             // touch
+          0x71, (uint8_t)Number, (uint8_t)(Number >> 8), (uint8_t)(Number >> 16), (uint8_t)(Number >> 24),
+          0xFF, 0xFF, 0xFF,                                                     // number
+          0x66, (uint8_t)(Index % 5), 0xFF, 0xFF, 0xFF,                         // page
+          0x70, 'O', 'K', 0xFF, 0xFF, 0xFF,                                     // string
+          0x01, 0xFF, 0xFF, 0xFF,                                               // ack
+          0x67, 0x00, 0xFF, 0x00, 0x20, 0x01, 0xFF, 0xFF, 0xFF,                 // position
+          0x1A, 0xFF, 0xFF, 0xFF,                                               // error
+          0x65, 0x02, 0x05, 0x00, 0xFF, 0xFF, 0xFF,                             // touch
+          0x88, 0xFF, 0xFF, 0xFF,                                               // launched
+          0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF};                                  // power on
+}
+
+void RandomSplitTest(void)
+{
+  const unsigned Captures = 500;
+  std::mt19937 Random(12);
+  std::uniform_int_distribution<size_t> Split(1, 16);
+  std::vector<uint8_t> Stream;
+  std::vector<size_t> Starts;
+  std::vector<double> Times;
+  unsigned Queries = 0, Overread = 0;
+
+  for (unsigned Index = 0; Index < Captures; Index++)
+  {
+    std::vector<uint8_t> Frames = Capture(Index);
+    Starts.push_back(Stream.size());
+    Stream.insert(Stream.end(), Frames.begin(), Frames.end());
+  }
+  Loop();
+  DisplayReceive();
+  Results.clear();
+  unsigned StartTouches = Touches;
+  uint16_t Acks = nexRxAckCount, Errors = nexRxErrorCount;
+  uint16_t Launches = nexRxLaunchCount, FrameErrors = nexRxFrameErrorCount;
+
+  for (size_t Sent = 0; Sent < Stream.size(); )
+  {
+    size_t Length = std::min(Split(Random), Stream.size() - Sent);
+    while (Queries < Captures && Starts[Queries] < Sent + Length)
+    {
+      nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"split");
+      Queries++;
+    }
+    nexTxService();
+    Serial1.Drain();
+    DisplayReceive();
+    DisplaySend(std::vector<uint8_t>(Stream.begin() + Sent, Stream.begin() + Sent + Length));
+    Sent += Length;
+
+    Serial1.ReadsThisPass = 0;
+    auto Start = std::chrono::steady_clock::now();
+    nexLoop(nullptr);
+    Times.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - Start).count());
+    if (Serial1.ReadsThisPass != Length)
+      Overread++;
+  }
+
+  bool Numbers = Results.size() == Captures;
+  for (unsigned Index = 0; Numbers && Index < Captures; Index++)
+    Numbers = Results[Index].Ok && Results[Index].Number == (0x00FFFF00 | (Index & 0xFF));
+  std::sort(Times.begin(), Times.end());
+  printf("      %u frames in %zu calls: nexLoop() median %.2fus, 99%% %.2fus, worst %.2fus (PC time)\n",
+         Captures * 10, Times.size(), Times[Times.size() / 2], Times[Times.size() * 99 / 100], Times.back());
+  Check(Overread == 0, "each call parses just the bytes that have arrived");
+  Check(Touches - StartTouches == 2 * Captures, "every touch event passed on");
+  Check(Numbers, "every number reply goes to its query, 0xFF bytes and all");
+  Check(nexCurrentPageId == (Captures - 1) % 5, "page frames track the current page");
+  Check((uint16_t)(nexRxAckCount - Acks) == Captures && (uint16_t)(nexRxErrorCount - Errors) == Captures
+        && (uint16_t)(nexRxLaunchCount - Launches) == Captures, "every ack, error and launch frame counted");
+  Check(nexRxFrameErrorCount == FrameErrors, "no frame errors, wherever the splits fall");
+}
+
+
+int main(void)
+{
+  int Fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, Fds) != 0)
+  {
+    perror("socketpair");
+    return 1;
+  }
+  fcntl(Fds[0], F_SETFL, fcntl(Fds[0], F_GETFL) | O_NONBLOCK);
+  fcntl(Fds[1], F_SETFL, fcntl(Fds[1], F_GETFL) | O_NONBLOCK);
+  Serial1.Fd = Fds[0];
+  Display = Fds[1];
+  ShimMicros = 1000000;
+
+  //
+  // a query answered in time, with a touch event arriving first
+  //
+  Check(nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"a"), "get sent");
+  Loop();
+  std::vector<std::string> Sent = DisplayReceive();
+  Check(Sent.size() == 1 && Sent[0] == "get p1bt0.val", "display receives \"get p1bt0.val\"");
+  DisplaySend({0x65, 0x01, 0x02, 0x01, 0xFF, 0xFF, 0xFF});
+  DisplayNumber(1);
+  Loop();
+  Check(Touches == 1, "touch event ahead of the reply is passed on");
+  CheckResult(0, "a", true, 1, "reply completes the query");
+  Check(nexGetPending() == 0, "nothing pending once answered");
+
+  //
+  // an error frame fails the oldest query; the next reply is the next query's
+  //
+  Results.clear();
+  nexGetNumberAsync("nosuch.val", GetCallback, (void*)"bad");
+  nexGetNumberAsync("p2bt1.val", GetCallback, (void*)"good");
+  Loop();
+  DisplaySend({0x1A, 0xFF, 0xFF, 0xFF});
+  DisplayNumber(7);
+  Loop();
+  Check(Results.size() == 2, "both queries completed");
+  CheckResult(0, "bad", false, 0, "0x1A error fails the oldest query");
+  CheckResult(1, "good", true, 7, "next reply goes to the next query");
+
+  //
+  // a query that times out: its late reply is dropped, not given to the next one
+  //
+  Results.clear();
+  nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"slow");
+  Loop();
+  Advance(101);
+  Loop();
+  CheckResult(0, "slow", false, 0, "query times out after 100ms");
+  Check(nexGetPending() == 1, "timed out query still held for its reply");
+  nexGetNumberAsync("p4bt1.val", GetCallback, (void*)"next");
+  Loop();
+  DisplayNumber(11);                            // the slow query's reply
+  Loop();
+  Check(Results.size() == 1, "late reply doesn't complete the next query");
+  DisplayNumber(12);
+  Loop();
+  CheckResult(1, "next", true, 12, "next query gets its own reply");
+  Check(nexGetPending() == 0, "nothing pending once both replies are in");
+
+  //
+  // a query whose reply never comes: forgotten after NEX_GET_LATE_MS
+  //
+  Results.clear();
+  nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"lost");
+  Loop();
+  Advance(101);
+  Loop();
+  Advance(NEX_GET_LATE_MS + 1);
+  Loop();
+  Check(nexGetPending() == 0, "lost reply forgotten after NEX_GET_LATE_MS");
+  nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"after");
+  Loop();
+  DisplayNumber(21);
+  Loop();
+  CheckResult(1, "after", true, 21, "query after a lost reply gets its own reply");
+
+  //
+  // a timed out query whose late reply is an error
+  //
+  Results.clear();
+  nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"slowbad");
+  Loop();
+  Advance(150);
+  Loop();
+  nexGetNumberAsync("p2bt1.val", GetCallback, (void*)"fine");
+  Loop();
+  DisplaySend({0x1A, 0xFF, 0xFF, 0xFF});
+  DisplayNumber(31);
+  Loop();
+  Check(Results.size() == 2, "both completed");
+  CheckResult(1, "fine", true, 31, "late error frame is dropped with its query");
+
+  //
+  // recvRetCommandFinished() waits for its own ack, not an earlier queued command's
+  //
+  ShimMicrosStep = 100;                         // time passes while it waits
+  Loop();
+  DisplayReceive();
+  nexTrySendCommand("p1t0.txt=\"a\"");
+  sendCommand("page 1");
+  DisplaySend({0x01, 0xFF, 0xFF, 0xFF});         // the first command's ack only
+  Check(!recvRetCommandFinished(), "ack for an earlier command isn't taken for this one");
+  Serial1.Drain();
+  nexTrySendCommand("p1t0.txt=\"b\"");
+  sendCommand("page 2");
+  DisplaySend({0x01, 0xFF, 0xFF, 0xFF, 0x01, 0xFF, 0xFF, 0xFF});
+  Check(recvRetCommandFinished(), "succeeds once every command is acknowledged");
+  Serial1.Drain();
+  Results.clear();
+  nexGetNumberAsync("p1bt0.val", GetCallback, (void*)"between");
+  sendCommand("page 3");
+  DisplayNumber(41);
+  DisplaySend({0x01, 0xFF, 0xFF, 0xFF});
+  Check(recvRetCommandFinished(), "a get in between needs no ack");
+  Loop();
+  CheckResult(0, "between", true, 41, "and still gets its reply");
+  Check(DisplayReceive().size() == 6, "display received every command");
+  ShimMicrosStep = 0;
+
+  //
+  // the display's power on frame isn't an error; an invalid instruction is
+  //
+  uint16_t Errors = nexRxErrorCount;
+  uint16_t Launches = nexRxLaunchCount;
+  DisplaySend({0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF, 0x88, 0xFF, 0xFF, 0xFF});
+  Loop();
+  Check(nexRxErrorCount == Errors && nexRxLaunchCount == Launches + 1, "power on frame not counted as an error");
+  DisplaySend({0x00, 0xFF, 0xFF, 0xFF});
+  Loop();
+  Check(nexRxErrorCount == Errors + 1, "invalid instruction counted as an error");
+
+  RandomSplitTest();
+
+  printf("\n%s: %d failure(s)\n", Failures ? "FAILED" : "passed", Failures);
+  return Failures ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// ring_bench.cpp
+// measures the shared memory ring (telemetryring.h) with 1, 4 and 16 readers,
+// replaying telemetry captured from a bridge (telemetry_decode -w).
+//
+// for each number of readers it runs twice:
+//   flat out  the frames are published as fast as the writer can go; shows the
+//             ring's throughput, and whether the readers keep up (overruns)
+//   paced     the frames are published at the bridge's rate; shows the delay
+//             from publish to a sleeping reader having the frame
+// each reader is a thread with its own mapping of the ring, as a separate
+// program would have.
+//
+// usage: ring_bench [-n frames] [-r rate] [-s slots] [-c readers,...] capture
+//   -n  frames to publish flat out (default 1000000)
+//   -r  paced rate, frames per second (default 500), for 2 seconds
+//   -s  ring slots (default 4096)
+//   -c  reader counts to try (default 1,4,16)
+/////////////////////////////////////////////////////////////////////////
+
+#include "bridgeproto.h"
+#include "telemetryring.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+using namespace bridge;
+
+
+struct ReaderResult
+{
+  uint64_t Received = 0;
+  uint64_t Overruns = 0;
+  std::vector<uint32_t> Delays;                     // ns, publish to read
+};
+
+struct RunResult
+{
+  double WriterRate;                                // frames per second published
+  uint64_t Received = 0, Overruns = 0;              // summed over the readers
+  uint32_t Median = 0, P99 = 0, Max = 0;            // delay, ns
+};
+
+
+static bool LoadCapture(const char* Path, std::vector<Telemetry>& Frames)
+{
+  int Fd = open(Path, O_RDONLY | O_CLOEXEC);
+  if (Fd < 0)
+    return false;
+  FrameReader Reader;
+  uint8_t Buffer[8192];
+  ssize_t n;
+  while ((n = read(Fd, Buffer, sizeof(Buffer))) > 0)
+    Reader.Feed(Buffer, (size_t)n, [&](const std::vector<uint8_t>& Frame) {
+      Telemetry T;
+      if (ParseTelemetry(Frame, T))
+        Frames.push_back(T);
+    });
+  close(Fd);
+  return true;
+}
+
+
+static void RunReader(const std::string& Name, std::atomic<int>& Attached, ReaderResult& Result)
+{
+  RingReader Ring;
+  if (!Ring.Attach(Name))
+  {
+    perror(Name.c_str());
+    Attached++;
+    return;
+  }
+  Attached++;
+  Telemetry T;
+  int64_t Published;
+  for (;;)
+  {
+    while (Ring.Read(T, &Published))
+      Result.Delays.push_back((uint32_t)std::min<int64_t>(MonotonicNanos() - Published, UINT32_MAX));
+    if (Ring.WriterGone())
+      break;
+    Ring.Wait(100);
+  }
+  Result.Received = Ring.Received;
+  Result.Overruns = Ring.Overruns;
+}
+
+
+//
+// publish Count frames to Readers readers, at Rate frames/s (0: flat out)
+//
+static RunResult Run(const std::vector<Telemetry>& Frames, int Readers, uint64_t Count, unsigned Rate,
+                     uint32_t Slots)
+{
+  std::string Name = "/vswr-bench-" + std::to_string(getpid());
+  RingWriter Ring;
+  RunResult Result;
+  if (!Ring.Create(Name, Slots))
+  {
+    perror(Name.c_str());
+    exit(1);
+  }
+  std::vector<ReaderResult> Results(Readers);
+  std::vector<std::thread> Threads;
+  std::atomic<int> Attached{0};
+  for (int i = 0; i < Readers; i++)
+    Threads.emplace_back(RunReader, Name, std::ref(Attached), std::ref(Results[i]));
+  while (Attached < Readers)
+    std::this_thread::yield();
+
+  int64_t Start = MonotonicNanos();
+  for (uint64_t i = 0; i < Count; i++)
+  {
+    if (Rate)
+    {
+      int64_t Due = Start + (int64_t)(i * 1000000000ull / Rate);
+      timespec Ts{(time_t)(Due / 1000000000), (long)(Due % 1000000000)};
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Ts, nullptr);
+    }
+    Telemetry& T = Ring.Claim();
+    T = Frames[i % Frames.size()];
+    T.Sequence = (uint16_t)i;
+    Ring.Publish();
+  }
+  Result.WriterRate = Count / ((MonotonicNanos() - Start) * 1e-9);
+  Ring.Close();
+  for (std::thread& Th : Threads)
+    Th.join();
+
+  std::vector<uint32_t> Delays;
+  for (ReaderResult& R : Results)
+  {
+    Result.Received += R.Received;
+    Result.Overruns += R.Overruns;
+    Delays.insert(Delays.end(), R.Delays.begin(), R.Delays.end());
+  }
+  if (!Delays.empty())
+  {
+    std::sort(Delays.begin(), Delays.end());
+    Result.Median = Delays[Delays.size() / 2];
+    Result.P99 = Delays[Delays.size() * 99 / 100];
+    Result.Max = Delays.back();
+  }
+  return Result;
+}
+
+
+int main(int argc, char** argv)
+{
+  uint64_t Count = 1000000;
+  unsigned Rate = 500;
+  uint32_t Slots = DefaultRingSlots;
+  std::vector<int> ReaderCounts;
+
+  int Opt;
+  while ((Opt = getopt(argc, argv, "n:r:s:c:")) != -1)
+  {
+    switch (Opt)
+    {
+    case 'n': Count = strtoull(optarg, nullptr, 0); break;
+    case 'r': Rate = (unsigned)atoi(optarg); break;
+    case 's': Slots = (uint32_t)strtoul(optarg, nullptr, 0); break;
+    case 'c':
+      for (char* p = optarg; *p; p += *p == ',')
+        ReaderCounts.push_back((int)strtol(p, &p, 10));
+      break;
+    default: optind = argc + 1; break;
+    }
+  }
+  if (optind != argc - 1 || Count == 0 || Rate == 0)
+  {
+    fprintf(stderr, "usage: %s [-n frames] [-r rate] [-s slots] [-c readers,...] capture\n", argv[0]);
+    return 1;
+  }
+  if (ReaderCounts.empty())
+    ReaderCounts = {1, 4, 16};
+
+  std::vector<Telemetry> Frames;
+  if (!LoadCapture(argv[optind], Frames))
+  {
+    perror(argv[optind]);
+    return 1;
+  }
+  if (Frames.empty())
+  {
+    fprintf(stderr, "%s: no telemetry frames\n", argv[optind]);
+    return 1;
+  }
+  printf("%zu frames from %s, %u slots, %u CPUs\n\n", Frames.size(), argv[optind], Slots,
+         std::thread::hardware_concurrency());
+  printf("readers  run        frames/s    delivered  overruns   delay us: median     99%%      max\n");
+
+  for (int Readers : ReaderCounts)
+  {
+    if (Readers <= 0)
+      continue;
+    RunResult Flat = Run(Frames, Readers, Count, 0, Slots);
+    RunResult Paced = Run(Frames, Readers, 2 * Rate, Rate, Slots);
+    for (int i = 0; i < 2; i++)
+    {
+      const RunResult& R = i ? Paced : Flat;
+      uint64_t Published = i ? 2 * Rate : Count;
+      printf("%7d  %-9s %9.0f   %9.1f%%  %8llu   %14.1f %8.1f %8.1f\n", Readers, i ? "paced" : "flat out",
+             R.WriterRate, 100.0 * R.Received / (Published * (double)Readers), (unsigned long long)R.Overruns,
+             R.Median / 1e3, R.P99 / 1e3, R.Max / 1e3);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// shim/Arduino.cpp
+// the shim Arduino core: time, SREG, the ADC registers and the serial ports.
+// The harness sets each port's Fd and calls Drain() to pass what the sketch
+// wrote to it.
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+
+unsigned long ShimMicros;
+unsigned long ShimMicrosStep;
+byte SREG;
+ADC_t ADC0;
+CPUINT_t CPUINT;
+PORT_t PORTA;
+ShimSerial Serial;
+ShimSerial Serial1;
+
+int ShimSerial::available(void)
+{
+  int Count = 0;
+  ioctl(Fd, FIONREAD, &Count);
+  return Count;
+}
+
+int ShimSerial::read(void)
+{
+  uint8_t Ch;
+  ReadsThisPass++;
+  if (::read(Fd, &Ch, 1) != 1)
+    return -1;
+  BytesRead++;
+  return Ch;
+}
+
+int ShimSerial::availableForWrite(void)
+{
+  return TxBufferSize - TxUsed;
+}
+
+size_t ShimSerial::write(const uint8_t* Data, size_t Length)
+{
+  Length = std::min(Length, (size_t)(TxBufferSize - TxUsed));
+  memcpy(TxBuffer + TxUsed, Data, Length);
+  TxUsed += (int)Length;
+  return Length;
+}
+
+void ShimSerial::Drain(void)
+{
+  if (TxUsed == 0)
+    return;
+  if (Fd < 0)                                   // nothing connected: the bytes are lost
+  {
+    BytesWritten += TxUsed;
+    TxUsed = 0;
+    return;
+  }
+  ssize_t n = ::write(Fd, TxBuffer, TxUsed);
+  if (n > 0)
+  {
+    BytesWritten += n;
+    memmove(TxBuffer, TxBuffer + n, TxUsed - n);
+    TxUsed -= (int)n;
+  }
+}
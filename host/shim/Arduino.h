@@ -0,0 +1,110 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// shim/Arduino.h
+// just enough of the Arduino core to build the sketch's serial modules
+// (console.cpp, telemetry.cpp), its ADC code (analogueio.cpp) and the
+// display library (NexHardware.cpp) on a PC for the harnesses. Serial and
+// Serial1 are file descriptors (a pty or a socket) with a 64 byte transmit
+// buffer like the Nano Every's; time is a counter the harness moves on, and
+// the ADC registers are variables the harness reads and writes.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __SHIM_ARDUINO_H
+#define __SHIM_ARDUINO_H
+
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+typedef uint8_t byte;
+using std::min;
+using std::max;
+
+extern unsigned long ShimMicros;                // moved on by the harness
+extern unsigned long ShimMicrosStep;            // and by this much each time it is read, for code that waits
+inline unsigned long micros(void) { return ShimMicros += ShimMicrosStep; }
+inline unsigned long millis(void) { return micros() / 1000; }
+
+extern byte SREG;
+inline void cli(void) {}
+inline void sei(void) {}
+
+//
+// the ATmega4809 peripherals analogueio.cpp uses, as plain variables.
+// the harness plays the ADC: it looks at MUXPOS and CTRLB to see what the
+// next conversion is, puts the result in RES and calls ADC0_RESRDY_vect()
+// as the result ready interrupt would.
+//
+#define ISR(Vector) extern "C" void Vector(void)
+extern "C" void ADC0_RESRDY_vect(void);
+
+struct ADC_t
+{
+  volatile uint8_t CTRLA, CTRLB, CTRLC, INTCTRL, MUXPOS, COMMAND;
+  volatile uint16_t RES;
+};
+extern ADC_t ADC0;
+#define ADC_ENABLE_bm 0x01
+#define ADC_RESSEL_10BIT_gc 0x00
+#define ADC_SAMPNUM_ACC1_gc 0x00
+#define ADC_SAMPNUM_ACC16_gc 0x04
+#define ADC_PRESC_DIV16_gc 0x03
+#define ADC_PRESC_DIV64_gc 0x05
+#define ADC_REFSEL_gm 0x30
+#define ADC_SAMPCAP_bm 0x40
+#define ADC_RESRDY_bm 0x01
+#define ADC_STCONV_bm 0x01
+#define ADC_MUXPOS_gp 0
+
+struct CPUINT_t
+{
+  volatile uint8_t LVL1VEC;
+};
+extern CPUINT_t CPUINT;
+#define ADC0_RESRDY_vect_num 22
+
+struct PORT_t
+{
+  volatile uint8_t OUT, OUTSET, OUTCLR;
+};
+extern PORT_t PORTA;
+
+#define A0 14
+#define A1 15
+inline PORT_t* digitalPinToPortStruct(uint8_t) { return &PORTA; }
+inline uint8_t digitalPinToBitMask(uint8_t Pin) { return (uint8_t)(1 << (Pin & 7)); }
+inline uint8_t digitalPinToAnalogInput(uint8_t Pin) { return (uint8_t)(Pin - A0); }
+
+
+class ShimSerial
+{
+public:
+  static const int TxBufferSize = 64;
+  int Fd = -1;
+  unsigned ReadsThisPass = 0;                   // read() calls since the harness last cleared it
+  uint64_t BytesRead = 0;                       // totals, so the harness knows what's in the pty
+  uint64_t BytesWritten = 0;
+
+  void begin(long) {}
+  int available(void);
+  int read(void);
+  int availableForWrite(void);
+  size_t write(uint8_t Ch) { return write(&Ch, 1); }
+  size_t write(const uint8_t* Data, size_t Length);
+  size_t print(const char* Text) { return write((const uint8_t*)Text, strlen(Text)); }
+  void Drain(void);                             // pass the transmit buffer to the fd (or drop it if none), as the UART would
+
+private:
+  uint8_t TxBuffer[TxBufferSize];
+  int TxUsed = 0;
+};
+
+extern ShimSerial Serial;
+extern ShimSerial Serial1;
+
+#endif      // file sentry
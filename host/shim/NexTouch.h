@@ -0,0 +1,22 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// shim/NexTouch.h
+// the part of the Nextion touch class NexHardware.cpp calls: nexLoop()
+// passes each touch event to NexTouch::iterate(), which the harness provides
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __SHIM_NEXTOUCH_H
+#define __SHIM_NEXTOUCH_H
+
+#include <Arduino.h>
+
+class NexTouch
+{
+public:
+  static void iterate(NexTouch** List, uint8_t Pid, uint8_t Cid, int32_t Event);
+};
+
+#endif      // file sentry
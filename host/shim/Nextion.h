@@ -0,0 +1,25 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// shim/Nextion.h
+// the display library statistics the console reports; the whole of
+// NexHardware.h when the display library is on the include path
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __SHIM_NEXTION_H
+#define __SHIM_NEXTION_H
+
+#include <Arduino.h>
+
+#if __has_include(<NexHardware.h>)
+#include <NexHardware.h>
+#else
+extern uint16_t nexTxHighWater;
+extern uint16_t nexTxRejectCount;
+extern uint16_t nexRxErrorCount;
+extern uint16_t nexRxFrameErrorCount;
+#endif
+
+#endif      // file sentry
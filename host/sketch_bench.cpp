@@ -0,0 +1,610 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// sketch_bench.cpp
+// times parts of the sketch on the PC against the code they replaced, with
+// the same inputs. A PC has an FPU and a cache, so the times are far from
+// an AVR's; what matters is how they compare.
+//
+//   conversions   one tick's readings to dBm, volts, watts and VSWR: the
+//                 integer conversions in analogueio.cpp against the old float
+//                 maths and 1024 entry float voltage table. The PC does float
+//                 in hardware, so the float operations in each tick are also
+//                 counted: on the AVR each is a soft-float library call of
+//                 around a hundred cycles (several hundred for a divide).
+//   windows       the sliding window average and peak (slidingwindow.h)
+//                 against scanning the whole buffer, as FindPeakPower() and
+//                 GetPowerReading() used to, at several window lengths. Each
+//                 tick adds a sample and asks for the average and peak 4 times
+//                 (the display asks several times a tick).
+//   commands      one display tick's commands (two crossed needle lines, a
+//                 picture number and a dBm text) built in the display transmit
+//                 queue with nexCmd*() against the old mysprintf()/strcat()
+//                 chains copied in by sendCommand(). The bytes sent are compared,
+//                 and the bytes each way writes or scans per tick are counted:
+//                 the PC's strcat() is vectorised, the AVR's goes a byte at a time.
+//
+// build (from host/):
+//   g++ -std=c++17 -O2 -Wall -Ishim -I../sketch/Log_VSWR_sketch -I../displays/arduino_library_update
+//       -o sketch_bench sketch_bench.cpp shim/Arduino.cpp ../sketch/Log_VSWR_sketch/analogueio.cpp
+//       ../displays/arduino_library_update/NexHardware.cpp
+// usage: sketch_bench [-n ticks]   (default 1000000)
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "globalinclude.h"
+#include "analogueio.h"
+#include "ballistics.h"
+#include "configdata.h"
+#include "slidingwindow.h"
+#include "NexHardware.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// stand-ins for the rest of the sketch
+//
+byte GBandInUse = e20m;
+bool GOversampleInUse;
+CalibrationSet GCalibrationSets[VNUMBANDS];
+ProtectionParams GProtection;
+DetectorParams GDetector;
+
+void BallisticsInit(void) {}
+void BallisticsTick(unsigned int, unsigned int, unsigned int, unsigned int) {}
+void NexTouch::iterate(NexTouch**, uint8_t, uint8_t, int32_t) {}
+
+long GetdBmQ8(unsigned int Reading);
+int GetTenthdBm(long dBmQ8);
+unsigned int GetLineVoltageTenth(long dBmQ8);
+unsigned int GetLinePowerTenth(long dBmQ8);
+unsigned int GetVSWR(long FwddBmQ8, long RevdBmQ8);
+
+
+volatile unsigned long Sink;                        // results go here so they can't be optimised away
+
+double NanosPerTick(std::chrono::steady_clock::time_point Start, uint64_t Ticks)
+{
+  return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - Start).count() / Ticks;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// conversions
+//
+struct TickReadings
+{
+  unsigned int FwdAvg, FwdPeak, RevAvg, RevPeak;    // whole ADC codes
+};
+
+float GLineVoltageTable[1024];                      // the old table: line voltage for each code
+
+//
+// a float that counts what is done with it
+//
+struct FloatCounts
+{
+  uint64_t AddSub, Mul, Div, Compare, Convert;
+} Counts;
+
+struct CountedFloat
+{
+  float Value;
+  CountedFloat(float V = 0.0f) : Value(V) {}
+  static CountedFloat FromInt(int V) { Counts.Convert++; return CountedFloat((float)V); }
+  int ToInt(void) const { Counts.Convert++; return (int)Value; }
+  CountedFloat operator+(CountedFloat B) const { Counts.AddSub++; return Value + B.Value; }
+  CountedFloat operator-(CountedFloat B) const { Counts.AddSub++; return Value - B.Value; }
+  CountedFloat operator*(CountedFloat B) const { Counts.Mul++; return Value * B.Value; }
+  CountedFloat operator/(CountedFloat B) const { Counts.Div++; return Value / B.Value; }
+  bool operator<(CountedFloat B) const { Counts.Compare++; return Value < B.Value; }
+  bool operator>(CountedFloat B) const { Counts.Compare++; return Value > B.Value; }
+  bool operator==(CountedFloat B) const { Counts.Compare++; return Value == B.Value; }
+};
+
+inline float FromInt(float, int V) { return (float)V; }
+inline int ToInt(float V) { return (int)V; }
+inline CountedFloat FromInt(CountedFloat, int V) { return CountedFloat::FromInt(V); }
+inline int ToInt(CountedFloat V) { return V.ToInt(); }
+inline CountedFloat fabs(CountedFloat V) { return V.Value < 0.0f ? -V.Value : V.Value; }
+
+//
+// the old AnalogueIOTick() conversions, for one input
+//
+template <typename Real>
+void FloatInput(unsigned int Avg, unsigned int Peak, int& TenthdBm, unsigned int& AvgPower,
+                unsigned int& PeakPower, Real& PeakVoltage)
+{
+  Real ScaledReading, Power, Voltage;
+
+  ScaledReading = Real(-96.0f) + FromInt(Real(), Avg) * Real(0.1253f) + Real(50.0f);
+  TenthdBm = ToInt(ScaledReading * Real(10.0f));
+  Voltage = GLineVoltageTable[Avg];
+  Power = Real(10.0f) * Voltage * Voltage / Real(50.0f);
+  AvgPower = Power > Real(60000.0f) ? 60000 : ToInt(Power);
+  PeakVoltage = GLineVoltageTable[Peak];
+  Power = Real(10.0f) * PeakVoltage * PeakVoltage / Real(50.0f);
+  PeakPower = Power > Real(60000.0f) ? 60000 : ToInt(Power);
+}
+
+template <typename Real>
+unsigned long FloatTick(const TickReadings& R)
+{
+  int FwddBm, RevdBm;
+  unsigned int FwdAvg, FwdPeak, RevAvg, RevPeak, VSWR;
+  Real FwdVoltage, RevVoltage;
+
+  FloatInput(R.FwdAvg, R.FwdPeak, FwddBm, FwdAvg, FwdPeak, FwdVoltage);
+  FloatInput(R.RevAvg, R.RevPeak, RevdBm, RevAvg, RevPeak, RevVoltage);
+  if (FwdVoltage < Real(0.1f))
+    VSWR = 10;
+  else if (FwdVoltage == RevVoltage)
+    VSWR = 9999;
+  else
+    VSWR = ToInt(fabs(Real(10.0f) * (FwdVoltage + RevVoltage) / (FwdVoltage - RevVoltage)));
+  return FwddBm + RevdBm + FwdAvg + FwdPeak + RevAvg + RevPeak + VSWR + ToInt(FwdVoltage * Real(10.0f));
+}
+
+//
+// the same from the integer conversions, as AnalogueIOTick() does them now
+//
+unsigned long IntegerTick(const TickReadings& R)
+{
+  long AvgdBmQ8, FwdPeakdBmQ8, RevPeakdBmQ8;
+  unsigned long Total;
+  unsigned int FwdVoltage;
+
+  AvgdBmQ8 = GetdBmQ8(R.FwdAvg << 4);
+  Total = GetTenthdBm(AvgdBmQ8) + GetLinePowerTenth(AvgdBmQ8);
+  FwdPeakdBmQ8 = GetdBmQ8(R.FwdPeak << 4);
+  FwdVoltage = GetLineVoltageTenth(FwdPeakdBmQ8);
+  Total += FwdVoltage + GetLinePowerTenth(FwdPeakdBmQ8);
+  AvgdBmQ8 = GetdBmQ8(R.RevAvg << 4);
+  Total += GetTenthdBm(AvgdBmQ8) + GetLinePowerTenth(AvgdBmQ8);
+  RevPeakdBmQ8 = GetdBmQ8(R.RevPeak << 4);
+  Total += GetLineVoltageTenth(RevPeakdBmQ8) + GetLinePowerTenth(RevPeakdBmQ8);
+  Total += FwdVoltage == 0 ? 10 : GetVSWR(FwdPeakdBmQ8, RevPeakdBmQ8);
+  return Total;
+}
+
+void ConversionBench(uint64_t Ticks)
+{
+  std::vector<TickReadings> Readings(4096);
+  std::mt19937 Random(1);
+  unsigned long Total;
+
+  for (CalibrationSet& Set : GCalibrationSets)
+    Set.CouplingQ8 = 50 * 256;
+  GDetector.dBScaleQ20 = 131387;
+  GDetector.dBmOffsetQ8 = -96 * 256;
+  AnalogueIOInit();
+  for (int Code = 0; Code < 1024; Code++)
+    GLineVoltageTable[Code] = (float)sqrt(50.0 * pow(10.0, (-96.0 + Code * 0.1253 + 50.0 - 30.0) / 10.0));
+  for (TickReadings& R : Readings)
+  {
+    R.FwdPeak = Random() % 1024;
+    R.FwdAvg = R.FwdPeak - Random() % (R.FwdPeak + 1) / 4;
+    R.RevPeak = Random() % (R.FwdPeak + 1);
+    R.RevAvg = R.RevPeak - Random() % (R.RevPeak + 1) / 4;
+  }
+
+  printf("conversions, %llu ticks          ns/tick\n", (unsigned long long)Ticks);
+  Total = 0;
+  auto Start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < Ticks; i++)
+    Total += FloatTick<float>(Readings[i & 4095]);
+  Sink = Total;
+  printf("  float maths and table        %8.1f\n", NanosPerTick(Start, Ticks));
+  for (const TickReadings& R : Readings)
+    Total += FloatTick<CountedFloat>(R);
+  Sink = Total;
+  printf("    float operations per tick: %.1f add/subtract, %.1f multiply, %.1f divide, %.1f compare, "
+         "%.1f int conversion\n", (double)Counts.AddSub / Readings.size(), (double)Counts.Mul / Readings.size(),
+         (double)Counts.Div / Readings.size(), (double)Counts.Compare / Readings.size(),
+         (double)Counts.Convert / Readings.size());
+  Total = 0;
+  Start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < Ticks; i++)
+    Total += IntegerTick(Readings[i & 4095]);
+  Sink = Total;
+  printf("  integer (analogueio.cpp)     %8.1f\n\n", NanosPerTick(Start, Ticks));
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// windows
+//
+#define VQUERIESPERTICK 4
+
+//
+// the old code: a circular buffer, scanned for every query
+//
+template <unsigned int N> struct ScannedWindow
+{
+  unsigned int Buffer[N] = {};
+  unsigned int Pointer = 0;
+
+  void AddSample(unsigned int Sample)
+  {
+    if (++Pointer >= N)
+      Pointer = 0;
+    Buffer[Pointer] = Sample;
+  }
+  unsigned int GetPeak(void)
+  {
+    unsigned int Result = 0;
+    for (unsigned int i = 0; i < N; i++)
+      if (Buffer[i] > Result)
+        Result = Buffer[i];
+    return Result;
+  }
+  unsigned int GetAverage(void)
+  {
+    unsigned long Sum = 0;
+    for (unsigned int i = 0; i < N; i++)
+      Sum += Buffer[i];
+    return (unsigned int)(Sum / N);
+  }
+};
+
+template <unsigned int N> void WindowBench(const std::vector<unsigned int>& Samples, uint64_t Ticks)
+{
+  ScannedWindow<N> Scanned;
+  SlidingAverage<unsigned int, N> Average;
+  SlidingPeak<unsigned int, N> Peak;
+  unsigned long ScannedTotal = 0, SlidingTotal = 0;
+  double ScannedNanos, SlidingNanos;
+
+  auto Start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < Ticks; i++)
+  {
+    Scanned.AddSample(Samples[i & 4095]);
+    for (int Query = 0; Query < VQUERIESPERTICK; Query++)
+      ScannedTotal += Scanned.GetPeak() + Scanned.GetAverage();
+  }
+  ScannedNanos = NanosPerTick(Start, Ticks);
+  Start = std::chrono::steady_clock::now();
+  for (uint64_t i = 0; i < Ticks; i++)
+  {
+    Average.AddSample(Samples[i & 4095]);
+    Peak.AddSample(Samples[i & 4095]);
+    for (int Query = 0; Query < VQUERIESPERTICK; Query++)
+      SlidingTotal += Peak.GetPeak() + Average.GetAverage();
+  }
+  SlidingNanos = NanosPerTick(Start, Ticks);
+  Sink = ScannedTotal + SlidingTotal;
+  printf("  %5u  %14.1f %14.1f   %s\n", N, ScannedNanos, SlidingNanos,
+         ScannedTotal == SlidingTotal ? "same results" : "RESULTS DIFFER");
+}
+
+void WindowsBench(uint64_t Ticks)
+{
+  std::vector<unsigned int> Samples(4096);
+  std::mt19937 Random(2);
+
+  for (size_t i = 0; i < Samples.size(); i++)           // bursts of power, like speech
+    Samples[i] = (i / 64) % 3 ? Random() % 60000 : Random() % 100;
+  printf("windows, %llu ticks       ns/tick\n", (unsigned long long)Ticks);
+  printf("  length        scanned        sliding\n");
+  WindowBench<8>(Samples, Ticks);
+  WindowBench<32>(Samples, Ticks);
+  WindowBench<250>(Samples, Ticks);
+  WindowBench<1000>(Samples, Ticks);
+  printf("\n");
+}
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// commands
+//
+#define VCMDLENGTH 30                               // display.cpp's longest command
+#define VTICKSPERBATCH 2                            // ticks of commands the transmit queue holds
+
+struct CommandInputs
+{
+  int RevX2, RevY2, FwdX2, FwdY2;                   // needle ends
+  int Image;                                        // picture number
+  int TenthdBm;                                     // signed, shown with 1 decimal place
+};
+
+#define VASCII0 0x30                // zero character in ASCII
+//
+// the old display.cpp formatter, as it was
+// Adds a decimal point before last digit if 3rd parameter set
+// note integer value is signed and may be negative!
+//
+unsigned char mysprintf(char *dest, int Value, bool AddDP)
+{
+  unsigned char Digit;              // calculated digit
+  bool HadADigit = false;           // true when found a non zero digit
+  unsigned char DigitCount = 0;     // number of returned digits
+  unsigned int Divisor = 10000;     // power of 10 being calculated
+//
+// deal with negative values first
+//
+  if (Value < 0)
+  {
+    *dest++ = '-';    // add to output
+    DigitCount++;
+    Value = -Value;
+  }
+//
+// now convert the (definitely posirive) number
+//
+  while (Divisor >= 10)
+  {
+    Digit = Value / Divisor;        // find digit: integer divide
+    if (Digit != 0)
+      HadADigit = true;             // flag if non zero so all trailing digits added
+    if (HadADigit)                  // if 1st non zero or all subsequent
+    {
+      *dest++ = Digit + VASCII0;    // add to output
+      DigitCount++;
+    }
+    Value -= (Digit * Divisor);     // get remainder from divide
+    Divisor = Divisor / 10;         // ready for next digit
+  }
+//
+// if we need a decimal point, add it now. Also if there hasn't been a preceiding digit
+// (i.e. number was like 0.3) add the zero
+//
+  if (AddDP)
+  {
+    if (HadADigit == false)
+    {
+      *dest++ = '0';
+      DigitCount++;
+    }
+    *dest++ = '.';
+  DigitCount++;
+  }
+  *dest++ = Value + VASCII0;
+  DigitCount++;
+//
+// finally terminate with a 0
+//
+  *dest++ = 0;
+  return DigitCount;
+}
+
+//
+// the C string functions the old code used, counting the bytes each writes or scans
+// (the terminating zero included) when Counted is set
+//
+uint64_t BytePasses;
+
+template <bool Counted> void Strcpy(char* Dest, const char* Src)
+{
+  if (Counted)
+    BytePasses += strlen(Src) + 1;
+  strcpy(Dest, Src);
+}
+
+template <bool Counted> void Strcat(char* Dest, const char* Src)
+{
+  if (Counted)
+    BytePasses += strlen(Dest) + strlen(Src) + 1;
+  strcat(Dest, Src);
+}
+
+template <bool Counted> void Sprintf(char* Dest, int Value, bool AddDP)
+{
+  unsigned char Length = mysprintf(Dest, Value, AddDP);
+  if (Counted)
+    BytePasses += Length + 1;
+}
+
+template <bool Counted> void SendCommand(const char* Cmd)
+{
+  if (Counted)
+    BytePasses += 2 * (strlen(Cmd) + 1) + 3;        // sendCommand() measures it, then copies it in
+  sendCommand(Cmd);
+}
+
+//
+// the old line command code, from DisplayTick()
+//
+template <bool Counted> void OldLineCommand(int X1, int Y1, int X2, int Y2)
+{
+  char Str[30];
+  char Str2[10];
+
+  Strcpy<Counted>(Str, "line ");             // line
+  Sprintf<Counted>(Str2, X1, false);
+  Strcat<Counted>(Str, Str2);
+  Strcat<Counted>(Str, ",");                 // line X1,
+  Sprintf<Counted>(Str2, Y1, false);
+  Strcat<Counted>(Str, Str2);
+  Strcat<Counted>(Str, ",");                 // line X1,Y1,
+  Sprintf<Counted>(Str2, X2, false);
+  Strcat<Counted>(Str, Str2);
+  Strcat<Counted>(Str, ",");                 // line X1,Y1,X2
+  Sprintf<Counted>(Str2, Y2, false);
+  Strcat<Counted>(Str, Str2);
+  Strcat<Counted>(Str, ",BLUE");             // line X1,Y1,X2,Y2,BLUE
+  SendCommand<Counted>(Str);
+}
+
+template <bool Counted> void OldCommands(const CommandInputs& In)
+{
+  char Str[20];
+  char Str2[10];
+
+  OldLineCommand<Counted>(35, 239, In.RevX2, In.RevY2);
+  OldLineCommand<Counted>(243, 239, In.FwdX2, In.FwdY2);
+  Sprintf<Counted>(Str2, In.Image, false);          // as SetBargraphImages() did
+  Strcpy<Counted>(Str, "p2j0.ppic=");
+  Strcat<Counted>(Str, Str2);
+  SendCommand<Counted>(Str);
+  Sprintf<Counted>(Str2, In.TenthdBm, true);        // as the dBm text was, less setText()'s String
+  Strcpy<Counted>(Str, "p3t5.txt=\"");
+  Strcat<Counted>(Str, Str2);
+  Strcat<Counted>(Str, "\"");
+  SendCommand<Counted>(Str);
+}
+
+//
+// the same commands as display.cpp and displaymodel.cpp build them now
+//
+void NewLineCommand(int X1, int Y1, int X2, int Y2)
+{
+  NexCmdBuilder Cmd;
+
+  if(nexCmdBegin(&Cmd, VCMDLENGTH))
+  {
+    nexCmdText(&Cmd, "line ");
+    nexCmdInt(&Cmd, X1);
+    nexCmdChar(&Cmd, ',');
+    nexCmdInt(&Cmd, Y1);
+    nexCmdChar(&Cmd, ',');
+    nexCmdInt(&Cmd, X2);
+    nexCmdChar(&Cmd, ',');
+    nexCmdInt(&Cmd, Y2);
+    nexCmdText(&Cmd, ",BLUE");
+    nexCmdEnd(&Cmd);
+  }
+}
+
+void NewCommands(const CommandInputs& In)
+{
+  NexCmdBuilder Cmd;
+
+  NewLineCommand(35, 239, In.RevX2, In.RevY2);
+  NewLineCommand(243, 239, In.FwdX2, In.FwdY2);
+  nexCmdBegin(&Cmd, VCMDLENGTH, true);
+  nexCmdText(&Cmd, "p2j0.ppic=");
+  nexCmdInt(&Cmd, In.Image);
+  nexCmdEnd(&Cmd);
+  nexCmdBegin(&Cmd, VCMDLENGTH, true);
+  nexCmdText(&Cmd, "p3t5.txt=");
+  nexCmdChar(&Cmd, '"');
+  nexCmdInt(&Cmd, In.TenthdBm, 1);
+  nexCmdChar(&Cmd, '"');
+  nexCmdEnd(&Cmd);
+}
+
+void NoCommands(const CommandInputs&) {}
+
+//
+// pass the queued commands on: to the display end of Serial1 if keeping them,
+// otherwise dropped by the shim
+//
+int DisplayFd = -1;
+
+void EmptyQueue(std::string* Sent)
+{
+  char Buffer[256];
+  ssize_t n;
+
+  while (nexTxUsed() != 0)
+  {
+    nexTxService();
+    Serial1.Drain();
+  }
+  Serial1.Drain();
+  while (Sent && (n = read(DisplayFd, Buffer, sizeof(Buffer))) > 0)
+    Sent->append(Buffer, n);
+}
+
+//
+// ns per tick to build the commands, timed a batch at a time so the queue never fills;
+// emptying it between batches isn't timed
+//
+double CommandNanos(void (*Commands)(const CommandInputs&), const std::vector<CommandInputs>& Inputs,
+                    uint64_t Ticks, std::string* Sent)
+{
+  std::chrono::steady_clock::duration Total{};
+
+  for (uint64_t i = 0; i < Ticks; i += VTICKSPERBATCH)
+  {
+    auto Start = std::chrono::steady_clock::now();
+    for (uint64_t j = i; j < i + VTICKSPERBATCH && j < Ticks; j++)
+      Commands(Inputs[j & 4095]);
+    Total += std::chrono::steady_clock::now() - Start;
+    EmptyQueue(Sent);
+  }
+  return std::chrono::duration<double, std::nano>(Total).count() / Ticks;
+}
+
+void CommandsBench(uint64_t Ticks)
+{
+  std::vector<CommandInputs> Inputs(4096);
+  std::mt19937 Random(4);
+  std::string OldSent, NewSent;
+  double Overhead, OldNanos, NewNanos;
+  int Fds[2];
+
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, Fds) != 0)
+  {
+    perror("socketpair");
+    return;
+  }
+  fcntl(Fds[1], F_SETFL, fcntl(Fds[1], F_GETFL) | O_NONBLOCK);
+  Serial1.Fd = Fds[0];
+  DisplayFd = Fds[1];
+  for (CommandInputs& In : Inputs)
+  {
+    In.RevX2 = 35 + Random() % 200;
+    In.RevY2 = 39 + Random() % 200;
+    In.FwdX2 = 43 + Random() % 200;
+    In.FwdY2 = 39 + Random() % 200;
+    In.Image = Random() % 40;
+    In.TenthdBm = (int)(Random() % 1600) - 600;
+  }
+
+  BytePasses = 0;
+  CommandNanos(OldCommands<true>, Inputs, Inputs.size(), &OldSent);
+  CommandNanos(NewCommands, Inputs, Inputs.size(), &NewSent);
+  close(Fds[0]);
+  close(Fds[1]);
+  Serial1.Fd = DisplayFd = -1;
+
+  printf("commands, %llu ticks         ns/tick   bytes written or scanned/tick\n", (unsigned long long)Ticks);
+  Overhead = CommandNanos(NoCommands, Inputs, Ticks, nullptr);
+  OldNanos = CommandNanos(OldCommands<false>, Inputs, Ticks, nullptr) - Overhead;
+  NewNanos = CommandNanos(NewCommands, Inputs, Ticks, nullptr) - Overhead;
+  printf("  mysprintf, strcat, copy     %8.1f   %8.1f\n", OldNanos, (double)BytePasses / Inputs.size());
+  printf("  nexCmd*() in the queue      %8.1f   %8.1f\n", NewNanos, (double)NewSent.size() / Inputs.size());
+  printf("  %.1f bytes sent per tick, %s\n\n", (double)NewSent.size() / Inputs.size(),
+         OldSent == NewSent ? "same bytes" : "BYTES DIFFER");
+}
+
+
+int main(int argc, char** argv)
+{
+  uint64_t Ticks = 1000000;
+
+  int Opt;
+  while ((Opt = getopt(argc, argv, "n:")) != -1)
+  {
+    switch (Opt)
+    {
+    case 'n': Ticks = strtoull(optarg, nullptr, 0); break;
+    default: optind = argc + 1; break;
+    }
+  }
+  if (optind != argc || Ticks == 0)
+  {
+    fprintf(stderr, "usage: %s [-n ticks]\n", argv[0]);
+    return 1;
+  }
+
+  ConversionBench(Ticks);
+  WindowsBench(Ticks);
+  CommandsBench(Ticks);
+  return 0;
+}
@@ -0,0 +1,227 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// telemetry_decode.cpp
+// reads telemetry frames from a bridge and prints them, one CSV line per frame.
+// frames that fail the CRC or have broken framing are counted and dropped;
+// frames missing from the sequence (skipped by the bridge or lost) are counted.
+// a summary goes to stderr once a second.
+//
+// usage: telemetry_decode [-r rate] [-b baud] [-n frames] [-q] [-p ring] [-w file] device
+//   -r  ask the bridge for this many frames per second (1 to 500; 0 = stop)
+//   -b  serial rate (default 500000; ignored by a pty)
+//   -n  stop after this many frames
+//   -q  no CSV, summary only
+//   -p  publish the frames in a shared memory ring (telemetryring.h) with this
+//       name (eg /vswr-bridge), for other programs to read
+//   -w  also write everything read from the port to a file (a capture, for
+//       bridge_logd or ring_bench to replay)
+// device "shm:/name" reads frames from another telemetry_decode's ring instead
+// of a port, so any number of them can share one bridge.
+/////////////////////////////////////////////////////////////////////////
+
+#include "bridgeproto.h"
+#include "telemetryring.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <poll.h>
+#include <signal.h>
+
+using namespace bridge;
+using Clock = std::chrono::steady_clock;
+
+static volatile sig_atomic_t Stop = 0;
+
+
+static void PrintFrame(const Telemetry& T)
+{
+  printf("%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%u,%u,%u,%u,%u,%u,%u\n",
+         T.Sequence, T.Micros, T.FwdTenthdBm / 10.0, T.RevTenthdBm / 10.0,
+         T.FwdAvgPowerTenth / 10.0, T.RevAvgPowerTenth / 10.0,
+         T.FwdPeakPowerTenth / 10.0, T.RevPeakPowerTenth / 10.0, T.VSWRTenth / 10.0,
+         T.FwdCount, T.RevCount, T.FwdSum, T.RevSum, T.FwdPeak, T.RevPeak, T.Flags);
+}
+
+
+//
+// read frames from another telemetry_decode's ring, waiting for it to start
+// (or start again) as needed
+//
+static int ReadRing(const std::string& Name, uint64_t MaxFrames, bool Quiet)
+{
+  RingReader Ring;
+  SequenceTracker Sequence;
+  uint64_t LastReceived = 0;
+  bool Waiting = false;
+  auto NextSummary = Clock::now() + std::chrono::seconds(1);
+
+  if (!Quiet)
+    printf("seq,micros,fwd_dbm,rev_dbm,fwd_avg_w,rev_avg_w,fwd_pk_w,rev_pk_w,vswr,"
+           "fwd_count,rev_count,fwd_sum,rev_sum,fwd_peak,rev_peak,flags\n");
+
+  while (!Stop && (MaxFrames == 0 || Sequence.Received < MaxFrames))
+  {
+    if (!Ring.Attached() && !Ring.Attach(Name))
+    {
+      if (!Waiting)
+        fprintf(stderr, "%s: %s, waiting for it\n", Name.c_str(), strerror(errno));
+      Waiting = true;
+      usleep(200000);
+      continue;
+    }
+    Waiting = false;
+    Telemetry T;
+    if (Ring.Wait(200))
+      while ((MaxFrames == 0 || Sequence.Received < MaxFrames) && Ring.Read(T))
+      {
+        Sequence.Add(T.Sequence);
+        if (!Quiet)
+          PrintFrame(T);
+      }
+    if (Ring.WriterGone())
+      Ring.Detach();
+    if (Clock::now() >= NextSummary)
+    {
+      NextSummary += std::chrono::seconds(1);
+      fprintf(stderr, "frames/s %llu  received %llu  missing %llu  overruns %llu\n",
+              (unsigned long long)(Sequence.Received - LastReceived), (unsigned long long)Sequence.Received,
+              (unsigned long long)Sequence.Missing, (unsigned long long)Ring.Overruns);
+      LastReceived = Sequence.Received;
+      fflush(stdout);
+    }
+  }
+  fflush(stdout);
+  fprintf(stderr, "total: received %llu  missing %llu  overruns %llu\n", (unsigned long long)Sequence.Received,
+          (unsigned long long)Sequence.Missing, (unsigned long long)Ring.Overruns);
+  return 0;
+}
+
+
+int main(int argc, char** argv)
+{
+  int Rate = -1;
+  long Baud = DefaultBaud;
+  uint64_t MaxFrames = 0;
+  bool Quiet = false;
+  std::string RingName, CapturePath;
+
+  int Opt;
+  while ((Opt = getopt(argc, argv, "r:b:n:qp:w:")) != -1)
+  {
+    switch (Opt)
+    {
+    case 'r': Rate = atoi(optarg); break;
+    case 'b': Baud = atol(optarg); break;
+    case 'n': MaxFrames = strtoull(optarg, nullptr, 0); break;
+    case 'q': Quiet = true; break;
+    case 'p': RingName = optarg; break;
+    case 'w': CapturePath = optarg; break;
+    default: optind = argc + 1; break;
+    }
+  }
+  if (optind != argc - 1 || Rate > (int)MaxRate)
+  {
+    fprintf(stderr, "usage: %s [-r rate] [-b baud] [-n frames] [-q] [-p ring] [-w file] device|shm:/ring\n", argv[0]);
+    return 1;
+  }
+  signal(SIGINT, [](int) { Stop = 1; });
+  signal(SIGTERM, [](int) { Stop = 1; });
+
+  std::string Device = argv[optind];
+  if (Device.compare(0, 4, "shm:") == 0)
+    return ReadRing(Device.substr(4), MaxFrames, Quiet);
+
+  RingWriter Ring;
+  if (!RingName.empty() && !Ring.Create(RingName))
+  {
+    perror(RingName.c_str());
+    return 1;
+  }
+  int Capture = -1;
+  if (!CapturePath.empty() && (Capture = open(CapturePath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) < 0)
+  {
+    perror(CapturePath.c_str());
+    return 1;
+  }
+
+  int Fd = OpenSerial(Device, Baud);
+  if (Fd < 0)
+  {
+    perror(Device.c_str());
+    return 1;
+  }
+  if (Rate >= 0 && !WriteAll(Fd, EncodeSetRate((unsigned)Rate)))
+  {
+    perror("write");
+    return 1;
+  }
+
+  FrameReader Reader;
+  SequenceTracker Sequence;
+  uint64_t CrcErrors = 0, OtherFrames = 0;
+  uint64_t LastReceived = 0;
+  auto NextSummary = Clock::now() + std::chrono::seconds(1);
+
+  if (!Quiet)
+    printf("seq,micros,fwd_dbm,rev_dbm,fwd_avg_w,rev_avg_w,fwd_pk_w,rev_pk_w,vswr,"
+           "fwd_count,rev_count,fwd_sum,rev_sum,fwd_peak,rev_peak,flags\n");
+
+  while (!Stop && (MaxFrames == 0 || Sequence.Received < MaxFrames))
+  {
+    pollfd P{Fd, POLLIN, 0};
+    if (poll(&P, 1, 200) > 0)
+    {
+      uint8_t Buffer[4096];
+      ssize_t n = read(Fd, Buffer, sizeof(Buffer));
+      if (n <= 0)
+      {
+        if (n < 0)
+          perror("read");
+        break;
+      }
+      if (Capture >= 0 && write(Capture, Buffer, (size_t)n) != n)
+      {
+        perror(CapturePath.c_str());
+        break;
+      }
+      Reader.Feed(Buffer, (size_t)n, [&](const std::vector<uint8_t>& Frame) {
+        Telemetry Local;
+        Telemetry& T = RingName.empty() ? Local : Ring.Claim();  // decode straight into the ring
+        if (CheckFrame(Frame) < 0)
+          CrcErrors++;
+        else if (!ParseTelemetry(Frame, T))
+          OtherFrames++;
+        else if (MaxFrames == 0 || Sequence.Received < MaxFrames)
+        {
+          if (!RingName.empty())
+            Ring.Publish();
+          Sequence.Add(T.Sequence);
+          if (!Quiet)
+            PrintFrame(T);
+        }
+      });
+    }
+    if (Clock::now() >= NextSummary)
+    {
+      NextSummary += std::chrono::seconds(1);
+      fprintf(stderr, "frames/s %llu  received %llu  missing %llu  crc errors %llu  bad framing %llu\n",
+              (unsigned long long)(Sequence.Received - LastReceived), (unsigned long long)Sequence.Received,
+              (unsigned long long)Sequence.Missing, (unsigned long long)CrcErrors,
+              (unsigned long long)Reader.BadFrames);
+      LastReceived = Sequence.Received;
+      fflush(stdout);
+    }
+  }
+  fflush(stdout);
+  fprintf(stderr, "total: received %llu  missing %llu  crc errors %llu  bad framing %llu  other frames %llu\n",
+          (unsigned long long)Sequence.Received, (unsigned long long)Sequence.Missing,
+          (unsigned long long)CrcErrors, (unsigned long long)Reader.BadFrames, (unsigned long long)OtherFrames);
+  close(Fd);
+  if (Capture >= 0)
+    close(Capture);
+  return 0;
+}
@@ -0,0 +1,333 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge host tools
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// telemetryring.h
+// hands decoded telemetry from the one program that owns the serial port to
+// any number of others on the same PC, through a ring in POSIX shared memory
+// (/dev/shm/<name>).
+//
+// one writer, any number of readers, no locks. The writer never waits for a
+// reader: a reader that falls more than a ring behind loses the oldest frames
+// and is told how many (an overrun), and no reader can slow the writer or
+// the other readers. Readers attach and detach whenever they like; the
+// writer doesn't know they are there.
+//
+// each slot is a seqlock: its sequence is 2n+1 while frame n is written into
+// it and 2n+2 once it is complete; the head holds the number of frames
+// published. A reader copies a slot out and checks the sequence didn't change
+// while it did so. The writer decodes straight into the slot, so a frame is
+// copied once, into the reader's own Telemetry.
+//
+// a reader with nothing to do sleeps on a futex in the header; the writer only
+// makes the wake system call when a reader is asleep.
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __TELEMETRYRING_H
+#define __TELEMETRYRING_H
+
+#include "bridgeproto.h"
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <new>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace bridge
+{
+
+constexpr char RingMagic[8] = {'V', 'S', 'W', 'R', 'R', 'N', 'G', 0};
+constexpr uint32_t RingVersion = 1;
+constexpr uint32_t DefaultRingSlots = 4096;        // 8s at 500 frames/s
+constexpr const char* DefaultRingName = "/vswr-bridge";
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "ring needs lock free 64 bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "ring needs lock free 32 bit atomics");
+
+struct alignas(64) RingSlot
+{
+  std::atomic<uint64_t> Sequence;                   // 2n+1 while frame n is written, 2n+2 after
+  int64_t PublishedNanos;                           // CLOCK_MONOTONIC when published
+  Telemetry Data;
+};
+
+struct RingHeader
+{
+  char Magic[8];
+  uint32_t Version;
+  uint32_t Slots;                                   // a power of 2
+  uint32_t SlotSize;
+  int32_t WriterPid;
+  alignas(64) std::atomic<uint64_t> Head;           // frames published
+  std::atomic<uint32_t> Wake;                       // futex: bumped when readers are asleep
+  std::atomic<uint32_t> Sleepers;
+  std::atomic<uint32_t> Closed;                     // the writer has finished
+};
+
+// the header, rounded up to whole slots, then the slots
+constexpr size_t RingHeaderSpace = (sizeof(RingHeader) + sizeof(RingSlot) - 1) / sizeof(RingSlot) * sizeof(RingSlot);
+
+inline size_t RingBytes(uint32_t Slots)
+{
+  return RingHeaderSpace + sizeof(RingSlot) * (size_t)Slots;
+}
+
+inline int64_t MonotonicNanos(void)
+{
+  timespec Ts;
+  clock_gettime(CLOCK_MONOTONIC, &Ts);
+  return (int64_t)Ts.tv_sec * 1000000000 + Ts.tv_nsec;
+}
+
+inline long Futex(std::atomic<uint32_t>* Word, int Op, uint32_t Value, const timespec* Timeout = nullptr)
+{
+  return syscall(SYS_futex, reinterpret_cast<uint32_t*>(Word), Op, Value, Timeout, nullptr, 0);
+}
+
+
+//
+// the program that owns the serial port
+//
+class RingWriter
+{
+public:
+  ~RingWriter() { Close(); }
+
+  //
+  // make a new ring, replacing any left by an earlier writer
+  // returns false with errno set
+  //
+  bool Create(const std::string& RingName, uint32_t Slots = DefaultRingSlots)
+  {
+    if (Slots == 0 || (Slots & (Slots - 1)) != 0)
+    {
+      errno = EINVAL;
+      return false;
+    }
+    Name = RingName;
+    shm_unlink(Name.c_str());                       // readers of an old ring keep their mapping
+    int Fd = shm_open(Name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (Fd < 0)
+      return false;
+    Bytes = RingBytes(Slots);
+    void* Map = ftruncate(Fd, (off_t)Bytes) == 0
+                ? mmap(nullptr, Bytes, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0) : MAP_FAILED;
+    close(Fd);
+    if (Map == MAP_FAILED)
+    {
+      shm_unlink(Name.c_str());
+      return false;
+    }
+    Header = new (Map) RingHeader();
+    Ring = reinterpret_cast<RingSlot*>(static_cast<uint8_t*>(Map) + RingHeaderSpace);
+    for (uint32_t i = 0; i < Slots; i++)
+      new (&Ring[i]) RingSlot();
+    Mask = Slots - 1;
+    Header->Version = RingVersion;
+    Header->Slots = Slots;
+    Header->SlotSize = sizeof(RingSlot);
+    Header->WriterPid = (int32_t)getpid();
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(Header->Magic, RingMagic, sizeof(RingMagic));  // readers check this last
+    return true;
+  }
+
+  //
+  // the slot for the next frame: decode into it, then Publish()
+  // (if the frame turns out to be bad, just don't publish it)
+  //
+  Telemetry& Claim(void)
+  {
+    uint64_t n = Header->Head.load(std::memory_order_relaxed);
+    Slot = &Ring[n & Mask];
+    Slot->Sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return Slot->Data;
+  }
+
+  void Publish(void)
+  {
+    uint64_t n = Header->Head.load(std::memory_order_relaxed);
+    Slot->PublishedNanos = MonotonicNanos();
+    Slot->Sequence.store(2 * n + 2, std::memory_order_release);
+    Header->Head.store(n + 1, std::memory_order_seq_cst);
+    if (Header->Sleepers.load(std::memory_order_seq_cst) != 0)
+    {
+      Header->Wake.fetch_add(1, std::memory_order_seq_cst);
+      Futex(&Header->Wake, FUTEX_WAKE, INT_MAX);
+    }
+  }
+
+  uint64_t Published(void) const { return Header ? Header->Head.load(std::memory_order_relaxed) : 0; }
+
+  //
+  // tell the readers there is no more, and remove the ring
+  //
+  void Close(void)
+  {
+    if (!Header)
+      return;
+    Header->Closed.store(1, std::memory_order_seq_cst);
+    Header->Wake.fetch_add(1, std::memory_order_seq_cst);
+    Futex(&Header->Wake, FUTEX_WAKE, INT_MAX);
+    munmap(Header, Bytes);
+    shm_unlink(Name.c_str());
+    Header = nullptr;
+  }
+
+private:
+  std::string Name;
+  RingHeader* Header = nullptr;
+  RingSlot* Ring = nullptr;
+  RingSlot* Slot = nullptr;
+  size_t Bytes = 0;
+  uint64_t Mask = 0;
+};
+
+
+//
+// a program that wants the readings
+//
+class RingReader
+{
+public:
+  uint64_t Received = 0;
+  uint64_t Overruns = 0;                            // frames lost by falling a ring behind
+
+  ~RingReader() { Detach(); }
+
+  //
+  // attach to a ring; reading starts with the next frame published, or with
+  // the oldest still in the ring if FromOldest
+  // returns false with errno set (ENOENT if there is no writer yet)
+  //
+  bool Attach(const std::string& Name, bool FromOldest = false)
+  {
+    Detach();
+    int Fd = shm_open(Name.c_str(), O_RDWR | O_CLOEXEC, 0);
+    if (Fd < 0)
+      return false;
+    struct stat St;
+    void* Map = MAP_FAILED;
+    if (fstat(Fd, &St) == 0)
+    {
+      if ((size_t)St.st_size >= RingBytes(1))
+        Map = mmap(nullptr, (size_t)St.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0);
+      else
+        errno = EPROTO;                             // the writer hasn't sized it yet
+    }
+    close(Fd);
+    if (Map == MAP_FAILED)
+      return false;
+    Bytes = (size_t)St.st_size;
+    Header = static_cast<RingHeader*>(Map);
+    bool Ready = memcmp(Header->Magic, RingMagic, sizeof(RingMagic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!Ready || Header->Version != RingVersion
+        || Header->SlotSize != sizeof(RingSlot) || Bytes < RingBytes(Header->Slots))
+    {
+      Detach();
+      errno = EPROTO;                               // not ready yet, or a different version
+      return false;
+    }
+    Ring = reinterpret_cast<RingSlot*>(static_cast<uint8_t*>(Map) + RingHeaderSpace);
+    Slots = Header->Slots;
+    uint64_t Head = Header->Head.load(std::memory_order_acquire);
+    Next = FromOldest && Head > Slots ? Head - Slots : FromOldest ? 0 : Head;
+    return true;
+  }
+
+  void Detach(void)
+  {
+    if (Header)
+      munmap(Header, Bytes);
+    Header = nullptr;
+  }
+
+  bool Attached(void) const { return Header != nullptr; }
+
+  //
+  // copy out the next frame; returns false if there isn't one yet
+  // PublishedNanos (CLOCK_MONOTONIC) is for measuring the delay
+  //
+  bool Read(Telemetry& Out, int64_t* PublishedNanos = nullptr)
+  {
+    for (;;)
+    {
+      uint64_t Head = Header->Head.load(std::memory_order_acquire);
+      if (Next >= Head)
+        return false;
+      if (Head - Next > Slots)
+      {
+        Overruns += Head - Slots - Next;
+        Next = Head - Slots;
+      }
+      const RingSlot& S = Ring[Next & (Slots - 1)];
+      uint64_t Before = S.Sequence.load(std::memory_order_acquire);
+      if (Before == 2 * Next + 2)
+      {
+        memcpy(static_cast<void*>(&Out), &S.Data, sizeof(Out));
+        int64_t Nanos = S.PublishedNanos;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (S.Sequence.load(std::memory_order_relaxed) == Before)
+        {
+          if (PublishedNanos)
+            *PublishedNanos = Nanos;
+          Next++;
+          Received++;
+          return true;
+        }
+      }
+      Overruns++;                                   // the writer has lapped us on this slot
+      Next++;
+    }
+  }
+
+  //
+  // sleep until a frame is published, the writer closes, or TimeoutMs passes
+  // returns true if there may be a frame to read
+  //
+  bool Wait(int TimeoutMs)
+  {
+    if (Next < Header->Head.load(std::memory_order_acquire))
+      return true;
+    Header->Sleepers.fetch_add(1, std::memory_order_seq_cst);
+    uint32_t Wake = Header->Wake.load(std::memory_order_seq_cst);
+    if (Next >= Header->Head.load(std::memory_order_seq_cst) && !Header->Closed.load())
+    {
+      timespec Timeout{TimeoutMs / 1000, (TimeoutMs % 1000) * 1000000L};
+      Futex(&Header->Wake, FUTEX_WAIT, Wake, &Timeout);
+    }
+    Header->Sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    return Next < Header->Head.load(std::memory_order_acquire);
+  }
+
+  //
+  // true once the writer has closed the ring or died, and every frame has been read;
+  // attach again to pick up a new writer
+  //
+  bool WriterGone(void)
+  {
+    if (Next < Header->Head.load(std::memory_order_acquire))
+      return false;
+    return Header->Closed.load() || (kill(Header->WriterPid, 0) != 0 && errno == ESRCH);
+  }
+
+private:
+  RingHeader* Header = nullptr;
+  RingSlot* Ring = nullptr;
+  size_t Bytes = 0;
+  uint64_t Slots = 0;
+  uint64_t Next = 0;                                // the next frame to read
+};
+
+}   // namespace bridge
+
+#endif      // file sentry
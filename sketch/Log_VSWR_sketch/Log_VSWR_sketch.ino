@@ -15,6 +15,8 @@
 #include "display.h"
 #include "analogueio.h"
 #include "configdata.h"
+#include "telemetry.h"
+#include "console.h"
 
 
 #define VSLOWTICKCOUNT 20                     // 20 1ms fast ticks to get one slow tick.
@@ -60,6 +62,7 @@ void setup()
 // check that the flash is programmed, then load to RAM
 //  
   LoadSettingsFromEEprom();
+  TelemetryInit();
   
   DisplayInit();
   AnalogueIOInit();
@@ -74,8 +77,8 @@ ISR(TCB0_INT_vect)
 {
    // Clear interrupt flag
   TCB0.INTFLAGS = TCB_CAPT_bm;
+  DisplayFastTick();                        // send queued display commands
 
-  AnalogueIOFastTick();
   if(--GSlowTickCounter == 0)
   {
     GSlowTickTriggered = true;
@@ -90,6 +93,8 @@ ISR(TCB0_INT_vect)
 //
 void loop() 
 {
+  ConsoleService();                         // USB serial commands
+  TelemetryService();                       // telemetry to the PC, if requested
   while (GSlowTickTriggered)
   {
     GSlowTickTriggered = false;
@@ -112,6 +117,10 @@ void loop()
 // display update
 //
     DisplayTick();
+//
+// write changed settings to EEPROM
+//
+    ConfigTick();
       
   }
 }
@@ -124,4 +133,6 @@ void loop()
 void ConfigIOPins(void)
 {
   pinMode(LED_BUILTIN, OUTPUT);                         // LED output
+  pinMode(VPINTRIPOUTPUT, OUTPUT);                      // VSWR trip output
+  digitalWrite(VPINTRIPOUTPUT, LOW);                    // not tripped
 }
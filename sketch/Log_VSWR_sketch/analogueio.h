@@ -14,6 +14,8 @@
 #ifndef __ANALOGUEIO_H
 #define __ANALOGUEIO_H
 
+#include "globalinclude.h"
+
 
 //
 // externally accessible globals:
@@ -23,21 +25,93 @@ extern int GReverseTenthdBm;
 extern unsigned int GFwdLineVoltageTenth;
 extern unsigned int GRevLineVoltageTenth;
 extern unsigned int GVSWR;                               // 1 decimal place. set to 9999 if impossible
+//
+// ADC sample handover statistics
+//
+extern unsigned long GSamplesProcessed;                  // total ADC samples used
+extern unsigned int GSamplesLost;                        // samples missing from the ADC sequence
+extern unsigned int GBlocksTorn;                         // sample blocks written after being claimed
+//
+// VSWR protection status
+//
+extern volatile bool GTripped;                           // true if the trip output is active
+extern unsigned int GTripCount;                          // number of trips since power up (read with interrupts off)
+
+//
+// telemetry: the ADC readings over one telemetry frame period, and the values found from them
+// readings are in units of 1/16 ADC code, as used by the sample blocks
+//
+struct TelemetryData
+{
+  unsigned long FwdSum, RevSum;                           // summed readings
+  unsigned int FwdCount, RevCount;                        // number of summed readings
+  unsigned int FwdPeak, RevPeak;                          // peak readings
+  unsigned int EndSequence;                               // ADC conversion sequence number of the last reading
+  int FwdTenthdBm, RevTenthdBm;                           // average line power, tenths of dBm
+  unsigned int FwdAvgPowerTenth, RevAvgPowerTenth;        // average line power, tenths of W
+  unsigned int FwdPeakPowerTenth, RevPeakPowerTenth;      // peak line power, tenths of W
+  unsigned int VSWR;                                      // from the peak readings, tenths
+  bool Tripped;                                           // VSWR protection trip output active
+};
+
+#ifdef VTRENDPAGE
+//
+// trend history: forward power, reverse power and VSWR, one point every VTRENDDECIMATE ticks
+// each point is scaled 0 to VTRENDHEIGHT, ready to draw
+//
+#define VTRENDCHANNELS 3                                  // forward, reverse, VSWR
+#define VTRENDLENGTH 300                                  // points: one per pixel across the waveform
+#define VTRENDHEIGHT 200                                  // full scale point value (waveform pixels)
+#define VTRENDDECIMATE 2                                  // ticks per point
+#define VTRENDPOINTMS (VTRENDDECIMATE * 20)               // ms per point
+extern byte GTrendHistory[VTRENDCHANNELS][VTRENDLENGTH];
+extern unsigned int GTrendWritePosition;                  // where the next point is written
+extern unsigned long GTrendPointCount;                    // points added since power up
+extern unsigned long GTrendPointTime;                     // millis() when the newest point was added
+#endif
 
 
 
 
 //
 // AnalogueIO initialise
+// starts the ADC converting continuously under interrupt
 //
 void AnalogueIOInit(void);
 
 
+//
+// set the fixed point coefficients used to convert ADC readings
+// from the calibration constants
+//
+void AnalogueIOSetCalibration(void);
+
+
+//
+// select the calibration set for a band
+// takes effect from the next tick
+//
+void AnalogueIOSelectBand(byte Band);
+
+
+//
+// calculate the VSWR protection thresholds from the protection settings
+// call after changing the settings or the calibration band
+//
+void AnalogueIOSetProtection(void);
+
+
+//
+// clear the VSWR protection trip output
+//
+void AnalogueIOResetTrip(void);
+
 
 //
-// fast tick: read one ADC value
+// select normal or oversampling ADC mode
+// oversampling accumulates 16 ADC samples per result for 2 extra bits of resolution
 //
-void AnalogueIOFastTick();
+void AnalogueIOSetOversampling(bool Oversample);
 
 
 
@@ -49,7 +123,19 @@ void AnalogueIOTick(void);
 
 
 //
-// find peak power by searching buffer
+// start or stop collecting ADC readings for telemetry
+//
+void AnalogueIOEnableTelemetry(bool Enable);
+
+
+//
+// claim the ADC readings collected since the last call, and find the values from them
+//
+void AnalogueIOGetTelemetry(TelemetryData* Data);
+
+
+//
+// find peak power from the sliding window
 // returns a power peak value
 // 1st parameter true for forward power
 // 2nd paramter true for units of tenths of a watt
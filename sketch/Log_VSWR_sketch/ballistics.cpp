@@ -0,0 +1,184 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// ballistics.cpp
+// this file holds the meter ballistics code: how the displayed power
+// follows the measured power
+//
+// every mode is updated incrementally once per tick in fixed point
+// (tenths of a watt x 256), so a long hold or time constant costs no
+// more than a short one. All modes run all the time, so switching
+// mode never shows a stale value.
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "ballistics.h"
+#include "configdata.h"
+#include "analogueio.h"
+
+
+//
+// preset ballistics parameters
+// hold in ticks (20ms); decay and time constants as shifts: 2^N ticks
+//
+const BallisticsParams GBallisticsPresets[VNUMBALLISTICSPRESETS] =
+{
+  {100, 3, 3, 0, 5},                            // normal: 2s hold, 160ms EMA, 640ms release
+  {25, 2, 2, 0, 3},                             // fast: 0.5s hold, 80ms EMA, 160ms release
+  {250, 4, 5, 1, 6}                             // slow: 5s hold, 640ms EMA, 1.3s release
+};
+
+
+const char* GMeterModeNames[VNUMMETERMODES] =
+{
+  "Average",
+  "Peak",
+  "PEP",
+  "EMA",
+  "SSB"
+};
+
+
+//
+// state for one channel (forward or reverse)
+// levels in tenths of a watt x 256
+//
+struct BallisticsChannel
+{
+  unsigned long PEPLevel;                       // PEP hold level
+  unsigned long EMALevel;                       // exponential moving average
+  unsigned long ARLevel;                        // attack/release level
+  byte HoldCount;                               // ticks left to hold PEP value
+};
+
+BallisticsChannel GFwdBallistics;
+BallisticsChannel GRevBallistics;
+
+
+
+//
+// initialise the ballistics
+//
+void BallisticsInit(void)
+{
+  memset(&GFwdBallistics, 0, sizeof(BallisticsChannel));
+  memset(&GRevBallistics, 0, sizeof(BallisticsChannel));
+}
+
+
+//
+// load a preset set of ballistics parameters
+//
+void BallisticsLoadPreset(byte Preset)
+{
+  if(Preset < VNUMBALLISTICSPRESETS)
+    GBallistics = GBallisticsPresets[Preset];
+}
+
+
+//
+// update one channel with new average and peak readings
+//
+void UpdateBallisticsChannel(BallisticsChannel* Channel, unsigned int Average, unsigned int Peak)
+{
+  unsigned long Sample;
+  unsigned long Decay;
+
+//
+// PEP hold: follow any new peak, hold it, then decay exponentially
+//
+  Sample = (unsigned long)Peak << 8;
+  if(Sample >= Channel->PEPLevel)
+  {
+    Channel->PEPLevel = Sample;
+    Channel->HoldCount = GBallistics.HoldTicks;
+  }
+  else if(Channel->HoldCount != 0)
+    Channel->HoldCount--;
+  else
+  {
+    Decay = (Channel->PEPLevel >> GBallistics.DecayShift) + 1;
+    if(Channel->PEPLevel > Sample + Decay)
+      Channel->PEPLevel -= Decay;
+    else
+      Channel->PEPLevel = Sample;
+  }
+
+//
+// exponential moving average of the average power
+//
+  Sample = (unsigned long)Average << 8;
+  if(Sample > Channel->EMALevel)
+    Channel->EMALevel += (Sample - Channel->EMALevel) >> GBallistics.EMAShift;
+  else
+    Channel->EMALevel -= (Channel->EMALevel - Sample) >> GBallistics.EMAShift;
+
+//
+// attack/release, following the peak power
+//
+  Sample = (unsigned long)Peak << 8;
+  if(Sample > Channel->ARLevel)
+    Channel->ARLevel += (Sample - Channel->ARLevel) >> GBallistics.AttackShift;
+  else
+    Channel->ARLevel -= (Channel->ARLevel - Sample) >> GBallistics.ReleaseShift;
+}
+
+
+//
+// ballistics tick: update with the latest average and peak power readings
+//
+void BallisticsTick(unsigned int FwdAverage, unsigned int FwdPeak, unsigned int RevAverage, unsigned int RevPeak)
+{
+  UpdateBallisticsChannel(&GFwdBallistics, FwdAverage, FwdPeak);
+  UpdateBallisticsChannel(&GRevBallistics, RevAverage, RevPeak);
+}
+
+
+//
+// returns the power to display, processed by the selected meter mode
+// 1st parameter true for forward power
+// 2nd parameter true for units of tenths of a watt
+//
+unsigned int GetMeterPower(bool IsFwdPower, bool InTenths)
+{
+  BallisticsChannel* Channel;
+  unsigned int Result;
+
+  if(IsFwdPower)
+    Channel = &GFwdBallistics;
+  else
+    Channel = &GRevBallistics;
+
+  switch(GMeterModeInUse)
+  {
+    case eMeterAverage:
+    default:
+      Result = GetPowerReading(IsFwdPower, true);
+      break;
+
+    case eMeterPeak:
+      Result = FindPeakPower(IsFwdPower, true);
+      break;
+
+    case eMeterPEPHold:
+      Result = (unsigned int)(Channel->PEPLevel >> 8);
+      break;
+
+    case eMeterEMA:
+      Result = (unsigned int)(Channel->EMALevel >> 8);
+      break;
+
+    case eMeterAttackRelease:
+      Result = (unsigned int)(Channel->ARLevel >> 8);
+      break;
+  }
+  if(!InTenths)                                                      // convert to watts if needed
+    Result = Result/10;
+  return Result;
+}
@@ -0,0 +1,72 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// ballistics.h
+// this file holds the meter ballistics code: how the displayed power
+// follows the measured power
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __BALLISTICS_H
+#define __BALLISTICS_H
+
+
+//
+// this type enumerates the meter modes
+// the first two match the old average/peak setting stored in EEPROM
+//
+enum EMeterMode
+{
+  eMeterAverage,                            // average over the last N ticks
+  eMeterPeak,                               // peak over the last N ticks
+  eMeterPEPHold,                            // PEP hold then decay
+  eMeterEMA,                                // exponential moving average
+  eMeterAttackRelease                       // fast attack, slow release (for SSB)
+};
+#define VNUMMETERMODES 5
+
+//
+// preset ballistics parameters
+//
+#define VNUMBALLISTICSPRESETS 3             // normal, fast, slow
+
+
+//
+// meter mode names, for display buttons
+//
+extern const char* GMeterModeNames[VNUMMETERMODES];
+
+
+//
+// initialise the ballistics
+//
+void BallisticsInit(void);
+
+
+//
+// load a preset set of ballistics parameters
+//
+void BallisticsLoadPreset(byte Preset);
+
+
+//
+// ballistics tick: update with the latest average and peak power readings
+// (units of tenths of a watt). Called every 20ms tick
+//
+void BallisticsTick(unsigned int FwdAverage, unsigned int FwdPeak, unsigned int RevAverage, unsigned int RevPeak);
+
+
+//
+// returns the power to display, processed by the selected meter mode
+// 1st parameter true for forward power
+// 2nd parameter true for units of tenths of a watt
+//
+unsigned int GetMeterPower(bool IsFwdPower, bool InTenths);
+
+
+#endif      // file sentry
@@ -9,94 +9,648 @@
 //
 // configdata.cpp
 // this file holds the code to save and load settings to/from EEPROM
+//
+// settings are held in RAM and written to EEPROM in the background: a change
+// marks its record dirty, and once there have been no changes for a quiet
+// period the record is written, one byte per tick, by ConfigTick(). So a
+// touch callback never waits for EEPROM, and a burst of changes (cycling
+// through the pages) is written once.
+//
+// there are two records, each stored as a log of slots written in turn:
+// the settings image (calibration, ballistics, protection etc, rarely changed)
+// and the display state (page, scale, meter mode, changed by the buttons).
+// each slot has a header and a CRC:
+//    byte 0: magic number (different for each record)
+//    byte 1: version of the record layout: a record newer than this code is ignored
+//    byte 2: payload length
+//    byte 3: sequence number, incremented for each write
+//    byte 4 onwards: payload (the fields in their table order)
+//    then: CRC16 of all the above, low byte first
+// at boot the newest valid slot is loaded. A write goes to the slot after the
+// newest, so if it is interrupted the previous record is still there; and
+// the writes, and the wear, are spread over all the slots.
+//
+// fields are only ever added to the end of a record, and never change meaning,
+// so there is nothing to convert: an older record is shorter, so its fields are
+// loaded and the new ones keep their defaults. Every field is range checked
+// after loading (ConfigCheckSettings()), so a bad value can't get into use.
 /////////////////////////////////////////////////////////////////////////
 
 #include <Arduino.h>
 #include "globalinclude.h"
+#include "configdata.h"
+#include "ballistics.h"
+#include "display.h"
+#include "displaylink.h"
 
 #include <EEPROM.h>
 
-#define VEEINITPATTERN 0x6F                     // addr 0 set to this if configured
-#define VPAGEADDR 1                             // address in EEPROM for display page setting
-#define VSCALEADDR 2                            // address in EEPROM for display scale setting
-#define VPEAKADDR 3                             // address in EEPROM for display scale setting
+
+//
+// EEPROM layout:
+// addr 0-227: settings image, 2 slots of 114 bytes
+// addr 228-254: display state, 3 slots of 9 bytes
+//
+#define VHEADERSIZE 4                           // magic, version, length, sequence
+#define VRECORDOVERHEAD (VHEADERSIZE + 2)       // header and CRC
+#define VIMAGEADDR 0
+#define VIMAGESLOTS 2
+#define VIMAGESLOTSIZE 114
+#define VIMAGEMAGIC 0xB5
+#define VIMAGEVERSION 1
+#define VSTATEADDR 228
+#define VSTATESLOTS 3
+#define VSTATESLOTSIZE 9
+#define VSTATEMAGIC 0xC3
+#define VSTATEVERSION 1
+#define VQUIETTICKS 100                         // 2s with no changes before a record is written
+
+//
+// layout used by the released code, converted at the first boot with this code
+//
+#define VLEGACYPATTERN 0x6F                     // addr 0 set to this if configured
+#define VLEGACYPAGEADDR 1                       // display page setting
+#define VLEGACYSCALEADDR 2                      // display scale setting
+#define VLEGACYPEAKADDR 3                       // average (0) or peak (1) display
+
+//
+// defaults
+//
+#define VDEFAULTCOUPLINGQ8 (50 * 256)           // default coupler coupling factor 50dB
+#define VDEFAULTDBSCALEQ20 131387UL             // detector slope 0.1253dB per ADC code
+#define VDEFAULTDBMOFFSETQ8 (-96 * 256)         // detector -96dBm at ADC code 0
+
+//
+// limits for the range checks
+// the detector scale must keep (ADC reading x scale) inside 32 bits, and the largest
+// VSWR threshold difference (at 1.1:1) inside 16 bits with a reading added
+//
+#define VMINDBSCALEQ20 16384UL                  // 1/64 dB per ADC code
+#define VMAXDBSCALEQ20 262144UL                 // 1/4 dB per ADC code
+#define VMINTRIPVSWR 11                         // 1.1:1
+#define VMAXFULLSCALE 10000                     // largest display full scale power (W)
 
 byte GDisplayPageInUse;                         // display page to start at
 byte GDisplayScaleInUse;                        // display scale 0:2W   1: 20W   2: 200W   3: 2kW
-bool GPeakDisplayInUse;                         // true if we are displaying peak values
+byte GMeterModeInUse;                           // meter mode (EMeterMode): average, peak etc
+bool GOversampleInUse;                          // true if ADC oversampling selected
+byte GBandInUse;                                // band for calibration
+byte GDisplayBaudInUse;                         // display serial rate (VDISPLAYBAUDUNKNOWN if not found yet)
+CalibrationSet GCalibrationSets[VNUMBANDS];     // calibration for each band
+BallisticsParams GBallistics;                   // meter ballistics in use
+ProtectionParams GProtection;                   // VSWR protection settings
+DetectorParams GDetector;                       // log detector response
+unsigned int GPowerFullScale[VNUMSCALES];       // full scale power of each display scale (W)
+
+
+//
+// the fields of each record, in the order they are stored
+// add new fields to the end only
+//
+struct SettingsField
+{
+  void* Address;
+  byte Size;
+};
+
+const SettingsField GImageFields[] =
+{
+  {&GOversampleInUse, sizeof(GOversampleInUse)},
+  {&GBandInUse, sizeof(GBandInUse)},
+  {&GDisplayBaudInUse, sizeof(GDisplayBaudInUse)},
+  {GCalibrationSets, sizeof(GCalibrationSets)},
+  {&GBallistics, sizeof(GBallistics)},
+  {&GProtection, sizeof(GProtection)},
+  {&GDetector, sizeof(GDetector)},
+  {GPowerFullScale, sizeof(GPowerFullScale)}
+};
+
+const SettingsField GStateFields[] =
+{
+  {&GDisplayPageInUse, sizeof(GDisplayPageInUse)},
+  {&GDisplayScaleInUse, sizeof(GDisplayScaleInUse)},
+  {&GMeterModeInUse, sizeof(GMeterModeInUse)}
+};
+
+
+//
+// each record: its fields and where its slots are
+// the image payload is 104 bytes, of the 108 a slot has room for
+//
+enum ERecord
+{
+  eImageRecord,
+  eStateRecord
+};
+
+struct RecordType
+{
+  const SettingsField* Fields;
+  byte NumFields;
+  byte Magic;
+  byte Version;
+  int Addr;                                     // EEPROM address of the first slot
+  byte NumSlots;
+  byte SlotSize;
+};
+
+#define VNUMRECORDS 2
+const RecordType GRecordTypes[VNUMRECORDS] =
+{
+  {GImageFields, sizeof(GImageFields) / sizeof(SettingsField), VIMAGEMAGIC, VIMAGEVERSION, VIMAGEADDR, VIMAGESLOTS, VIMAGESLOTSIZE},
+  {GStateFields, sizeof(GStateFields) / sizeof(SettingsField), VSTATEMAGIC, VSTATEVERSION, VSTATEADDR, VSTATESLOTS, VSTATESLOTSIZE}
+};
+
+
+//
+// what is known about each record in EEPROM
+//
+struct RecordState
+{
+  byte Length;                                  // payload length (sum of the field sizes)
+  byte NextSlot;                                // slot the next write goes to
+  byte Sequence;                                // sequence number of the newest slot
+  bool Dirty;                                   // RAM settings changed since written
+  byte QuietTicks;                              // ticks since the last change
+};
+RecordState GRecordStates[VNUMRECORDS];
+
+
+//
+// the record being written by ConfigTick()
+//
+#define VNOWRITE 0xFF
+byte GWriteRecord = VNOWRITE;                   // record being written, or VNOWRITE
+byte GWritePosition;                            // next byte of the slot to write
+byte GWriteHeader[VHEADERSIZE];                 // header being written
+unsigned int GWriteCRC;                         // CRC being written
+
+
+
+//
+// add a byte to a CRC16 (CCITT polynomial 0x1021)
+//
+unsigned int CRC16Update(unsigned int CRC, byte Data)
+{
+  byte Bit;
+
+  CRC ^= (unsigned int)Data << 8;
+  for (Bit = 0; Bit < 8; Bit++)
+  {
+    if (CRC & 0x8000)
+      CRC = (CRC << 1) ^ 0x1021;
+    else
+      CRC <<= 1;
+  }
+  return CRC;
+}
+
+
+//
+// find the byte at a position in a record's payload, from the RAM settings
+//
+byte GetPayloadByte(byte Record, byte Position)
+{
+  const RecordType* Type;
+  byte Cntr;
+
+  Type = &GRecordTypes[Record];
+  for (Cntr = 0; Cntr < Type->NumFields; Cntr++)
+  {
+    if (Position < Type->Fields[Cntr].Size)
+      return ((byte*)Type->Fields[Cntr].Address)[Position];
+    Position -= Type->Fields[Cntr].Size;
+  }
+  return 0;
+}
+
+
+//
+// change the byte at a position in a record's payload, in the RAM settings
+//
+void SetPayloadByte(byte Record, byte Position, byte Value)
+{
+  const RecordType* Type;
+  byte Cntr;
+
+  Type = &GRecordTypes[Record];
+  for (Cntr = 0; Cntr < Type->NumFields; Cntr++)
+  {
+    if (Position < Type->Fields[Cntr].Size)
+    {
+      ((byte*)Type->Fields[Cntr].Address)[Position] = Value;
+      return;
+    }
+    Position -= Type->Fields[Cntr].Size;
+  }
+}
+
+
+//
+// find the byte at a position in the slot being written
+// header, then payload, then CRC
+//
+byte GetWriteByte(byte Position)
+{
+  byte Length;
+
+  Length = GRecordStates[GWriteRecord].Length;
+  if (Position < VHEADERSIZE)
+    return GWriteHeader[Position];
+  Position -= VHEADERSIZE;
+  if (Position < Length)
+    return GetPayloadByte(GWriteRecord, Position);
+  if (Position == Length)
+    return (byte)GWriteCRC;
+  return (byte)(GWriteCRC >> 8);
+}
+
+
+//
+// load a record from the newest valid slot
+// each slot is read in one pass into a buffer, then checked; the fields are copied out
+// of the newest good one. Fields beyond its length keep the defaults already set.
+// returns true if a valid slot was found
+//
+bool LoadRecord(byte Record)
+{
+  const RecordType* Type;
+  RecordState* State;
+  byte Buffer[VIMAGESLOTSIZE];
+  byte Slot, Cntr, Length, Position;
+  int Addr;
+  unsigned int CRC;
+  bool Found = false;
+  byte Newest = 0;
+  byte NewestSequence = 0;
+
+  Type = &GRecordTypes[Record];
+  State = &GRecordStates[Record];
+  for (Slot = 0; Slot < Type->NumSlots; Slot++)
+  {
+    Addr = Type->Addr + Slot * Type->SlotSize;
+    for (Cntr = 0; Cntr < Type->SlotSize; Cntr++)
+      Buffer[Cntr] = EEPROM.read(Addr + Cntr);
+    Length = Buffer[2];
+    if ((Buffer[0] != Type->Magic) || (Buffer[1] == 0) || (Buffer[1] > Type->Version)
+        || (Length + VRECORDOVERHEAD > Type->SlotSize))
+      continue;
+    CRC = 0xFFFF;
+    for (Cntr = 0; Cntr < VHEADERSIZE + Length; Cntr++)
+      CRC = CRC16Update(CRC, Buffer[Cntr]);
+    if (((byte)CRC != Buffer[VHEADERSIZE + Length]) || ((byte)(CRC >> 8) != Buffer[VHEADERSIZE + Length + 1]))
+      continue;
+    if (!Found || ((signed char)(Buffer[3] - NewestSequence) > 0))
+    {
+      Found = true;
+      Newest = Slot;
+      NewestSequence = Buffer[3];
+    }
+  }
+
+  State->NextSlot = 0;
+  State->Sequence = 0;
+  if (!Found)
+    return false;
+//
+// found: read the newest slot again, and copy out the whole fields it holds
+//
+  Addr = Type->Addr + Newest * Type->SlotSize;
+  for (Cntr = 0; Cntr < Type->SlotSize; Cntr++)
+    Buffer[Cntr] = EEPROM.read(Addr + Cntr);
+  Length = Buffer[2];
+  Position = VHEADERSIZE;
+  for (Cntr = 0; Cntr < Type->NumFields; Cntr++)
+  {
+    if (Position + Type->Fields[Cntr].Size > VHEADERSIZE + Length)
+      break;
+    memcpy(Type->Fields[Cntr].Address, Buffer + Position, Type->Fields[Cntr].Size);
+    Position += Type->Fields[Cntr].Size;
+  }
+  State->NextSlot = (Newest + 1) % Type->NumSlots;
+  State->Sequence = NewestSequence;
+//
+// a shorter record (or an older version) needs writing again with the current layout
+//
+  if ((Length != State->Length) || (Buffer[1] != Type->Version))
+    State->Dirty = true;
+  return true;
+}
+
+
+//
+// start writing a record to its next slot
+// the header and CRC are found now; the payload bytes are read from RAM as they are written
+//
+void StartRecordWrite(byte Record)
+{
+  RecordState* State;
+  byte Cntr;
+
+  State = &GRecordStates[Record];
+  GWriteRecord = Record;
+  GWritePosition = 0;
+  GWriteHeader[0] = GRecordTypes[Record].Magic;
+  GWriteHeader[1] = GRecordTypes[Record].Version;
+  GWriteHeader[2] = State->Length;
+  GWriteHeader[3] = State->Sequence + 1;
+  State->Dirty = false;
+
+  GWriteCRC = 0xFFFF;
+  for (Cntr = 0; Cntr < VHEADERSIZE; Cntr++)
+    GWriteCRC = CRC16Update(GWriteCRC, GWriteHeader[Cntr]);
+  for (Cntr = 0; Cntr < State->Length; Cntr++)
+    GWriteCRC = CRC16Update(GWriteCRC, GetPayloadByte(Record, Cntr));
+}
+
+
+//
+// mark a record as changed: it is written once there have been no changes for a while
+//
+void MarkRecordDirty(byte Record)
+{
+  GRecordStates[Record].Dirty = true;
+  GRecordStates[Record].QuietTicks = 0;
+}
 
 
 
 //
 // function to copy all config settings to EEprom
-// this copies the current RAM vaiables to the persistent storage
-// addr 0: defined pattern (to know EEPROM has been initialised)
-// addr 1: display page
-// addr 2: display scale
+// marks every record as changed, to be written straight away by ConfigTick()
 //
 void CopySettingsToEEprom(void)
 {
-  int Addr=1;
-  byte Setting;
-  int Cntr;
-  
+  byte Record;
+
+  for (Record = 0; Record < VNUMRECORDS; Record++)
+  {
+    GRecordStates[Record].Dirty = true;
+    GRecordStates[Record].QuietTicks = VQUIETTICKS;
+  }
+}
+
+
+
+//
+// function to set default VSWR protection
+// enabled, trip at 3:1 above 1W, reset automatically when below 2.5:1 for 1 second
 //
-// first set that we have initialised the EEprom
+void InitialiseProtection(void)
+{
+  GProtection.Flags = VPROTECTENABLE;
+  GProtection.TripVSWR = 30;
+  GProtection.HysteresisVSWR = 5;
+  GProtection.MinFwddBm = 30;
+  GProtection.ResetTicks = 50;
+}
+
+
+
 //
-  EEPROM.write(0, VEEINITPATTERN);
+// function to set the default display full scale powers: 2W, 20W, 200W, 2kW
 //
-// now copy settings from RAM data
+void InitialiseFullScales(void)
+{
+  GPowerFullScale[0] = 2;
+  GPowerFullScale[1] = 20;
+  GPowerFullScale[2] = 200;
+  GPowerFullScale[3] = 2000;
+}
+
+
+
 //
-  Setting = (byte) GDisplayPageInUse;
-  EEPROM.write(Addr++, Setting);
-  Setting = (byte) GDisplayScaleInUse;
-  EEPROM.write(Addr++, Setting);
-  Setting = (byte) GPeakDisplayInUse;
-  EEPROM.write(Addr++, Setting);
+// function to set default calibration
+// all bands the same: nominal coupling and no correction
+// and the nominal log detector response
+//
+void InitialiseCalibration(void)
+{
+  int Cntr;
+  byte Point;
+
+  for (Cntr = 0; Cntr < VNUMBANDS; Cntr++)
+  {
+    GCalibrationSets[Cntr].CouplingQ8 = VDEFAULTCOUPLINGQ8;
+    for (Point = 0; Point < VNUMCALPOINTS; Point++)
+      GCalibrationSets[Cntr].Correction[Point] = 0;
+  }
+  GDetector.dBScaleQ20 = VDEFAULTDBSCALEQ20;
+  GDetector.dBmOffsetQ8 = VDEFAULTDBMOFFSETQ8;
 }
 
 
 
 //
-// function to copy initial settings to EEprom
-// this sets the factory defaults
+// function to set the factory defaults
 // the settings here should match the fornt panel legend!
 //
-void InitialiseEEprom(void)
+void InitialiseSettings(void)
 {
-  int Cntr;
-  
   GDisplayPageInUse = 1;                        // crossed needles
   GDisplayScaleInUse = 0;                       // 2W
-  GPeakDisplayInUse = false;                    // average mode 
-// now copy them to FLASH
-  CopySettingsToEEprom();
+  GMeterModeInUse = eMeterAverage;              // average mode
+  GOversampleInUse = false;                     // one ADC sample per result
+  GBandInUse = e20m;
+  GDisplayBaudInUse = VDISPLAYBAUDUNKNOWN;       // search for the display
+  InitialiseCalibration();
+  BallisticsLoadPreset(0);                      // normal ballistics
+  InitialiseProtection();
+  InitialiseFullScales();
 }
 
 
 
 //
-// function to load config settings from flash
+// function to load the settings stored by the released code, at fixed addresses:
+// page, scale and average/peak (which is meter mode 0 or 1)
+//
+void LoadLegacySettings(void)
+{
+  GDisplayPageInUse = EEPROM.read(VLEGACYPAGEADDR);
+  GDisplayScaleInUse = EEPROM.read(VLEGACYSCALEADDR);
+  GMeterModeInUse = (EEPROM.read(VLEGACYPEAKADDR) != 0) ? eMeterPeak : eMeterAverage;
+}
+
+
+
+//
+// function to load config settings from EEprom
+// start with the defaults, then load each record; if there are none, convert the settings
+// from the old layout if it is there. Records not found are written straight away.
 //
 void LoadSettingsFromEEprom(void)
 {
-  int Addr=1;
-  byte Setting;
-  int Cntr;
+  byte Record;
+  byte Cntr;
+  bool Found = false;
+
+  InitialiseSettings();
+  for (Record = 0; Record < VNUMRECORDS; Record++)
+  {
+    GRecordStates[Record].Length = 0;
+    for (Cntr = 0; Cntr < GRecordTypes[Record].NumFields; Cntr++)
+    {
+      if (GRecordStates[Record].Length + GRecordTypes[Record].Fields[Cntr].Size + VRECORDOVERHEAD > GRecordTypes[Record].SlotSize)
+        break;                                  // no room: the slot size needs to grow
+      GRecordStates[Record].Length += GRecordTypes[Record].Fields[Cntr].Size;
+    }
+    GRecordStates[Record].Dirty = false;
+    if (LoadRecord(Record))
+      Found = true;
+    else
+      GRecordStates[Record].Dirty = true;
+    GRecordStates[Record].QuietTicks = VQUIETTICKS;
+  }
+  if (!Found && (EEPROM.read(0) == VLEGACYPATTERN))
+    LoadLegacySettings();
+  ConfigCheckSettings();
+}
+
+
+
+//
+// check every setting is in range, and reset any that isn't to its default
+// loaded records and settings image writes both come through here, so even a record
+// with a good CRC can't put a value in use that indexes past a table, divides by zero,
+// overflows or is used as too big a shift
+//
+void ConfigCheckSettings(void)
+{
+  byte Cntr;
+
+  if ((GDisplayPageInUse < 1) || (GDisplayPageInUse > VMAXPAGE))
+    GDisplayPageInUse = 1;
+  if (GMeterModeInUse >= VNUMMETERMODES)
+    GMeterModeInUse = eMeterAverage;
+  if (GDisplayScaleInUse >= VNUMSCALES)
+    GDisplayScaleInUse = 0;
+  if (*(byte*)&GOversampleInUse > 1)            // stored as a byte
+    GOversampleInUse = false;
+  if (GBandInUse >= VNUMBANDS)
+    GBandInUse = e20m;
+  if ((GDisplayBaudInUse >= VNUMBAUDRATES) && (GDisplayBaudInUse != VDISPLAYBAUDUNKNOWN))
+    GDisplayBaudInUse = VDISPLAYBAUDUNKNOWN;
+  if ((GDetector.dBScaleQ20 < VMINDBSCALEQ20) || (GDetector.dBScaleQ20 > VMAXDBSCALEQ20))
+    GDetector.dBScaleQ20 = VDEFAULTDBSCALEQ20;
+  if (GProtection.TripVSWR < VMINTRIPVSWR)
+    InitialiseProtection();
+  for (Cntr = 0; Cntr < VNUMSCALES; Cntr++)
+    if ((GPowerFullScale[Cntr] == 0) || (GPowerFullScale[Cntr] > VMAXFULLSCALE))
+      InitialiseFullScales();
+  if (GBallistics.DecayShift > VMAXBALLISTICSSHIFT)
+    GBallistics.DecayShift = VMAXBALLISTICSSHIFT;
+  if (GBallistics.EMAShift > VMAXBALLISTICSSHIFT)
+    GBallistics.EMAShift = VMAXBALLISTICSSHIFT;
+  if (GBallistics.AttackShift > VMAXBALLISTICSSHIFT)
+    GBallistics.AttackShift = VMAXBALLISTICSSHIFT;
+  if (GBallistics.ReleaseShift > VMAXBALLISTICSSHIFT)
+    GBallistics.ReleaseShift = VMAXBALLISTICSSHIFT;
+}
+
+
+
+//
+// settings image access
+// the image is the payload of the settings image record: the bytes that are stored
+//
+byte ConfigImageLength(void)
+{
+  return GRecordStates[eImageRecord].Length;
+}
+
+
+byte ConfigGetImageByte(byte Position)
+{
+  return GetPayloadByte(eImageRecord, Position);
+}
+
+
+void ConfigSetImageByte(byte Position, byte Value)
+{
+  if (Position < GRecordStates[eImageRecord].Length)
+  {
+    SetPayloadByte(eImageRecord, Position, Value);
+    MarkRecordDirty(eImageRecord);
+  }
+}
+
+
+
+//
+// config tick: call every 20ms tick
+// writes dirty records to EEPROM in the background, one changed byte per tick so the main loop
+// never waits for an EEPROM write to finish. Unchanged bytes are skipped, not rewritten.
+// if the settings change while a record is being written, the write is abandoned: the slot
+// is left invalid and is written again once the changes stop.
+//
+void ConfigTick(void)
+{
+  const RecordType* Type;
+  RecordState* State;
+  byte Record;
+  byte Value;
+  int Addr;
+
+  for (Record = 0; Record < VNUMRECORDS; Record++)
+    if (GRecordStates[Record].QuietTicks < VQUIETTICKS)
+      GRecordStates[Record].QuietTicks++;
+
+  if (GWriteRecord == VNOWRITE)
+  {
+    for (Record = 0; Record < VNUMRECORDS; Record++)
+    {
+      if (GRecordStates[Record].Dirty && (GRecordStates[Record].QuietTicks >= VQUIETTICKS))
+      {
+        StartRecordWrite(Record);
+        break;
+      }
+    }
+    return;
+  }
 
+  Type = &GRecordTypes[GWriteRecord];
+  State = &GRecordStates[GWriteRecord];
+  if (State->Dirty)
+  {
+    GWriteRecord = VNOWRITE;
+    return;
+  }
+  Addr = Type->Addr + State->NextSlot * Type->SlotSize;
+  while (GWritePosition < State->Length + VRECORDOVERHEAD)
+  {
+    Value = GetWriteByte(GWritePosition);
+    GWritePosition++;
+    if (EEPROM.read(Addr + GWritePosition - 1) != Value)
+    {
+      EEPROM.write(Addr + GWritePosition - 1, Value);
+      return;
+    }
+  }
 //
-// first see if we have initialised the EEprom previously
-// if not, copy settings to it
+// all written: this is now the newest slot
 //
-  Setting = EEPROM.read(0);
-  if (Setting != VEEINITPATTERN)
-    InitialiseEEprom();
+  State->Sequence = GWriteHeader[3];
+  State->NextSlot = (State->NextSlot + 1) % Type->NumSlots;
+  GWriteRecord = VNOWRITE;
+}
+
+
+
 //
-// now copy out settings to RAM data
+// true if there are settings not yet written to EEPROM
 //
-  GDisplayPageInUse = (byte)EEPROM.read(Addr++);
-  GDisplayScaleInUse = (byte)EEPROM.read(Addr++);
-  GPeakDisplayInUse = (bool)EEPROM.read(Addr++);
+bool ConfigWritePending(void)
+{
+  byte Record;
+
+  if (GWriteRecord != VNOWRITE)
+    return true;
+  for (Record = 0; Record < VNUMRECORDS; Record++)
+    if (GRecordStates[Record].Dirty)
+      return true;
+  return false;
 }
 
 
@@ -107,7 +661,7 @@ void LoadSettingsFromEEprom(void)
 void EEWritePage(byte Value)
 {
   GDisplayPageInUse = Value;
-  EEPROM.write(VPAGEADDR, Value);
+  MarkRecordDirty(eStateRecord);
 }
 
 
@@ -117,15 +671,81 @@ void EEWritePage(byte Value)
 void EEWriteScale(byte Value)
 {
   GDisplayScaleInUse = Value;
-  EEPROM.write(VSCALEADDR, Value);
+  MarkRecordDirty(eStateRecord);
+}
+
+
+//
+// function to write new meter mode
+//
+void EEWriteMeterMode(byte Value)
+{
+  GMeterModeInUse = Value;
+  MarkRecordDirty(eStateRecord);
+}
+
+
+//
+// function to write new ADC oversampling setting
+//
+void EEWriteOversample(bool Value)
+{
+  GOversampleInUse = Value;
+  MarkRecordDirty(eImageRecord);
+}
+
+
+//
+// function to write new calibration band
+//
+void EEWriteBand(byte Value)
+{
+  GBandInUse = Value;
+  MarkRecordDirty(eImageRecord);
+}
+
+
+//
+// function to write new display serial rate
+//
+void EEWriteDisplayBaud(byte Value)
+{
+  GDisplayBaudInUse = Value;
+  MarkRecordDirty(eImageRecord);
+}
+
+
+//
+// function to write the calibration sets
+//
+void EEWriteCalibrationSets(void)
+{
+  MarkRecordDirty(eImageRecord);
+}
+
+
+//
+// function to write the meter ballistics parameters
+//
+void EEWriteBallistics(void)
+{
+  MarkRecordDirty(eImageRecord);
+}
+
+
+//
+// function to write the VSWR protection settings
+//
+void EEWriteProtection(void)
+{
+  MarkRecordDirty(eImageRecord);
 }
 
 
 //
-// function to write new display average/peak
+// function to write the log detector response and display scales
 //
-void EEWritePeak(bool Value)
+void EEWriteDetector(void)
 {
-  GPeakDisplayInUse = Value;
-  EEPROM.write(VPEAKADDR, Value);
+  MarkRecordDirty(eImageRecord);
 }
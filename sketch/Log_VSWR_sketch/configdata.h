@@ -15,17 +15,107 @@
 #define __CONFIGDATA_H
 
 
+//
+// bands with their own calibration set
+//
+enum EBand
+{
+  e160m,
+  e80m,
+  e60m,
+  e40m,
+  e30m,
+  e20m,
+  e17m,
+  e15m,
+  e12m,
+  e10m,
+  e6m
+};
+#define VNUMBANDS 11
+
+
+//
+// calibration set for one band: the coupler coupling factor plus a correction curve
+// the correction is interpolated between points at ADC codes 0, 256, 512, 768 and 1024
+//
+#define VNUMCALPOINTS 5
+struct CalibrationSet
+{
+  int CouplingQ8;                                           // coupling in dB, units 1/256 dB
+  signed char Correction[VNUMCALPOINTS];                    // correction to add, units 1/16 dB
+};
+
+
+//
+// meter ballistics parameters
+// hold time in ticks (20ms); decay and time constants are shifts, giving 2^N ticks
+//
+#define VMAXBALLISTICSSHIFT 15                              // longest time constant shift
+struct BallisticsParams
+{
+  byte HoldTicks;                                           // PEP hold time
+  byte DecayShift;                                          // PEP decay time constant after hold
+  byte EMAShift;                                            // exponential moving average time constant
+  byte AttackShift;                                         // attack time constant (0 = instant)
+  byte ReleaseShift;                                        // release time constant
+};
+
+
+//
+// VSWR protection settings
+//
+#define VPROTECTENABLE 1                                    // Flags bit: protection enabled
+#define VPROTECTLATCH 2                                     // Flags bit: trip latches until reset
+struct ProtectionParams
+{
+  byte Flags;                                               // enable and latch bits
+  byte TripVSWR;                                            // trip threshold, tenths (30 = 3.0:1)
+  byte HysteresisVSWR;                                      // VSWR must fall this much below threshold to reset, tenths
+  signed char MinFwddBm;                                    // no trip below this forward power
+  byte ResetTicks;                                          // ticks (20ms) VSWR must be OK before auto reset
+};
+
+
+//
+// log detector response: the dBm at the detector is offset + scale x ADC code
+//
+struct DetectorParams
+{
+  unsigned long dBScaleQ20;                                 // dB per ADC code, units 1/2^20 dB
+  int dBmOffsetQ8;                                          // dBm at ADC code 0, units 1/256 dB
+};
+
+
+#define VNUMSCALES 4                                        // number of display power scales
+#define VDISPLAYBAUDUNKNOWN 0xFF                            // display serial rate not found yet
+
 
 //
 // RAM storage of loaded settings
-// these are loaded from EEprom after boot up
+// these are loaded from EEprom after boot up, and written back in the background when changed
 //
 extern byte GDisplayPageInUse;                              // display page to start at
 extern byte GDisplayScaleInUse;                             // display scale 0:2W   1: 20W   2: 200W   3: 2kW
-extern bool GPeakDisplayInUse;                              // true if we are displaying peak values
+extern byte GMeterModeInUse;                                // meter mode (EMeterMode): average, peak etc
+extern bool GOversampleInUse;                               // true if ADC oversampling selected
+extern byte GBandInUse;                                     // band for calibration
+extern byte GDisplayBaudInUse;                              // display serial rate index (displaylink.cpp)
+extern CalibrationSet GCalibrationSets[VNUMBANDS];          // calibration for each band
+extern BallisticsParams GBallistics;                        // meter ballistics in use
+extern ProtectionParams GProtection;                        // VSWR protection settings
+extern DetectorParams GDetector;                            // log detector response
+extern unsigned int GPowerFullScale[VNUMSCALES];            // full scale power of each display scale (W)
+
+//
+// add a byte to a CRC16 (CCITT polynomial 0x1021, start with 0xFFFF)
+//
+unsigned int CRC16Update(unsigned int CRC, byte Data);
+
 
 //
 // function to copy all config settings to EEprom
+// (they are written by ConfigTick())
 //
 void CopySettingsToEEprom(void);
 
@@ -35,6 +125,42 @@ void CopySettingsToEEprom(void);
 //
 void LoadSettingsFromEEprom(void);
 
+
+//
+// check settings that index tables are in range, and reset them if not
+//
+void ConfigCheckSettings(void);
+
+
+//
+// settings image access: the bytes of the settings image record (the fields in
+// GImageFields order, as stored). Changing a byte marks the record to be written;
+// call ConfigCheckSettings() and apply the settings after changing them.
+//
+byte ConfigImageLength(void);
+byte ConfigGetImageByte(byte Position);
+void ConfigSetImageByte(byte Position, byte Value);
+
+
+//
+// config tick: call every 20ms tick
+// writes changed settings to EEPROM in the background
+//
+void ConfigTick(void);
+
+
+//
+// true if there are settings not yet written to EEPROM
+//
+bool ConfigWritePending(void);
+
+
+//
+// functions to change settings
+// each sets the RAM value and marks it to be written to EEPROM once changes have stopped;
+// none of them wait for EEPROM
+//
+
 //
 // function to write new display page
 //
@@ -46,8 +172,44 @@ void EEWritePage(byte Value);
 void EEWriteScale(byte Value);
 
 //
-// function to write new display average/peak
+// function to write new meter mode
+//
+void EEWriteMeterMode(byte Value);
+
+//
+// function to write new ADC oversampling setting
+//
+void EEWriteOversample(bool Value);
+
+//
+// function to write new calibration band
+//
+void EEWriteBand(byte Value);
+
+//
+// function to write new display serial rate
+//
+void EEWriteDisplayBaud(byte Value);
+
+//
+// function to write the calibration sets
+// (all bands are in the one settings image record)
+//
+void EEWriteCalibrationSets(void);
+
+//
+// function to write the meter ballistics parameters
+//
+void EEWriteBallistics(void);
+
+//
+// function to write the VSWR protection settings
+//
+void EEWriteProtection(void);
+
+//
+// function to write the log detector response and display scales
 //
-void EEWritePeak(bool Value);
+void EEWriteDetector(void);
 
 #endif  //not defined
@@ -0,0 +1,903 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// console.cpp
+// this file holds the ASCII command console on the USB serial port
+//
+// commands are lines of words separated by spaces, ended by CR or LF.
+// a command with no values reads a setting; with values it sets it.
+// each reply line starts with the command name, so "scale 2" replies
+// "scale 2" and "scale" alone replies the same; errors start "ERR".
+// type "help" for the list.
+//
+// the port is shared with binary telemetry (telemetry.cpp). Input is split
+// by the receive state machine: console lines are 7 bit ASCII, and a byte with
+// the top bit set (every PC to bridge frame has one) makes the rest of the
+// input up to the next zero a binary frame. Output is shared by whole replies
+// and whole frames; while telemetry is on, each reply line ends with a zero
+// too, so a frame reader sees it as a (bad) frame and stays in step.
+//
+// everything is done a little at a time from loop(): at most
+// VCONSOLEBYTESPERPASS input bytes are read per pass, one command is
+// executed once its reply buffer is free, and long replies (image dump,
+// help) are built a line at a time as the last line is passed to the port.
+// a flood of input just waits in the serial receive buffer (or is dropped
+// by it), so it can never hold up AnalogueIOTick() or DisplayTick().
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "globalinclude.h"
+#include "console.h"
+#include "telemetry.h"
+#include "analogueio.h"
+#include "ballistics.h"
+#include "configdata.h"
+#include "display.h"
+#include "displaymodel.h"
+#include <Nextion.h>                        // for the display link statistics
+
+
+#define VCONSOLELINESIZE 48                 // longest command line
+#define VCONSOLEREPLYSIZE 120               // longest reply line, with CR, LF and zero
+#define VCONSOLEMAXWORDS 8                  // command and its values
+#define VIMAGEBYTESPERLINE 16               // settings image bytes per line of an image dump
+
+
+//
+// receive state: where we are in a line or frame
+//
+enum ERxState
+{
+  eRxLineStart,                             // nothing received since the last line or frame ended
+  eRxText,                                  // receiving a command line
+  eRxFrame,                                 // receiving a binary frame
+  eRxDiscard                                // too long: ignore up to the end of the line or frame
+};
+
+
+//
+// replies of more than one line
+//
+enum EMoreReply
+{
+  eMoreNone,
+  eMoreImage,                               // settings image dump
+  eMoreStats,                               // statistics
+  eMoreHelp                                 // command list
+};
+
+
+//
+// command table
+//
+typedef void (*ConsoleHandler)(byte NumValues, char** Values);
+struct ConsoleCommand
+{
+  const char* Name;
+  ConsoleHandler Handler;
+  const char* Help;                         // values it takes
+};
+
+
+char GLine[VCONSOLELINESIZE + 1];           // line (or frame) being received
+byte GLineLength;
+ERxState GRxState;
+bool GLineReady;                            // a complete line is waiting to be executed
+bool GLineTooLong;                          // ...but it was too long and has been discarded
+char GReply[VCONSOLEREPLYSIZE];             // reply line being sent
+byte GReplyLength;
+byte GReplyPosition;                        // bytes passed to the serial port
+EMoreReply GMoreReply;                      // multi line reply in progress
+byte GMoreIndex;                            // next line of it
+unsigned int GConsoleCommands;
+unsigned int GConsoleErrors;
+uint16_t GRxErrorBase;                      // display return error counts when stats were cleared
+uint16_t GRxFrameErrorBase;
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// reply builder
+// a reply line is built in GReply, then passed to the serial port by ConsoleService().
+// text that doesn't fit is dropped, always leaving room for the line ending.
+//
+
+//
+// start a reply line
+//
+void ReplyBegin(void)
+{
+  GReplyLength = 0;
+  GReplyPosition = 0;
+}
+
+
+void ReplyChar(char Ch)
+{
+  if(GReplyLength < VCONSOLEREPLYSIZE - 3)
+    GReply[GReplyLength++] = Ch;
+}
+
+
+void ReplyText(const char* Text)
+{
+  while(*Text)
+    ReplyChar(*Text++);
+}
+
+
+//
+// add a number, with a given number of decimal places (value 123, 1 decimal gives "12.3")
+//
+void ReplyNumber(long Value, byte Decimals = 0)
+{
+  char Digits[12];
+  byte Count = 0;
+  unsigned long Magnitude;
+
+  if(Value < 0)
+  {
+    ReplyChar('-');
+    Magnitude = -(unsigned long)Value;
+  }
+  else
+    Magnitude = Value;
+  do
+  {
+    Digits[Count++] = '0' + (Magnitude % 10);
+    Magnitude /= 10;
+  } while((Magnitude != 0) || (Count <= Decimals));
+  while(Count != 0)
+  {
+    if(Count-- == Decimals)
+      ReplyChar('.');
+    ReplyChar(Digits[Count]);
+  }
+}
+
+
+//
+// add a space then a named value
+//
+void ReplyValue(const char* Name, long Value, byte Decimals = 0)
+{
+  ReplyChar(' ');
+  ReplyText(Name);
+  ReplyChar(' ');
+  ReplyNumber(Value, Decimals);
+}
+
+
+void ReplyHex(byte Value)
+{
+  const char* HexDigits = "0123456789ABCDEF";
+
+  ReplyChar(HexDigits[Value >> 4]);
+  ReplyChar(HexDigits[Value & 0x0F]);
+}
+
+
+//
+// end the line; it is sent from ConsoleService()
+//
+void ReplyEnd(void)
+{
+  GReply[GReplyLength++] = '\r';
+  GReply[GReplyLength++] = '\n';
+  if(TelemetryGetRate() != 0)
+    GReply[GReplyLength++] = 0;
+}
+
+
+//
+// a complete error reply
+//
+void ReplyError(const char* Message)
+{
+  GConsoleErrors++;
+  ReplyBegin();
+  ReplyText("ERR ");
+  ReplyText(Message);
+  ReplyEnd();
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// value parsing
+//
+
+//
+// read a decimal number, with an optional sign; the whole word must be a number
+// returns true if it is, and in range
+//
+bool ParseNumber(const char* Word, long Min, long Max, long* Value)
+{
+  bool Negative = false;
+  long Result = 0;
+
+  if(*Word == '-')
+  {
+    Negative = true;
+    Word++;
+  }
+  if(*Word == 0)
+    return false;
+  while(*Word)
+  {
+    if((*Word < '0') || (*Word > '9') || (Result > 100000L))
+      return false;
+    Result = Result * 10 + (*Word++ - '0');
+  }
+  if(Negative)
+    Result = -Result;
+  if((Result < Min) || (Result > Max))
+    return false;
+  *Value = Result;
+  return true;
+}
+
+
+//
+// read all the values of a command into an array, each in the same range
+// returns false (and sends an error reply) if any is bad
+//
+bool ParseValues(byte NumValues, char** Values, long Min, long Max, long* Results)
+{
+  byte Cntr;
+
+  for(Cntr = 0; Cntr < NumValues; Cntr++)
+  {
+    if(!ParseNumber(Values[Cntr], Min, Max, Results + Cntr))
+    {
+      ReplyError("bad value");
+      return false;
+    }
+  }
+  return true;
+}
+
+
+//
+// read one hex digit; returns 0xFF if not a hex digit
+//
+byte HexValue(char Ch)
+{
+  if((Ch >= '0') && (Ch <= '9'))
+    return Ch - '0';
+  if((Ch >= 'a') && (Ch <= 'f'))
+    return Ch - 'a' + 10;
+  return 0xFF;                              // (words are lower case by now)
+}
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// command handlers
+// each is given the values after the command word, and builds its reply
+//
+
+//
+// ver: product and version
+//
+void VersionCommand(byte NumValues, char** Values)
+{
+  ReplyBegin();
+  ReplyText("ver");
+  ReplyValue("product", PRODUCTID);
+  ReplyValue("sw", SWVERSION);
+  ReplyValue("hw", HWVERSION);
+  ReplyEnd();
+}
+
+
+//
+// read: the latest readings. dBm and watts to 0.1, VSWR to 0.1
+//
+void ReadCommand(byte NumValues, char** Values)
+{
+  ReplyBegin();
+  ReplyText("read");
+  ReplyValue("fwddbm", GForwardTenthdBm, 1);
+  ReplyValue("revdbm", GReverseTenthdBm, 1);
+  ReplyValue("fwdavg", GetPowerReading(true, true), 1);
+  ReplyValue("fwdpk", FindPeakPower(true, true), 1);
+  ReplyValue("revavg", GetPowerReading(false, true), 1);
+  ReplyValue("revpk", FindPeakPower(false, true), 1);
+  ReplyValue("meter", GetMeterPower(true, true), 1);
+  ReplyValue("vswr", GVSWR, 1);
+  ReplyValue("trip", GTripped);
+  ReplyEnd();
+}
+
+
+//
+// scale [n]: display scale
+//
+void ScaleCommand(byte NumValues, char** Values)
+{
+  long Value;
+
+  if(NumValues != 0)
+  {
+    if(!ParseValues(1, Values, 0, VNUMSCALES - 1, &Value))
+      return;
+    DisplaySetScale((byte)Value);
+  }
+  ReplyBegin();
+  ReplyText("scale ");
+  ReplyNumber(GDisplayScaleInUse);
+  ReplyValue("fullscale", GPowerFullScale[GDisplayScaleInUse]);
+  ReplyEnd();
+}
+
+
+//
+// page [n]: display page
+//
+void PageCommand(byte NumValues, char** Values)
+{
+  long Value;
+
+  if(NumValues != 0)
+  {
+    if(!ParseValues(1, Values, 1, VMAXPAGE, &Value))
+      return;
+    if(!DisplaySetPage((byte)Value))
+    {
+      ReplyError("busy");
+      return;
+    }
+  }
+  ReplyBegin();
+  ReplyText("page ");
+  ReplyNumber(GDisplayPageInUse);
+  ReplyEnd();
+}
+
+
+//
+// mode [n]: meter mode (average, peak, PEP hold, EMA, SSB)
+//
+void ModeCommand(byte NumValues, char** Values)
+{
+  long Value;
+
+  if(NumValues != 0)
+  {
+    if(!ParseValues(1, Values, 0, VNUMMETERMODES - 1, &Value))
+      return;
+    DisplaySetMeterMode((byte)Value);
+  }
+  ReplyBegin();
+  ReplyText("mode ");
+  ReplyNumber(GMeterModeInUse);
+  ReplyChar(' ');
+  ReplyText(GMeterModeNames[GMeterModeInUse]);
+  ReplyEnd();
+}
+
+
+//
+// ball [hold decay ema attack release] or ball preset n: meter ballistics
+// hold is in ticks; the others are shifts (time constant 2^n ticks)
+//
+void BallisticsCommand(byte NumValues, char** Values)
+{
+  long Settings[5];
+
+  if((NumValues == 2) && (strcmp(Values[0], "preset") == 0))
+  {
+    if(!ParseValues(1, Values + 1, 0, VNUMBALLISTICSPRESETS - 1, Settings))
+      return;
+    BallisticsLoadPreset((byte)Settings[0]);
+    EEWriteBallistics();
+  }
+  else if(NumValues == 5)
+  {
+    if(!ParseValues(1, Values, 0, 255, Settings) || !ParseValues(4, Values + 1, 0, VMAXBALLISTICSSHIFT, Settings + 1))
+      return;
+    GBallistics.HoldTicks = Settings[0];
+    GBallistics.DecayShift = Settings[1];
+    GBallistics.EMAShift = Settings[2];
+    GBallistics.AttackShift = Settings[3];
+    GBallistics.ReleaseShift = Settings[4];
+    EEWriteBallistics();
+  }
+  else if(NumValues != 0)
+  {
+    ReplyError("bad value");
+    return;
+  }
+  ReplyBegin();
+  ReplyText("ball");
+  ReplyValue("hold", GBallistics.HoldTicks);
+  ReplyValue("decay", GBallistics.DecayShift);
+  ReplyValue("ema", GBallistics.EMAShift);
+  ReplyValue("attack", GBallistics.AttackShift);
+  ReplyValue("release", GBallistics.ReleaseShift);
+  ReplyEnd();
+}
+
+
+//
+// band [n]: calibration band in use
+//
+void BandCommand(byte NumValues, char** Values)
+{
+  long Value;
+
+  if(NumValues != 0)
+  {
+    if(!ParseValues(1, Values, 0, VNUMBANDS - 1, &Value))
+      return;
+    EEWriteBand((byte)Value);
+    AnalogueIOSelectBand(GBandInUse);
+  }
+  ReplyBegin();
+  ReplyText("band ");
+  ReplyNumber(GBandInUse);
+  ReplyEnd();
+}
+
+
+//
+// cal band [coupling c0 c1 c2 c3 c4]: calibration set for a band
+// coupling in 1/256 dB; corrections in 1/16 dB at ADC codes 0, 256, 512, 768, 1024
+//
+void CalibrationCommand(byte NumValues, char** Values)
+{
+  long Band;
+  long Settings[1 + VNUMCALPOINTS];
+  CalibrationSet* Set;
+  byte Cntr;
+
+  if((NumValues != 1) && (NumValues != 2 + VNUMCALPOINTS))
+  {
+    ReplyError("bad value");
+    return;
+  }
+  if(!ParseValues(1, Values, 0, VNUMBANDS - 1, &Band))
+    return;
+  Set = &GCalibrationSets[Band];
+  if(NumValues != 1)
+  {
+    if(!ParseValues(1, Values + 1, -32768L, 32767L, Settings)
+       || !ParseValues(VNUMCALPOINTS, Values + 2, -128, 127, Settings + 1))
+      return;
+    Set->CouplingQ8 = Settings[0];
+    for(Cntr = 0; Cntr < VNUMCALPOINTS; Cntr++)
+      Set->Correction[Cntr] = Settings[Cntr + 1];
+    EEWriteCalibrationSets();
+    if(Band == GBandInUse)
+      AnalogueIOSelectBand(GBandInUse);                 // protection thresholds depend on coupling
+  }
+  ReplyBegin();
+  ReplyText("cal ");
+  ReplyNumber(Band);
+  ReplyValue("coupling", Set->CouplingQ8);
+  ReplyText(" corr");
+  for(Cntr = 0; Cntr < VNUMCALPOINTS; Cntr++)
+  {
+    ReplyChar(' ');
+    ReplyNumber(Set->Correction[Cntr]);
+  }
+  ReplyEnd();
+}
+
+
+//
+// one line of an image dump: "image <offset> <hex bytes>"
+//
+void ReplyImageLine(byte Offset, byte Count)
+{
+  ReplyBegin();
+  ReplyText("image ");
+  ReplyNumber(Offset);
+  ReplyChar(' ');
+  while(Count-- != 0)
+    ReplyHex(ConfigGetImageByte(Offset++));
+  ReplyEnd();
+}
+
+
+//
+// image: dump the settings image, as lines that can be sent back to write it
+// image offset hex: write bytes of the settings image, then apply them
+//
+void ImageCommand(byte NumValues, char** Values)
+{
+  long Offset;
+  char* Hex;
+  byte Count;
+  byte Cntr;
+  byte High, Low;
+
+  if(NumValues == 0)
+  {
+    ReplyBegin();
+    ReplyText("image");
+    ReplyValue("length", ConfigImageLength());
+    ReplyEnd();
+    GMoreReply = eMoreImage;
+    GMoreIndex = 0;
+    return;
+  }
+  if(NumValues != 2)
+  {
+    ReplyError("bad value");
+    return;
+  }
+  if(!ParseValues(1, Values, 0, ConfigImageLength() - 1, &Offset))
+    return;
+//
+// check all the hex first, so a bad line changes nothing
+//
+  Hex = Values[1];
+  Count = strlen(Hex) / 2;
+  if((Count * 2 != strlen(Hex)) || (Count == 0) || (Offset + Count > ConfigImageLength()))
+  {
+    ReplyError("bad value");
+    return;
+  }
+  for(Cntr = 0; Cntr < Count * 2; Cntr++)
+  {
+    if(HexValue(Hex[Cntr]) == 0xFF)
+    {
+      ReplyError("bad value");
+      return;
+    }
+  }
+  for(Cntr = 0; Cntr < Count; Cntr++)
+  {
+    High = HexValue(Hex[Cntr * 2]);
+    Low = HexValue(Hex[Cntr * 2 + 1]);
+    ConfigSetImageByte(Offset + Cntr, (High << 4) | Low);
+  }
+//
+// apply the new settings
+//
+  ConfigCheckSettings();
+  AnalogueIOSetOversampling(GOversampleInUse);
+  AnalogueIOSetCalibration();
+  AnalogueIOSelectBand(GBandInUse);
+  ReplyImageLine(Offset, Count);
+}
+
+
+//
+// stats [clear]: statistics since power up or the last clear
+//
+void StatsCommand(byte NumValues, char** Values)
+{
+  byte SavedSREG;
+
+  if((NumValues == 1) && (strcmp(Values[0], "clear") == 0))
+  {
+    GSamplesProcessed = 0;
+    GSamplesLost = 0;
+    GBlocksTorn = 0;
+    SavedSREG = SREG;
+    cli();
+    GTripCount = 0;                               // counted by the ADC interrupt
+    SREG = SavedSREG;
+    nexTxHighWater = 0;
+    nexTxRejectCount = 0;
+    GRxErrorBase = nexRxErrorCount;                 // these are used by the display link manager
+    GRxFrameErrorBase = nexRxFrameErrorCount;
+    GTelemetryFramesSent = 0;
+    GTelemetryFramesSkipped = 0;
+    GConsoleCommands = 0;
+    GConsoleErrors = 0;
+  }
+  else if(NumValues != 0)
+  {
+    ReplyError("bad value");
+    return;
+  }
+  GMoreReply = eMoreStats;
+  GMoreIndex = 0;
+}
+
+
+//
+// rate [n]: telemetry frames per second (0 = off)
+//
+void RateCommand(byte NumValues, char** Values)
+{
+  long Value;
+
+  if(NumValues != 0)
+  {
+    if(!ParseValues(1, Values, 0, VTELEMETRYMAXRATE, &Value))
+      return;
+    TelemetrySetRate((unsigned int)Value);
+  }
+  ReplyBegin();
+  ReplyText("rate ");
+  ReplyNumber(TelemetryGetRate());
+  ReplyEnd();
+}
+
+
+void HelpCommand(byte NumValues, char** Values)
+{
+  GMoreReply = eMoreHelp;
+  GMoreIndex = 0;
+}
+
+
+#define VNUMCOMMANDS 13
+const ConsoleCommand GCommands[VNUMCOMMANDS] =
+{
+  {"ver", VersionCommand, ""},
+  {"read", ReadCommand, ""},
+  {"scale", ScaleCommand, "[0-3]"},
+  {"page", PageCommand, "[page]"},
+  {"mode", ModeCommand, "[0-4: average peak pep ema ssb]"},
+  {"ball", BallisticsCommand, "[hold decay ema attack release | preset 0-2]"},
+  {"band", BandCommand, "[0-10]"},
+  {"cal", CalibrationCommand, "band [coupling c0 c1 c2 c3 c4]"},
+  {"image", ImageCommand, "[offset hexbytes]"},
+  {"stats", StatsCommand, "[clear]"},
+  {"rate", RateCommand, "[0-500]"},
+  {"help", HelpCommand, ""},
+  {"?", HelpCommand, ""}
+};
+
+
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+// multi line replies: build the next line, once the last has been sent
+//
+void ContinueReply(void)
+{
+  byte Count;
+  byte SavedSREG;
+  unsigned int Trips;
+
+  switch(GMoreReply)
+  {
+    case eMoreImage:
+      Count = ConfigImageLength() - GMoreIndex;
+      if(Count > VIMAGEBYTESPERLINE)
+        Count = VIMAGEBYTESPERLINE;
+      ReplyImageLine(GMoreIndex, Count);
+      GMoreIndex += Count;
+      if(GMoreIndex >= ConfigImageLength())
+        GMoreReply = eMoreNone;
+      break;
+
+    case eMoreStats:
+      ReplyBegin();
+      ReplyText("stats");
+      if(GMoreIndex == 0)
+      {
+        ReplyValue("samples", GSamplesProcessed);
+        ReplyValue("lost", GSamplesLost);
+        ReplyValue("torn", GBlocksTorn);
+        SavedSREG = SREG;
+        cli();
+        Trips = GTripCount;                             // counted by the ADC interrupt
+        SREG = SavedSREG;
+        ReplyValue("trips", Trips);
+      }
+      else if(GMoreIndex == 1)
+      {
+        ReplyValue("displaybytes", GDisplayBytesPerSecond);
+        ReplyValue("queuehigh", nexTxHighWater);
+        ReplyValue("rejected", nexTxRejectCount);
+        ReplyValue("rxerrors", (uint16_t)(nexRxErrorCount - GRxErrorBase));
+        ReplyValue("frameerrors", (uint16_t)(nexRxFrameErrorCount - GRxFrameErrorBase));
+      }
+      else
+      {
+        ReplyValue("framessent", GTelemetryFramesSent);
+        ReplyValue("framesskipped", GTelemetryFramesSkipped);
+        ReplyValue("commands", GConsoleCommands);
+        ReplyValue("errors", GConsoleErrors);
+        GMoreReply = eMoreNone;
+      }
+      ReplyEnd();
+      GMoreIndex++;
+      break;
+
+    case eMoreHelp:
+      ReplyBegin();
+      ReplyText(GCommands[GMoreIndex].Name);
+      ReplyChar(' ');
+      ReplyText(GCommands[GMoreIndex].Help);
+      ReplyEnd();
+      if(++GMoreIndex >= VNUMCOMMANDS - 1)              // not "?"
+        GMoreReply = eMoreNone;
+      break;
+
+    default:
+      GMoreReply = eMoreNone;
+      break;
+  }
+}
+
+
+//
+// execute a complete command line
+// split it into words in place, in lower case, then look up the command
+//
+void ExecuteLine(void)
+{
+  char* Words[VCONSOLEMAXWORDS];
+  byte NumWords = 0;
+  char* Ch;
+  byte Cntr;
+
+  if(GLineTooLong)
+  {
+    ReplyError("line too long");
+    return;
+  }
+  Ch = GLine;
+  while(*Ch)
+  {
+    while((*Ch == ' ') || (*Ch == '\t'))
+      *Ch++ = 0;
+    if(*Ch == 0)
+      break;
+    if(NumWords == VCONSOLEMAXWORDS)
+    {
+      ReplyError("too many values");
+      return;
+    }
+    Words[NumWords++] = Ch;
+    while(*Ch && (*Ch != ' ') && (*Ch != '\t'))
+    {
+      if((*Ch >= 'A') && (*Ch <= 'Z'))
+        *Ch += 'a' - 'A';
+      Ch++;
+    }
+  }
+  if(NumWords == 0)
+    return;
+
+  for(Cntr = 0; Cntr < VNUMCOMMANDS; Cntr++)
+  {
+    if(strcmp(Words[0], GCommands[Cntr].Name) == 0)
+    {
+      GConsoleCommands++;
+      GCommands[Cntr].Handler(NumWords - 1, Words + 1);
+      return;
+    }
+  }
+  ReplyError("unknown command");
+}
+
+
+//
+// add a received byte to the line or frame being received
+//
+void StoreByte(byte Ch)
+{
+  if(GLineLength < VCONSOLELINESIZE)
+    GLine[GLineLength++] = Ch;
+  else
+    GRxState = eRxDiscard;
+}
+
+
+//
+// receive state machine: one byte
+//
+void ReceiveByte(byte Ch)
+{
+  if(Ch == 0)                                       // end of a frame
+  {
+    if((GRxState == eRxFrame) || (GRxState == eRxText))
+      TelemetryHandleFrame((byte*)GLine, GLineLength);
+    GRxState = eRxLineStart;
+    GLineLength = 0;
+    return;
+  }
+
+  switch(GRxState)
+  {
+    case eRxDiscard:
+      if((Ch == '\r') || (Ch == '\n'))
+      {
+        GLineTooLong = true;
+        GLineReady = true;
+        GRxState = eRxLineStart;
+      }
+      break;
+
+    case eRxFrame:
+      StoreByte(Ch);
+      break;
+
+    default:                                        // line start or text
+      if((Ch == '\r') || (Ch == '\n'))
+      {
+        if(GRxState == eRxText)
+        {
+          GLine[GLineLength] = 0;
+          GLineTooLong = false;
+          GLineReady = true;
+        }
+        GRxState = eRxLineStart;
+      }
+      else if((Ch == 8) || (Ch == 0x7F))            // backspace
+      {
+        if(GLineLength != 0)
+          GLineLength--;
+      }
+      else
+      {
+        GRxState = (Ch & 0x80) ? eRxFrame : eRxText;
+        StoreByte(Ch);
+      }
+      break;
+  }
+}
+
+
+//
+// console service
+// input stops being read while a line waits to be executed, so it is never overwritten
+//
+void ConsoleService(void)
+{
+  byte Count;
+  int Space;
+
+  Count = 0;
+  while(!GLineReady && (Count < VCONSOLEBYTESPERPASS) && (Serial.available() > 0))
+  {
+    ReceiveByte((byte)Serial.read());
+    Count++;
+  }
+
+  if(!ConsoleTxBusy())
+  {
+    if(GMoreReply != eMoreNone)
+      ContinueReply();
+    else if(GLineReady)
+    {
+      ExecuteLine();
+      GLineReady = false;
+      GLineLength = 0;
+    }
+  }
+
+//
+// send as much of the reply as fits without waiting; but not in the middle of a telemetry frame
+//
+  if(ConsoleTxBusy() && !TelemetryTxBusy())
+  {
+    Space = Serial.availableForWrite();
+    Count = GReplyLength - GReplyPosition;
+    if(Count > Space)
+      Count = Space;
+    if(Count > 0)
+    {
+      Serial.write((const uint8_t*)GReply + GReplyPosition, Count);
+      GReplyPosition += Count;
+    }
+  }
+}
+
+
+//
+// true if a reply is part sent
+//
+bool ConsoleTxBusy(void)
+{
+  return (GReplyPosition < GReplyLength);
+}
@@ -0,0 +1,45 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// console.h
+// this file holds the ASCII command console on the USB serial port
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __CONSOLE_H
+#define __CONSOLE_H
+
+#include <Arduino.h>
+
+
+#define VCONSOLEBYTESPERPASS 8                          // most input bytes read in one pass of loop()
+
+
+//
+// console statistics
+//
+extern unsigned int GConsoleCommands;                   // commands executed
+extern unsigned int GConsoleErrors;                     // lines rejected
+
+
+//
+// console service: call on every pass of loop()
+// reads a few bytes of input, executes a command once a whole line has arrived, and passes
+// as much of the reply as fits into the serial transmit buffer. Never waits for the serial port.
+// binary frames (from a telemetry reader) are passed to TelemetryHandleFrame().
+//
+void ConsoleService(void);
+
+
+//
+// true if a reply is part sent: nothing else may be sent until it is finished
+//
+bool ConsoleTxBusy(void);
+
+
+#endif      // file sentry
@@ -0,0 +1,189 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// crossedneedle.cpp
+// this file holds the crossed needle end point tables and builds the
+// commands that erase and draw the needles
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "crossedneedle.h"
+#include <NexHardware.h>                    // for the command builder
+
+
+//
+// crossed needle end points, in pixels, for each integer angle from VMINNEEDLEANGLE to 90 degrees.
+// these replace the float sin() and cos() calls that were made for every redraw.
+// they were generated from the old float calculation, so they give the same pixels:
+//   X = X1 +/- VNEEDLESIZE * cos(Angle); Y = VXNEEDLEY1 - VNEEDLESIZE * sin(Angle); then truncated to int
+// the needles start at (VXNEEDLEREVX1, VXNEEDLEY1) and (VXNEEDLEFWDX1, VXNEEDLEY1)
+// if the needle geometry changes, these need to be regenerated: host/needle_harness checks them
+//
+const unsigned int GRevNeedleX[VNUMNEEDLEANGLES] =
+{
+  263, 262, 261, 259, 258, 257, 256, 254, 253, 251, 250, 248, 247,      // 13-25 degrees
+  245, 243, 241, 239, 237, 235, 233, 231, 228, 226, 224, 221, 219,      // 26-38 degrees
+  216, 214, 211, 208, 206, 203, 200, 197, 194, 191, 188, 185, 182,      // 39-51 degrees
+  179, 175, 172, 169, 165, 162, 159, 155, 152, 148, 144, 141, 137,      // 52-64 degrees
+  133, 130, 126, 122, 118, 115, 111, 107, 103,  99,  95,  91,  87,      // 65-77 degrees
+   83,  79,  75,  71,  67,  63,  59,  55,  51,  47,  43,  39,  34       // 78-90 degrees
+};
+
+const unsigned int GFwdNeedleX[VNUMNEEDLEANGLES] =
+{
+   14,  15,  16,  18,  19,  20,  21,  23,  24,  26,  27,  29,  30,      // 13-25 degrees
+   32,  34,  36,  38,  40,  42,  44,  46,  49,  51,  53,  56,  58,      // 26-38 degrees
+   61,  63,  66,  69,  71,  74,  77,  80,  83,  86,  89,  92,  95,      // 39-51 degrees
+   98, 102, 105, 108, 112, 115, 118, 122, 126, 129, 133, 136, 140,      // 52-64 degrees
+  144, 147, 151, 155, 159, 162, 166, 170, 174, 178, 182, 186, 190,      // 65-77 degrees
+  194, 198, 202, 206, 210, 214, 218, 222, 226, 230, 234, 238, 243       // 78-90 degrees
+};
+
+const unsigned int GNeedleY[VNUMNEEDLEANGLES] =
+{
+  186, 182, 178, 174, 170, 166, 162, 158, 155, 151, 147, 143, 140,      // 13-25 degrees
+  136, 132, 129, 125, 122, 118, 114, 111, 108, 104, 101,  98,  94,      // 26-38 degrees
+   91,  88,  85,  82,  79,  76,  73,  70,  67,  65,  62,  59,  57,      // 39-51 degrees
+   54,  52,  49,  47,  45,  42,  40,  38,  36,  34,  32,  30,  28,      // 52-64 degrees
+   26,  25,  23,  22,  20,  19,  17,  16,  15,  14,  12,  11,  10,      // 65-77 degrees
+   10,   9,   8,   7,   7,   6,   6,   5,   5,   5,   5,   5,   5       // 78-90 degrees
+};
+
+
+//
+// send a crossed needle line command: "line X1,Y1,X2,Y2,BLUE"
+// the caller checks there is space in the display transmit queue
+//
+void SendLineCommand(int X1, int Y1, int X2, int Y2)
+{
+  NexCmdBuilder Cmd;
+
+  if(nexCmdBegin(&Cmd, VNEEDLECMDLENGTH))
+  {
+    nexCmdText(&Cmd, "line ");
+    nexCmdInt(&Cmd, X1);
+    nexCmdChar(&Cmd, ',');
+    nexCmdInt(&Cmd, Y1);
+    nexCmdChar(&Cmd, ',');
+    nexCmdInt(&Cmd, X2);
+    nexCmdChar(&Cmd, ',');
+    nexCmdInt(&Cmd, Y2);
+    nexCmdText(&Cmd, ",BLUE");
+    nexCmdEnd(&Cmd);
+  }
+}
+
+
+//
+// find the end points of a crossed needle line at an integer angle
+// the end point comes from the tables, so no trig is needed
+//
+void GetCrossedNeedleEnds(bool IsForward, int Degrees, int* X1, int* Y1, int* X2, int* Y2)
+{
+  byte Index;
+
+  if(Degrees < VMINNEEDLEANGLE)
+    Degrees = VMINNEEDLEANGLE;
+  else if(Degrees >= VMINNEEDLEANGLE + VNUMNEEDLEANGLES)
+    Degrees = VMINNEEDLEANGLE + VNUMNEEDLEANGLES - 1;
+  Index = Degrees - VMINNEEDLEANGLE;
+
+  *Y1 = VXNEEDLEY1;
+  *Y2 = GNeedleY[Index];
+  if(IsForward)
+  {
+    *X1 = VXNEEDLEFWDX1;
+    *X2 = GFwdNeedleX[Index];
+  }
+  else
+  {
+    *X1 = VXNEEDLEREVX1;
+    *X2 = GRevNeedleX[Index];
+  }
+}
+
+
+//
+// draw one crossed needle line at an integer angle
+//
+void DrawCrossedNeedle(bool IsForward, int Degrees)
+{
+  int X1, Y1, X2, Y2;
+
+  GetCrossedNeedleEnds(IsForward, Degrees, &X1, &Y1, &X2, &Y2);
+  SendLineCommand(X1, Y1, X2, Y2);
+}
+
+
+//
+// erase one crossed needle line by copying the background picture back over it.
+// the line's own bounding box can be most of the page, so the line is split into
+// segments and only each segment's box (plus a pixel each side) is copied, with picq.
+// a near vertical or horizontal line only needs one segment.
+// Picture is the page's background picture.
+//
+void EraseCrossedNeedle(bool IsForward, int Degrees, byte Picture)
+{
+  int X1, Y1, X2, Y2;
+  int XA, YA, XB, YB;
+  int Left, Top, Right, Bottom;
+  int DX, DY;
+  byte Segments, Cntr;
+  NexCmdBuilder Cmd;
+
+  GetCrossedNeedleEnds(IsForward, Degrees, &X1, &Y1, &X2, &Y2);
+  DX = X2 - X1;
+  DY = Y2 - Y1;
+  Segments = min(abs(DX), abs(DY)) / VERASESEGMENTSIZE + 1;
+  if(Segments > VMAXERASESEGMENTS)
+    Segments = VMAXERASESEGMENTS;
+
+  for(Cntr = 0; Cntr < Segments; Cntr++)
+  {
+    XA = X1 + DX * Cntr / Segments;
+    YA = Y1 + DY * Cntr / Segments;
+    XB = X1 + DX * (Cntr + 1) / Segments;
+    YB = Y1 + DY * (Cntr + 1) / Segments;
+    Left = max(min(XA, XB) - 1, 0);
+    Right = min(max(XA, XB) + 1, VDISPLAYWIDTH - 1);
+    Top = max(min(YA, YB) - 1, 0);
+    Bottom = min(max(YA, YB) + 1, VDISPLAYHEIGHT - 1);
+    if(nexCmdBegin(&Cmd, VNEEDLECMDLENGTH))
+    {
+      nexCmdText(&Cmd, "picq ");                      // picq x,y,w,h,picture
+      nexCmdInt(&Cmd, Left);
+      nexCmdChar(&Cmd, ',');
+      nexCmdInt(&Cmd, Top);
+      nexCmdChar(&Cmd, ',');
+      nexCmdInt(&Cmd, Right - Left + 1);
+      nexCmdChar(&Cmd, ',');
+      nexCmdInt(&Cmd, Bottom - Top + 1);
+      nexCmdChar(&Cmd, ',');
+      nexCmdInt(&Cmd, Picture);
+      nexCmdEnd(&Cmd);
+    }
+  }
+}
+
+
+//
+// send one crossed needle frame: erase the old line of each needle that has moved,
+// then draw both needles (erasing one can take a few pixels out of the other where
+// they cross). An old angle below 0 means that needle isn't drawn yet.
+// the caller checks there are VNEEDLEFRAMESPACE bytes free in the display transmit queue
+//
+void SendCrossedNeedleFrame(int Forward, int Reverse, int OldForward, int OldReverse, byte Picture)
+{
+  if((Forward != OldForward) && (OldForward >= 0))
+    EraseCrossedNeedle(true, OldForward, Picture);
+  if((Reverse != OldReverse) && (OldReverse >= 0))
+    EraseCrossedNeedle(false, OldReverse, Picture);
+  DrawCrossedNeedle(false, Reverse);
+  DrawCrossedNeedle(true, Forward);
+}
@@ -0,0 +1,61 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// crossedneedle.h
+// crossed needle geometry, and the functions that erase and draw the needles
+// (host/needle_harness checks the tables and measures the frames)
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __CROSSEDNEEDLE_H
+#define __CROSSEDNEEDLE_H
+
+#include <Arduino.h>
+
+#define VNEEDLESIZE 234.0                     // needle length (px)
+#define VXNEEDLEY1 239                        // y start position (px)
+#define VXNEEDLEFWDX1 243                     // X needle start position (px)
+#define VXNEEDLEREVX1 35                     // X needle start position (px)
+#define VMINNEEDLEANGLE 13                    // lowest integer needle angle: (int)VMINXNEEDLEANGLE
+#define VNUMNEEDLEANGLES 78                   // angles from 13 to 90 degrees
+#define VNEEDLECMDLENGTH 26                   // longest needle line or erase command
+#define VERASESEGMENTSIZE 32                  // (px) needle erase: 1 segment per this much of the shorter side
+#define VMAXERASESEGMENTS 3                   // most segments to erase a needle in
+#define VNEEDLEFRAMESPACE ((2 * VMAXERASESEGMENTS + 2) * (VNEEDLECMDLENGTH + 3))     // queue space for a frame
+#define VDISPLAYWIDTH 320                     // (px)
+#define VDISPLAYHEIGHT 240
+
+
+//
+// crossed needle end points, in pixels, for each integer angle from VMINNEEDLEANGLE to 90 degrees
+// (in crossedneedle.cpp)
+//
+extern const unsigned int GRevNeedleX[VNUMNEEDLEANGLES];
+extern const unsigned int GFwdNeedleX[VNUMNEEDLEANGLES];
+extern const unsigned int GNeedleY[VNUMNEEDLEANGLES];
+
+
+//
+// draw one crossed needle line at an integer angle
+//
+void DrawCrossedNeedle(bool IsForward, int Degrees);
+
+
+//
+// erase one crossed needle line, copying back the background picture
+//
+void EraseCrossedNeedle(bool IsForward, int Degrees, byte Picture);
+
+
+//
+// send one crossed needle frame: erase the needles that have moved and draw both
+// needs VNEEDLEFRAMESPACE bytes free in the display transmit queue
+//
+void SendCrossedNeedleFrame(int Forward, int Reverse, int OldForward, int OldReverse, byte Picture);
+
+#endif //not defined
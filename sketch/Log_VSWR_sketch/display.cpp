@@ -18,22 +18,20 @@
 #include "globalinclude.h"
 #include "analogueio.h"
 #include "configdata.h"
+#include "ballistics.h"
+#include "displaymodel.h"
+#include "displaylink.h"
+#include "trend.h"
 #include "iopins.h"
+#include "crossedneedle.h"
 #include <Nextion.h>                        // uses the Nextion class library
 
 
 //
-// display full scale values for power graphs
-// done this way it is easy to add more!
+// display full scale values for power graphs are GPowerFullScale[], a setting in configdata
+// the pictures below must match them
 //
-#define VMAXSCALESETTING 3
-const unsigned int GPowerFullScale[VMAXSCALESETTING + 1]=
-{
-  2,
-  20,
-  200, 
-  2000
-};
+#define VMAXSCALESETTING (VNUMSCALES - 1)
 
 
 //
@@ -94,29 +92,30 @@ const unsigned int GCrossedNeedlePicture[VMAXSCALESETTING + 1] =
 #define VLOGBARMIN -350.0F                    // units tenths of dB
 #define VLOGBARMAX 650.0F
 #define VVSWRFULLSCALE 10.0F                  // full scale VSWR indication
-#define VOVERSCALEDISPLAYTICKS 5             // duration to display an overscale for (units currently 100ms)
+#define VOVERSCALEDISPLAYTICKS 25            // duration to display an overscale for (20ms ticks)
 
 //
 // paramters for crossed needle display
 //
-#define VNEEDLESIZE 234.0
 #define VMINXNEEDLEANGLE 13.5F                // angle for 0W
 #define VMAXXNEEDLEANGLE 73.0F                // angle for full scale power
-#define VXNEEDLEY1 239                        // y start position (px)
-#define VXNEEDLEFWDX1 243                     // X needle start position (px)
-#define VXNEEDLEREVX1 35                     // X needle start position (px)
+
+#define VMAXCMDLENGTH 30                      // longest command built by SendNumberCommand() or SendPeakButton()
 
 
 EDisplayPage GDisplayPage;                    // global set to current display page number
 int GSplashCountdown;                         // counter for splash page
-byte GUpdateItem;                             // display item being updated
 byte GCrossedNeedleItem;                      // display item in crossed needle page
 int GDisplayedForward, GDisplayedReverse;     // displayed meter angle values, to find if needle has moved
 int GReqdAngleForward, GReqdAngleReverse;     // required angles for crossed needle
 byte GForwardOverscale, GReverseOverscale;    // set non zero if an overscale detected. =no. ticks to display for
 bool GInitialisePage;                         // true if page needs to be initialised
-bool GCrossedNeedleRedrawing;                 // true if display is being redrawn
+#ifdef VTRENDPAGE
+bool GLeaveTrendPage;                         // true if the display button pressed during a trend transfer
+#endif
 unsigned char GUpdateMeterTicks;              // number of ticks since a meter display updated
+byte GHoldMeterMode;                          // meter mode selected by peak button "on"
+EDisplayPage GModelPage;                      // page the display model values were sent to
 
 //
 // declare pages:
@@ -127,6 +126,9 @@ NexPage page2 = NexPage(2, 0, "page2");       // creates touch event for "power
 NexPage page3 = NexPage(3, 0, "page3");       // creates touch event for "dBm bargraph" page
 NexPage page4 = NexPage(4, 0, "page4");       // creates touch event for "analogue meter" page
 NexPage page5 = NexPage(5, 0, "page5");       // creates touch event for "engineering" page
+#ifdef VTRENDPAGE
+NexPage page6 = NexPage(6, 0, "page6");       // creates touch event for "trend" page
+#endif
 
 //
 // page 0 objects:
@@ -185,7 +187,13 @@ NexText p5RevPeak = NexText(5, 15, "p5t13");                    // reverse peak
 NexText p5VSWR = NexText(5, 17, "p5t15");                       // VSWR
 NexButton p5DisplayBtn = NexButton(5, 1, "p5b0");                 // Display pushbutton
 
-#define VMAXENGITEM 9                         // number of text items on engineering display
+#ifdef VTRENDPAGE
+//
+// declare objects on "trend" page
+// the p6s0 waveform is only written with commands, so it has no object
+//
+NexButton p6DisplayBtn = NexButton(6, 1, "p6b0");                 // Display pushbutton
+#endif
 
 
 //
@@ -205,6 +213,9 @@ NexTouch *nex_listen_list[] =
   &p3DisplayBtn,                              // display button pressed
   &p4DisplayBtn,                              // display button pressed
   &p5DisplayBtn,                              // display button pressed
+#ifdef VTRENDPAGE
+  &p6DisplayBtn,                              // display button pressed
+#endif
   NULL                                        // terminates the list
 };
 
@@ -214,7 +225,7 @@ NexTouch *nex_listen_list[] =
 // convert from power value to degree angle for the cross needle meter
 // return integer angle from 13.5 to 90
 //
-int GetCrossedNeedleDegrees(bool IsForward, bool IsPeak)
+int GetCrossedNeedleDegrees(bool IsForward)
 {
   float FullScale;
   unsigned int Power;
@@ -224,10 +235,7 @@ int GetCrossedNeedleDegrees(bool IsForward, bool IsPeak)
   if(!IsForward)
     FullScale *= 0.2;                                     // reverse scale = a fifth of forward
 
-  if(IsPeak)
-    Power = FindPeakPower(IsForward, true);               // get power in units of 0.1 watts
-  else
-    Power = GetPowerReading(IsForward, true);
+  Power = GetMeterPower(IsForward, true);                // get power in units of 0.1 watts
 
 //
 // calculate angle. Not full scale ~73 degrees but we allow up to 90 degrees
@@ -252,17 +260,14 @@ int GetCrossedNeedleDegrees(bool IsForward, bool IsPeak)
 // convert from power value to degree angle for meter
 // return 0 to 180
 //
-int GetPowerMeterDegrees(bool IsForward, bool IsPeak)
+int GetPowerMeterDegrees(bool IsForward)
 {
   int FullScale;
   unsigned int Power;
   float Degrees;
   
   FullScale = GPowerFullScale[GDisplayScaleInUse];
-  if(IsPeak)
-    Power = FindPeakPower(IsForward, true);            // get power in units of 0.1 watts
-  else
-    Power = GetPowerReading(IsForward, true);
+  Power = GetMeterPower(IsForward, true);             // get power in units of 0.1 watts
 
   Degrees = 18.0 * (float)Power / (float)FullScale;
   if (Degrees > 180.0)                                    // now clip, and set overscale if needed
@@ -282,17 +287,14 @@ int GetPowerMeterDegrees(bool IsForward, bool IsPeak)
 // convert from power value to % of full scale
 // return 0 to 100
 //
-int GetPowerPercent(bool IsForward, bool IsPeak)
+int GetPowerPercent(bool IsForward)
 {
   int FullScale;
   unsigned int Power;
   float Percent;
   
   FullScale = GPowerFullScale[GDisplayScaleInUse];
-  if(IsPeak)
-    Power = FindPeakPower(IsForward, true);            // get power in units of 0.1 watts
-  else
-    Power = GetPowerReading(IsForward, true);
+  Power = GetMeterPower(IsForward, true);             // get power in units of 0.1 watts
 
   Percent = 10.0 * (float)Power / (float)FullScale;
   if (Percent > 100.0)                                    // now clip, and set overscale if needed
@@ -355,90 +357,126 @@ int GetLogPowerPercent(bool IsForward)
 }
 
 
-#define VASCII0 0x30                // zero character in ASCII
 //
-// local version of "sprintf like" function
-// Adds a decimal point before last digit if 3rd parameter set
-// note integer value is signed and may be negative!
+// get the current value of a display item, for the display model
+// these are the numbers sent: percent, degrees, watts or tenths
 //
-unsigned char mysprintf(char *dest, int Value, bool AddDP)
+int GetDisplayItemValue(EDisplayItem Item)
 {
-  unsigned char Digit;              // calculated digit
-  bool HadADigit = false;           // true when found a non zero digit
-  unsigned char DigitCount = 0;     // number of returned digits
-  unsigned int Divisor = 10000;     // power of 10 being calculated
-//
-// deal with negative values first
-//
-  if (Value < 0)
-  {
-    *dest++ = '-';    // add to output
-    DigitCount++;
-    Value = -Value;
-  }
-//
-// now convert the (definitely posirive) number
-//
-  while (Divisor >= 10)
+  int Value = 0;
+
+  switch(Item)
   {
-    Digit = Value / Divisor;        // find digit: integer divide
-    if (Digit != 0)
-      HadADigit = true;             // flag if non zero so all trailing digits added
-    if (HadADigit)                  // if 1st non zero or all subsequent
-    {
-      *dest++ = Digit + VASCII0;    // add to output
-      DigitCount++;
-    }
-    Value -= (Digit * Divisor);     // get remainder from divide
-    Divisor = Divisor / 10;         // ready for next digit
+    case eItemP2FwdBar:
+      Value = GetPowerPercent(true);
+      break;
+    case eItemP2VSWRBar:
+    case eItemP4VSWRBar:
+      Value = GetVSWRPercent();
+      break;
+    case eItemP2FwdPower:
+      Value = GetMeterPower(true, false);                   // forward power, in watts
+      break;
+    case eItemP2VSWRTxt:
+    case eItemP5VSWR:
+      Value = GVSWR;
+      break;
+    case eItemP2Overrange:                                  // counted down by DisplayTick()
+      if(GForwardOverscale != 0)
+        Value = 1;
+      break;
+    case eItemP3FwdBar:
+      Value = GetLogPowerPercent(true);
+      break;
+    case eItemP3RevBar:
+      Value = GetLogPowerPercent(false);
+      break;
+    case eItemP3FwddBm:
+    case eItemP5FwddBm:
+      Value = GForwardTenthdBm;
+      break;
+    case eItemP3RevdBm:
+    case eItemP5RevdBm:
+      Value = GReverseTenthdBm;
+      break;
+    case eItemP4Meter:
+      Value = GetPowerMeterDegrees(true);
+      break;
+    case eItemP5FwdVolts:
+      Value = GFwdLineVoltageTenth;
+      break;
+    case eItemP5RevVolts:
+      Value = GRevLineVoltageTenth;
+      break;
+    case eItemP5FwdPower:
+      Value = GetPowerReading(true, false);
+      break;
+    case eItemP5RevPower:
+      Value = GetPowerReading(false, false);
+      break;
+    case eItemP5FwdPeak:
+      Value = FindPeakPower(true, false);
+      break;
+    case eItemP5RevPeak:
+      Value = FindPeakPower(false, false);
+      break;
+    default:
+      break;
   }
+  return Value;
+}
+
+
 //
-// if we need a decimal point, add it now. Also if there hasn't been a preceiding digit
-// (i.e. number was like 0.3) add the zero
+// send a command to set a numeric attribute, eg "p2j0.ppic=8"
+// the command is built directly in the display transmit queue; waits if it is full
 //
-  if (AddDP)
-  {
-    if (HadADigit == false)
-    {
-      *dest++ = '0';
-      DigitCount++;
-    }
-    *dest++ = '.';
-  DigitCount++;
-  }
-  *dest++ = Value + VASCII0;
-  DigitCount++;
+void SendNumberCommand(const char* Attribute, int Value)
+{
+  NexCmdBuilder Cmd;
+
+  nexCmdBegin(&Cmd, VMAXCMDLENGTH, true);
+  nexCmdText(&Cmd, Attribute);
+  nexCmdInt(&Cmd, Value);
+  nexCmdEnd(&Cmd);
+}
+
+
 //
-// finally terminate with a 0
+// show a meter mode on a peak/normal button: "p1bt0.val=1" then "p1bt0.txt="Peak""
+// queued like SendNumberCommand(): nothing waits for the display to acknowledge
 //
-  *dest++ = 0;
-  return DigitCount;
+void SendPeakButton(const char* Button, byte Mode)
+{
+  NexCmdBuilder Cmd;
+
+  nexCmdBegin(&Cmd, VMAXCMDLENGTH, true);
+  nexCmdText(&Cmd, Button);
+  nexCmdText(&Cmd, ".val=");
+  nexCmdInt(&Cmd, Mode != eMeterAverage);
+  nexCmdEnd(&Cmd);
+  nexCmdBegin(&Cmd, VMAXCMDLENGTH, true);
+  nexCmdText(&Cmd, Button);
+  nexCmdText(&Cmd, ".txt=\"");
+  nexCmdText(&Cmd, GMeterModeNames[Mode]);
+  nexCmdChar(&Cmd, '"');
+  nexCmdEnd(&Cmd);
 }
 
 
-
 //
 // set foreground and background of bargraphs to set power scale
 //
 void SetBargraphImages(void)
 {
   byte Image;
-  char Str[20];
-  char Str2[5];
 
-  Str2[0]=0;                                            // empty the string
   if(GDisplayPageInUse == 2)
   {
     Image = GPowerForeground[GDisplayScaleInUse];       // foreground image number
-    mysprintf(Str2, Image, false);
-    strcpy(Str,"p2j0.ppic=");
-    strcat(Str, Str2);
-    sendCommand(Str);
+    SendNumberCommand("p2j0.ppic=", Image);
     Image = GPowerBackground[GDisplayScaleInUse];       // background image number
-    mysprintf(Str2, Image, false);
-    strcpy(Str,"p2j0.bpic=");
-    strcat(Str, Str2);
-    sendCommand(Str);
+    SendNumberCommand("p2j0.bpic=", Image);
   }
 }
 
@@ -449,17 +487,11 @@ void SetBargraphImages(void)
 void SetMeterImages(void)
 {
   byte Image;
-  char Str[20];
-  char Str2[5];
 
-  Str2[0]=0;                                            // empty the string
   if(GDisplayPageInUse == 4)
   {
     Image = GMeterPicture[GDisplayScaleInUse];       // foreground image number
-    mysprintf(Str2, Image, false);
-    strcpy(Str,"p4z0.picc=");
-    strcat(Str, Str2);
-    sendCommand(Str);
+    SendNumberCommand("p4z0.picc=", Image);
   }
 }
 
@@ -474,7 +506,7 @@ void SetCrossedNeedleImages(void)
   if(GDisplayPageInUse == 1)
   {
     Image = GCrossedNeedlePicture[GDisplayScaleInUse];       // foreground image number
-    p1Axes.setPic(Image);
+    SendNumberCommand("p1p0.pic=", Image);
   }
 }
 
@@ -538,25 +570,85 @@ void p4DisplayBtnPushCallback(void *ptr)
 
 //
 // page 5 display button callback
-// enter page 1
+// enter page 1 (page 6 if the trend page is included)
 //
 void p5DisplayBtnPushCallback(void *ptr)
 {
+#ifdef VTRENDPAGE
+  GDisplayPage = eTrendPage;
+  page6.show();
+  EEWritePage(6);
+#else
   GDisplayPage = eCrossedNeedlePage;
   page1.show();
   EEWritePage(1);
+#endif
   GInitialisePage = true;
 }
 
 
+//
+// go to a display page (1 to VMAXPAGE) without a button press
+// during the splash page the page is only stored: the splash page ends by going to it.
+// returns false if the page can't be changed now (a trend waveform transfer is going)
+//
+bool DisplaySetPage(byte Page)
+{
+#ifdef VTRENDPAGE
+  if((GDisplayPage == eTrendPage) && TrendTransferBusy())
+    return false;
+#endif
+  EEWritePage(Page);
+  if(GDisplayPage == eSplashPage)
+    return true;
+  GDisplayPage = (EDisplayPage)Page;
+  SendNumberCommand("page ", Page);                 // queued: called from the console, so don't wait for the ack
+  GInitialisePage = true;
+  return true;
+}
+
+
+#ifdef VTRENDPAGE
+//
+// page 6 display button callback
+// enter page 1; if a waveform transfer is in progress the display would take the page
+// command as data, so wait until it has finished
+//
+void p6DisplayBtnPushCallback(void *ptr)
+{
+  if(TrendTransferBusy())
+  {
+    GLeaveTrendPage = true;
+    return;
+  }
+  GLeaveTrendPage = false;
+  GDisplayPage = eCrossedNeedlePage;
+  page1.show();
+  EEWritePage(1);
+  GInitialisePage = true;
+}
+#endif
+
+
 //
 // touch event - SCALE pushbutton
 // change the stored display scale
 //
 void ScaleBtnPushCallback(void *ptr)              // display scale pushbutton
 {
-  if(GDisplayScaleInUse++ >= VMAXSCALESETTING)      // increment or wrap
-    GDisplayScaleInUse = 0;
+  if(GDisplayScaleInUse >= VMAXSCALESETTING)        // increment or wrap
+    DisplaySetScale(0);
+  else
+    DisplaySetScale(GDisplayScaleInUse + 1);
+}
+
+
+//
+// set a new display scale
+//
+void DisplaySetScale(byte Scale)
+{
+  GDisplayScaleInUse = Scale;
   EEWriteScale(GDisplayScaleInUse);                 // store to EEPROM so we start with the same
 
 //
@@ -575,46 +667,63 @@ void ScaleBtnPushCallback(void *ptr)              // display scale pushbutton
 
 
 //
-// touch event - peak/normal button
+// set the meter mode from a peak/normal button state
+// button off selects average; on selects the last used non-average mode
 //
-void P1PeakBtnPushCallback(void *ptr)             // peak/normal display button
+void SelectMeterMode(const char* Button, uint32_t State)
 {
-  uint32_t State;
-
-  p1PeakBtn.getValue(&State);
   if(State == 0)
-  {
-    p1PeakBtn.setText("Average");
-    GPeakDisplayInUse = false;
-  }
+    GMeterModeInUse = eMeterAverage;
   else
-  {
-    p1PeakBtn.setText("Peak");
-    GPeakDisplayInUse = true;
-  }
-  EEWritePeak(GPeakDisplayInUse);                 // store to EEPROM so we start with the same
+    GMeterModeInUse = GHoldMeterMode;
+  SendPeakButton(Button, GMeterModeInUse);
+  EEWriteMeterMode(GMeterModeInUse);              // store to EEPROM so we start with the same
+}
+
+
+//
+// peak/normal button state has been read back from the display
+// ptr points to the button's object name
+//
+void PeakBtnStateCallback(void *ptr, bool Ok, uint32_t State)
+{
+  if(Ok)
+    SelectMeterMode((const char*)ptr, State);
+}
+
+
+//
+// set a new meter mode, and show it on the peak/normal button if the page has one
+//
+void DisplaySetMeterMode(byte Mode)
+{
+  GMeterModeInUse = Mode;
+  EEWriteMeterMode(GMeterModeInUse);
+  if(GDisplayPage == eCrossedNeedlePage)
+    SendPeakButton("p1bt0", Mode);
+  else if(GDisplayPage == ePowerBargraphPage)
+    SendPeakButton("p2bt1", Mode);
+  else if(GDisplayPage == eMeterPage)
+    SendPeakButton("p4bt1", Mode);
 }
 
 
 //
 // touch event - peak/normal button
+// the new button state is read without waiting: PeakBtnStateCallback gets the result
 //
-void P2PeakBtnPushCallback(void *ptr)             // peak/normal display button
+void P1PeakBtnPushCallback(void *ptr)             // peak/normal display button
 {
-  uint32_t State;
+  nexGetNumberAsync("p1bt0.val", PeakBtnStateCallback, (void*)"p1bt0");
+}
 
-  p2PeakBtn.getValue(&State);
-  if(State == 0)
-  {
-    p2PeakBtn.setText("Average");
-    GPeakDisplayInUse = false;
-  }
-  else
-  {
-    p2PeakBtn.setText("Peak");
-    GPeakDisplayInUse = true;
-  }
-  EEWritePeak(GPeakDisplayInUse);                 // store to EEPROM so we start with the same
+
+//
+// touch event - peak/normal button
+//
+void P2PeakBtnPushCallback(void *ptr)             // peak/normal display button
+{
+  nexGetNumberAsync("p2bt1.val", PeakBtnStateCallback, (void*)"p2bt1");
 }
 
 
@@ -624,24 +733,29 @@ void P2PeakBtnPushCallback(void *ptr)             // peak/normal display button
 //
 void P4PeakBtnPushCallback(void *ptr)             // peak/normal display button
 {
-  uint32_t State;
-
-  p4PeakBtn.getValue(&State);
-  if(State == 0)
-  {
-    p4PeakBtn.setText("Average");
-    GPeakDisplayInUse = false;
-  }
-  else
-  {
-    p4PeakBtn.setText("Peak");
-    GPeakDisplayInUse = true;
-  }
-  EEWritePeak(GPeakDisplayInUse);                 // store to EEPROM so we start with the same
+  nexGetNumberAsync("p4bt1.val", PeakBtnStateCallback, (void*)"p4bt1");
 }
 
 
 
+//
+// show the splash page for 5 seconds, with the software version;
+// the splash page then goes to the page stored in eeprom
+//
+void DisplayStartSplash(void)
+{
+  NexCmdBuilder Cmd;
+
+  GDisplayPage = eSplashPage;
+  nexCmdBegin(&Cmd, VMAXCMDLENGTH, true);          // software version text
+  nexCmdText(&Cmd, "p0t4.txt=\"");
+  nexCmdInt(&Cmd, SWVERSION);
+  nexCmdChar(&Cmd, '"');
+  nexCmdEnd(&Cmd);
+  GSplashCountdown = VFIVESECONDS;                  // ticks to stay in splash page
+}
+
+
 //
 // display initialise
 //
@@ -658,11 +772,12 @@ void P4PeakBtnPushCallback(void *ptr)             // peak/normal display button
 
 void DisplayInit(void)
 {
-  char Str[10];
+  long Baud;
 //
-// set baud rate & register event callback functions
+// find the display and set the fastest baud rate that works, then register event callback functions
 //  
-  nexInit(115200);
+  Baud = DisplayLinkInit();
+  nexInit(Baud);
   p1ScaleBtn.attachPush(ScaleBtnPushCallback);
   p2ScaleBtn.attachPush(ScaleBtnPushCallback);
   p1PeakBtn.attachPush(P1PeakBtnPushCallback);
@@ -674,12 +789,22 @@ void DisplayInit(void)
   p3DisplayBtn.attachPush(p3DisplayBtnPushCallback);
   p4DisplayBtn.attachPush(p4DisplayBtnPushCallback);
   p5DisplayBtn.attachPush(p5DisplayBtnPushCallback);
-  GDisplayPage = eSplashPage;
+#ifdef VTRENDPAGE
+  p6DisplayBtn.attachPush(p6DisplayBtnPushCallback);
+#endif
+  DisplayStartSplash();
+  GHoldMeterMode = eMeterPeak;
+  DisplayModelInit(Baud);
+}
 
-  mysprintf(Str, SWVERSION, false);
-  p0SWVersion.setText(Str);
-  GSplashCountdown = VFIVESECONDS;                  // ticks to stay in splash page
-  GUpdateItem = 0;
+
+//
+// display fast tick, called from the 1ms timer interrupt
+// passes queued display commands to the serial port
+//
+void DisplayFastTick(void)
+{
+  nexTxService();
 }
 
 
@@ -689,18 +814,33 @@ void DisplayInit(void)
 //
 void DisplayTick(void)
 {
-  char Str[30];
-  char Str2[10];
-  int X1, Y1, X2, Y2;
   int Forward, Reverse;
-  float X,Y;
-  float Angle;
   unsigned long T1;
+  ELinkEvent LinkEvent;
 //
 // handle touch display events
 //
   nexLoop(nex_listen_list);
-  Str2[0] = 0;                                      //empty the string
+  LinkEvent = DisplayLinkTick();
+  if(LinkEvent != eLinkNoChange)                    // serial rate changed: redraw everything
+  {
+    DisplayModelInit(DisplayLinkGetBaud());
+    GInitialisePage = true;
+    if(LinkEvent == eLinkFound)                     // display has just started: begin again from its splash page
+      DisplayStartSplash();
+  }
+  DisplayModelTick();
+  if(GDisplayPage != GModelPage)                    // new page: every item needs to be sent
+  {
+    GModelPage = GDisplayPage;
+    DisplayModelInvalidate();
+  }
+  if(GMeterModeInUse != eMeterAverage)              // remember mode for the peak button
+    GHoldMeterMode = GMeterModeInUse;
+  if(GForwardOverscale != 0)                        // overscale shown until this runs out
+    GForwardOverscale--;
+  if(GReverseOverscale != 0)
+    GReverseOverscale--;
 //
 // display dependent processing
 //
@@ -710,6 +850,15 @@ void DisplayTick(void)
       if(GSplashCountdown-- <= 0)
       {
         sendCommand("bkcmd=1");                   // re-send in case it has been forgotten
+#ifdef VTRENDPAGE
+        if(GDisplayPageInUse == 6)                  // choose the operating page from eeprom stored value
+        {
+          page6.show();
+          GDisplayPage = eTrendPage;
+          GInitialisePage = true;
+        }
+        else
+#endif
         if(GDisplayPageInUse == 5)                  // choose the operating page from eeprom stored value
         {
           page5.show();
@@ -751,97 +900,33 @@ void DisplayTick(void)
       {
         SetCrossedNeedleImages();                     // get correct display scales
         GInitialisePage = false;
-        GDisplayedForward = -100;                     // set illegal display angles
+        GDisplayedForward = -100;                     // set illegal display angles: nothing to erase
         GDisplayedReverse = -100;
-        GCrossedNeedleRedrawing = false;
       }
-      else
-      {
 //
-// first see what the angles should be, and if they are different from what's drawn.
-// we only trest this is we are NOT already redrawing the display.
-// redraw once a second even if no change
+// if the angles have changed, erase the old needle(s) and draw both new ones in this tick.
+// (erasing one needle can take a few pixels out of the other where they cross).
+// if nothing has changed for 5 seconds, repaint the whole background as a safety net.
+// wait if the display queue hasn't got room for a whole frame.
 //
-        if(!GCrossedNeedleRedrawing)
+      else if(nexTxFree() >= VNEEDLEFRAMESPACE)
+      {
+        Forward = GetCrossedNeedleDegrees(true);
+        Reverse = GetCrossedNeedleDegrees(false);
+        if(GUpdateMeterTicks >= VFIVESECONDS)
         {
-          Forward = GetCrossedNeedleDegrees(true, GPeakDisplayInUse);
-          Reverse = GetCrossedNeedleDegrees(false, GPeakDisplayInUse);
-          if((Forward != GDisplayedForward) || (Reverse != GDisplayedReverse) || (GUpdateMeterTicks >= 50))
-          {
-            GCrossedNeedleRedrawing = true;           // if changed, set need to redraw display and required angles
-            GDisplayedForward = Forward;
-            GDisplayedReverse = Reverse;
-            GUpdateItem = 0;                          // set to do 1st stage
-          }
+          sendCommand("ref 1");
+          GDisplayedForward = -100;
+          GDisplayedReverse = -100;
         }
-
-//
-// then if we need to update display, get on and drawe it in sections
-//
-        if(GCrossedNeedleRedrawing)
+        if((Forward != GDisplayedForward) || (Reverse != GDisplayedReverse))
         {
           GUpdateMeterTicks = 0;
-          switch(GUpdateItem++)
-          {
-            case 0:                                     // erase image
-              sendCommand("ref 1");
-              break;
-  
-            case 1:                                     // draw reverse power line
-              X1 = VXNEEDLEREVX1;
-              Y1 = VXNEEDLEY1;
-              Angle = (float)GDisplayedReverse * M_PI / 180.0;
-              X = X1 + VNEEDLESIZE * cos(Angle);
-              X2 = (int)X;
-              Y = Y1 - VNEEDLESIZE * sin(Angle);
-              Y2 = (int)Y;
-// get text commands
-              strcpy(Str, "line ");             // line
-              mysprintf(Str2, X1, false);
-              strcat(Str, Str2);
-              strcat(Str, ",");                 // line X1,
-              mysprintf(Str2, Y1, false);
-              strcat(Str, Str2);
-              strcat(Str, ",");                 // line X1,Y1,
-              mysprintf(Str2, X2, false);
-              strcat(Str, Str2);
-              strcat(Str, ",");                 // line X1,Y1,X2
-              mysprintf(Str2, Y2, false);
-              strcat(Str, Str2);
-              strcat(Str, ",BLUE");             // line X1,Y1,X2,Y2,BLUE
-              sendCommand(Str);
-              break;
-
-            case 2:                                     // draw forward power line
-              X1 = VXNEEDLEFWDX1;
-              Y1 = VXNEEDLEY1;
-              Angle = (float)GDisplayedForward * M_PI / 180.0;
-              X = X1 - VNEEDLESIZE * cos(Angle);
-              X2 = (int)X;
-              Y = Y1 - VNEEDLESIZE * sin(Angle);
-              Y2 = (int)Y;
-// get text commands
-              strcpy(Str, "line ");             // line
-              mysprintf(Str2, X1, false);
-              strcat(Str, Str2);
-              strcat(Str, ",");                 // line X1,
-              mysprintf(Str2, Y1, false);
-              strcat(Str, Str2);
-              strcat(Str, ",");                 // line X1,Y1,
-              mysprintf(Str2, X2, false);
-              strcat(Str, Str2);
-              strcat(Str, ",");                 // line X1,Y1,X2
-              mysprintf(Str2, Y2, false);
-              strcat(Str, Str2);
-              strcat(Str, ",BLUE");             // line X1,Y1,X2,Y2,BLUE
-              sendCommand(Str);
-              break;
-              
-            case 6:                                     // end of dwell after redraw
-              GCrossedNeedleRedrawing = false;
-              break;
-          }
-        }   // switch
+          SendCrossedNeedleFrame(Forward, Reverse, GDisplayedForward, GDisplayedReverse,
+                                 GCrossedNeedlePicture[GDisplayScaleInUse]);
+          GDisplayedForward = Forward;
+          GDisplayedReverse = Reverse;
+        }
       }
       break;      // end of crossed needle
 
@@ -851,85 +936,20 @@ void DisplayTick(void)
     case  ePowerBargraphPage:                            // power bargraph page display
       if(GInitialisePage)
       {
-        if(GPeakDisplayInUse)
-        {
-          p2PeakBtn.setValue(1);
-          p2PeakBtn.setText("Peak");
-        }
+        if(GMeterModeInUse != eMeterAverage)
+          SendPeakButton("p2bt1", GMeterModeInUse);
         SetBargraphImages();                            // get correct display scales
         GInitialisePage = false;
       }
       else
-        switch(GUpdateItem)
-        {
-          case 0:
-            Forward = GetPowerPercent(true, GPeakDisplayInUse);
-            p2FwdBar.setValue(Forward);
-            break;
-  
-          case 4:
-            Forward = GetVSWRPercent();
-            p2VSWRBar.setValue(Forward);
-            break;
-  
-          case 8:
-            if(GPeakDisplayInUse)
-              Forward = FindPeakPower(true, false);                 // get forward peak power, in watts
-            else
-              Forward = GetPowerReading(true, false);               // get forward power, in watts
-            mysprintf(Str, Forward, false);
-            p2FwdPower.setText(Str);
-  
-            mysprintf(Str, GVSWR, true);
-            p2VSWRTxt.setText(Str);
-            break;
-  
-          case 9:
-            if(GForwardOverscale != 0)
-            {
-              p2Overrange.setValue(1);
-              GForwardOverscale--;
-            }
-            else
-              p2Overrange.setValue(0);
-            break;
-        }          
-      if (GUpdateItem++ >= 9)
-        GUpdateItem = 0;
+        DisplayModelUpdate(GDisplayPage);
       break;
 
 
 ///////////////////////////////////////////////////
 
     case  eLogBargraphPage:                              // dBm bargraph page display
-      switch(GUpdateItem)
-      {
-        case 0:
-          Forward = GetLogPowerPercent(true);
-          p3FwddBmBar.setValue(Forward);
-          break;
-
-        case 4:
-          Reverse = GetLogPowerPercent(false);
-          p3RevdBmBar.setValue(Reverse);
-          break;
-
-        case 8:
-          mysprintf(Str, GForwardTenthdBm, true);
-          p3FwddBm.setText(Str);
-          break;
-
-        case 9:
-          mysprintf(Str, GReverseTenthdBm, true);
-          p3RevdBm.setText(Str);
-          break;
-          
-        default:
-          break;
-      }
-      if (GUpdateItem++ >= 9)
-        GUpdateItem = 0;
-
+      DisplayModelUpdate(GDisplayPage);
       GInitialisePage = true;
       break;
 
@@ -939,81 +959,38 @@ void DisplayTick(void)
     case  eMeterPage:                            // power meter page display
       if(GInitialisePage)
       {
-        if(GPeakDisplayInUse)
-        {
-          p4PeakBtn.setValue(1);
-          p4PeakBtn.setText("Peak");
-        }
+        if(GMeterModeInUse != eMeterAverage)
+          SendPeakButton("p4bt1", GMeterModeInUse);
         SetMeterImages();                            // get correct display scales
         GInitialisePage = false;
       }
       else
-        switch(GUpdateItem)
-        {
-          case 0:
-            Forward = GetPowerMeterDegrees(true, GPeakDisplayInUse);
-            p4Meter.setValue(Forward);
-            break;
-  
-          case 10:
-            Forward = GetVSWRPercent();
-            p4VSWRBar.setValue(Forward);
-            break;
-  
-        }          
-      if (GUpdateItem++ >= 14)
-        GUpdateItem = 0;
+        DisplayModelUpdate(GDisplayPage);
       break;
 
 
 ///////////////////////////////////////////////////
 
     case  eEngineeringPage:                         // engineering page with raw ADC values
-      switch(GUpdateItem)
+      DisplayModelUpdate(GDisplayPage);
+      GInitialisePage = false;
+      break;
+
+
+///////////////////////////////////////////////////
+
+#ifdef VTRENDPAGE
+    case  eTrendPage:                               // power and VSWR trend
+      if(GInitialisePage)
       {
-        case 0:
-          mysprintf(Str, GFwdLineVoltageTenth, true);
-          p5FwdVolts.setText(Str);
-          break;        
-        case 1:
-          mysprintf(Str, GRevLineVoltageTenth, true);
-          p5RevVolts.setText(Str);
-          break;        
-        case 2:
-          mysprintf(Str, GForwardTenthdBm, true);
-          p5FwddBm.setText(Str);
-          break;        
-        case 3:
-          mysprintf(Str, GReverseTenthdBm, true);
-          p5RevdBm.setText(Str);
-          break;        
-        case 4:
-          mysprintf(Str, GetPowerReading(true, false), false);
-          p5FwdPower.setText(Str);
-          break;        
-        case 5:
-          mysprintf(Str, GetPowerReading(false, false), false);
-          p5RevPower.setText(Str);
-          break;        
-        case 6:
-          Forward = FindPeakPower(true, false);
-          mysprintf(Str, Forward, false);
-          p5FwdPeak.setText(Str);
-          break;        
-        case 7:
-          Reverse = FindPeakPower(false, false);
-          mysprintf(Str, Reverse, false);
-          p5RevPeak.setText(Str);
-          break;        
-        case 8:
-          mysprintf(Str, GVSWR, true);
-          p5VSWR.setText(Str);
-          break;        
+        TrendPageInit();
+        GInitialisePage = false;
       }
-//      if (GUpdateItem++ >= VMAXENGITEM)
-        GUpdateItem = 0;
-
-      GInitialisePage = false;
+      else
+        TrendPageTick();
+      if(GLeaveTrendPage && !TrendTransferBusy())   // display button pressed during a transfer
+        p6DisplayBtnPushCallback(NULL);
       break;
+#endif
   }
 }
@@ -16,6 +16,7 @@
 #define __DISPLAY_H
 
 #include <Arduino.h>
+#include "globalinclude.h"
 
 
 //
@@ -28,8 +29,16 @@ enum EDisplayPage
   ePowerBargraphPage,                       // linear watts bargraph page display
   eLogBargraphPage,                         // dBm bargraph page display
   eMeterPage,                               // analogue power meter
-  eEngineeringPage                          // engineering page with raw ADC values
+  eEngineeringPage,                         // engineering page with raw ADC values
+#ifdef VTRENDPAGE
+  eTrendPage                                // power and VSWR trend
+#endif
 };
+#ifdef VTRENDPAGE
+#define VMAXPAGE 6                          // highest operating page
+#else
+#define VMAXPAGE 5
+#endif
 
 
 
@@ -39,12 +48,27 @@ enum EDisplayPage
 void DisplayInit(void);
 
 
+//
+// display fast tick, called from the 1ms timer interrupt
+//
+void DisplayFastTick(void);
+
+
 //
 // display tick
 //
 void DisplayTick(void);
 
 
+//
+// change settings shown by the display, as the touch buttons do (used by the console)
+// the page is 1 to VMAXPAGE; DisplaySetPage returns false if it can't change page now
+//
+bool DisplaySetPage(byte Page);
+void DisplaySetScale(byte Scale);
+void DisplaySetMeterMode(byte Mode);
+
+
 
 
 #endif //#ifndef
@@ -0,0 +1,357 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// displaylink.cpp
+// this file holds the display serial link manager
+//
+// the display powers up at its own default rate (NEXSERIALBAUD) unless it has
+// been programmed otherwise, and "baud=N" moves it to a new rate until reset.
+// A rate is only used once an echo test has passed: the display is asked to
+// "get" a set of constants and must return each exactly. The patterns have
+// alternating bits and long runs to show up bit timing errors.
+//
+// at power up the rate stored in EEPROM is tried first: that is where the
+// display is if only the Arduino has been reset. If not, the display's power
+// up rate is tried; then the display is moved to the stored rate, or to the
+// fastest rate that passes. After a cold start the display is still starting
+// then, so the tick keeps looking, one rate a second, and probes at once when
+// the display's ready frame arrives. The rate is only stored once it works.
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "displaylink.h"
+#include "configdata.h"
+#include "trend.h"
+#include <Nextion.h>                        // uses the Nextion class library
+
+
+//
+// the rates the display supports that we try
+// 921600 is 0.6% fast from a 16MHz clock, well inside what the display tolerates
+//
+#define VDEFAULTBAUDINDEX 4                 // display power up rate (115200)
+const long GBaudRates[VNUMBAUDRATES] =
+{
+  9600,
+  19200,
+  38400,
+  57600,
+  115200,
+  230400,
+  512000,
+  921600
+};
+
+const char* GBaudCommands[VNUMBAUDRATES] =
+{
+  "baud=9600",
+  "baud=19200",
+  "baud=38400",
+  "baud=57600",
+  "baud=115200",
+  "baud=230400",
+  "baud=512000",
+  "baud=921600"
+};
+
+
+//
+// echo test patterns: the display returns the number in a "get" command
+//
+#define VNUMECHOPATTERNS 3
+const char* GEchoCommands[VNUMECHOPATTERNS] =
+{
+  "get 1431655765",                         // 0x55555555
+  "get 715827882",                          // 0x2AAAAAAA
+  "get 16711935"                            // 0x00FF00FF
+};
+
+const uint32_t GEchoValues[VNUMECHOPATTERNS] =
+{
+  0x55555555UL,
+  0x2AAAAAAAUL,
+  0x00FF00FFUL
+};
+
+
+#define VECHOTIMEOUTMS 10                   // display response time for a "get", plus...
+#define VECHOBITS 300000L                   // ...1000 x bits in the command and reply
+#define VLINKSETTLEMS 5                     // time for the display to change rate
+#define VLINKCHECKTICKS 50                  // check the error counts once per second
+#define VLINKERRORLIMIT 8                   // error score that causes a fall back
+#define VLINKRETRYTICKS 50                  // look for a missing display once per second
+
+
+byte GLinkBaudIndex;                        // rate in use (index into GBaudRates)
+bool GLinkFound;                            // true if the display has answered
+byte GLinkCheckTicks = VLINKCHECKTICKS;     // ticks to the next error check
+uint16_t GLinkErrors;                       // error count at the last check
+byte GLinkErrorScore;                       // errors, less one per second
+byte GLinkRetryTicks = VLINKRETRYTICKS;     // ticks to the next probe for a missing display
+byte GLinkRetryIndex;                       // last rate other than the power up rate probed
+bool GLinkRetryOther;                       // true if the last probe was not at the power up rate
+uint16_t GLinkLaunches;                     // display ready frame count at the last probe
+
+
+
+//
+// open the serial port at a new rate
+// anything queued is sent at the old rate first; then a terminator is sent to end any partial
+// command the display holds, and anything received (probably garbled) is discarded
+//
+void DisplayLinkOpen(byte Index)
+{
+  nexTxFlush();
+  nexSerial.flush();
+  delay(VLINKSETTLEMS);
+  nexSerial.begin(GBaudRates[Index]);
+  GLinkBaudIndex = Index;
+  sendCommand("");
+  nexTxFlush();
+  delay(VLINKSETTLEMS);
+  while(nexSerial.available())
+    nexSerial.read();
+  nexRxReset();
+}
+
+
+//
+// echo test at the current rate
+// returns true if every pattern is returned exactly
+//
+bool DisplayLinkEchoTest(void)
+{
+  byte Cntr;
+  uint32_t Value;
+  uint32_t Timeout;
+
+  Timeout = VECHOTIMEOUTMS + VECHOBITS / GBaudRates[GLinkBaudIndex];
+  for(Cntr = 0; Cntr < VNUMECHOPATTERNS; Cntr++)
+  {
+    sendCommand(GEchoCommands[Cntr]);
+    if(!recvRetNumber(&Value, Timeout) || (Value != GEchoValues[Cntr]))
+      return false;
+  }
+  return true;
+}
+
+
+//
+// try to talk to the display at one rate
+//
+bool DisplayLinkProbe(byte Index)
+{
+  DisplayLinkOpen(Index);
+  return DisplayLinkEchoTest();
+}
+
+
+//
+// search for the display: its power up rate first, then the others from the fastest down
+//
+bool DisplayLinkSearch(void)
+{
+  int Index;
+
+  if(DisplayLinkProbe(VDEFAULTBAUDINDEX))
+    return true;
+  for(Index = VNUMBAUDRATES - 1; Index >= 0; Index--)
+  {
+    if((Index != VDEFAULTBAUDINDEX) && DisplayLinkProbe(Index))
+      return true;
+  }
+  return false;
+}
+
+
+//
+// move both ends of a working link to a new rate
+// if the new rate fails, return to the old one; if that fails too, search again
+// returns true if the link is working at the new rate
+//
+bool DisplayLinkSwitch(byte Index)
+{
+  byte OldIndex;
+
+  OldIndex = GLinkBaudIndex;
+  sendCommand(GBaudCommands[Index]);
+  if(DisplayLinkProbe(Index))
+    return true;
+//
+// the display may be at the new rate but the link not good enough, so tell it to go back;
+// if it didn't change, this is sent at the wrong rate and ignored
+//
+  sendCommand(GBaudCommands[OldIndex]);
+  if(!DisplayLinkProbe(OldIndex))
+    GLinkFound = DisplayLinkSearch();
+  return false;
+}
+
+
+//
+// move to the fastest rate that passes the echo test
+//
+void DisplayLinkUpgrade(void)
+{
+  byte Index;
+
+  for(Index = VNUMBAUDRATES - 1; (Index > GLinkBaudIndex) && GLinkFound; Index--)
+  {
+    if(DisplayLinkSwitch(Index))
+      break;
+  }
+}
+
+
+//
+// the display has answered: if not at the stored rate, go to the stored rate if there is
+// one, else find the fastest that works; then remember it for next time
+//
+void DisplayLinkConnect(void)
+{
+  byte Stored;
+
+  Stored = GDisplayBaudInUse;
+  if(GLinkBaudIndex != Stored)
+  {
+    if(!((Stored < VNUMBAUDRATES) && DisplayLinkSwitch(Stored)))
+      DisplayLinkUpgrade();
+    if(GLinkFound && (GLinkBaudIndex != Stored))
+      EEWriteDisplayBaud(GLinkBaudIndex);
+  }
+  GLinkErrors = nexRxFrameErrorCount + nexRxErrorCount;
+  GLinkErrorScore = 0;
+}
+
+
+//
+// look for a display that hasn't answered yet, at one rate per second so the tick is only
+// held up for one probe: the power up rate every other second, the others in turn between.
+// the port is left at the power up rate, where a display that has just started sends its
+// ready frame; when that arrives, probe at once.
+// returns true if the display has been found
+//
+bool DisplayLinkRetry(void)
+{
+  byte Index;
+
+  if(nexRxLaunchCount != GLinkLaunches)             // display ready frame at the rate in use
+  {
+    Index = GLinkBaudIndex;
+    GLinkRetryTicks = VLINKRETRYTICKS;
+  }
+  else
+  {
+    if(--GLinkRetryTicks != 0)
+      return false;
+    GLinkRetryTicks = VLINKRETRYTICKS;
+    GLinkRetryOther = !GLinkRetryOther;
+    Index = VDEFAULTBAUDINDEX;
+    if(GLinkRetryOther)
+    {
+      if(GLinkRetryIndex == 0)
+        GLinkRetryIndex = VNUMBAUDRATES;
+      if(--GLinkRetryIndex == VDEFAULTBAUDINDEX)
+        GLinkRetryIndex--;
+      Index = GLinkRetryIndex;
+    }
+  }
+
+  GLinkFound = DisplayLinkProbe(Index);
+  if(!GLinkFound && (Index != VDEFAULTBAUDINDEX))
+    DisplayLinkOpen(VDEFAULTBAUDINDEX);
+  GLinkLaunches = nexRxLaunchCount;
+  return GLinkFound;
+}
+
+
+//
+// open the display link
+// only the stored rate and the display's power up rate are tried, to keep the start short;
+// if the display doesn't answer (it takes a while to start) the port is left at its power
+// up rate, and DisplayLinkTick() keeps looking
+// returns the rate in use
+//
+long DisplayLinkInit(void)
+{
+  byte Stored;
+
+  Stored = GDisplayBaudInUse;
+  GLinkFound = false;
+  if(Stored < VNUMBAUDRATES)                        // fast path: the display is still at the stored rate
+    GLinkFound = DisplayLinkProbe(Stored);
+  if(!GLinkFound && (Stored != VDEFAULTBAUDINDEX))  // leaves the port at the power up rate if it fails
+    GLinkFound = DisplayLinkProbe(VDEFAULTBAUDINDEX);
+
+  GLinkLaunches = nexRxLaunchCount;
+  if(GLinkFound)
+    DisplayLinkConnect();
+  return GBaudRates[GLinkBaudIndex];
+}
+
+
+//
+// display link tick
+// until the display has answered, keep looking for it.
+// the error score goes up by the number of bad frames and errors returned, and down by one
+// each second, so an occasional error is ignored but a run of them causes a fall back to the
+// next slower rate. Waiting "get" queries would take the echo test replies, so wait for them;
+// and wait for a trend transfer to finish, as the display would take the commands as its data.
+//
+ELinkEvent DisplayLinkTick(void)
+{
+  uint16_t Errors;
+  uint16_t NewErrors;
+
+  if(!GLinkFound)
+  {
+    if((nexGetPending() != 0) || !DisplayLinkRetry())
+      return eLinkNoChange;
+    DisplayLinkConnect();
+    return eLinkFound;
+  }
+
+  if(--GLinkCheckTicks != 0)
+    return eLinkNoChange;
+  GLinkCheckTicks = VLINKCHECKTICKS;
+
+  Errors = nexRxFrameErrorCount + nexRxErrorCount;
+  NewErrors = Errors - GLinkErrors;
+  GLinkErrors = Errors;
+  if(NewErrors > VLINKERRORLIMIT)
+    NewErrors = VLINKERRORLIMIT;
+  GLinkErrorScore += NewErrors;
+  if(GLinkErrorScore != 0)
+    GLinkErrorScore--;
+
+  if((GLinkErrorScore < VLINKERRORLIMIT) || (GLinkBaudIndex == 0))
+    return eLinkNoChange;
+  if(nexGetPending() != 0)
+    return eLinkNoChange;
+#ifdef VTRENDPAGE
+  if(TrendTransferBusy())
+    return eLinkNoChange;
+#endif
+
+  GLinkErrorScore = 0;
+  DisplayLinkSwitch(GLinkBaudIndex - 1);
+  if(GLinkFound)
+    EEWriteDisplayBaud(GLinkBaudIndex);
+  GLinkErrors = nexRxFrameErrorCount + nexRxErrorCount;
+  return eLinkNewRate;
+}
+
+
+//
+// get the serial rate in use
+//
+long DisplayLinkGetBaud(void)
+{
+  return GBaudRates[GLinkBaudIndex];
+}
@@ -0,0 +1,59 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// displaylink.h
+// this file holds the display serial link manager: it finds the rate the
+// display is using, moves both ends to the fastest rate that works, and
+// falls back to a slower one if errors build up
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __DISPLAYLINK_H
+#define __DISPLAYLINK_H
+
+#include <Arduino.h>
+
+
+#define VNUMBAUDRATES 8                     // number of serial rates tried (GDisplayBaudInUse indexes them)
+
+
+//
+// what the link tick has done: the display needs redrawing after either change
+//
+enum ELinkEvent
+{
+  eLinkNoChange,                            // nothing
+  eLinkNewRate,                             // moved to a new serial rate
+  eLinkFound                                // display found after starting up (it is on its splash page)
+};
+
+
+//
+// open the display link
+// tries the rate stored in EEPROM, then the display's power up rate; then tries to move to a faster rate
+// returns the rate in use (the display's power up rate if no display answered)
+//
+long DisplayLinkInit(void);
+
+
+//
+// display link tick: call every 20ms tick
+// looks for the display until it answers, then watches the return frame error counts,
+// and drops to a slower rate if they build up
+// returns what has changed (so all display items need to be re-sent)
+//
+ELinkEvent DisplayLinkTick(void);
+
+
+//
+// get the serial rate in use
+//
+long DisplayLinkGetBaud(void);
+
+
+#endif      // file sentry
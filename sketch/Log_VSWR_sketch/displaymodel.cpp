@@ -0,0 +1,289 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// displaymodel.cpp
+// this file holds the display model: the last value sent to each display
+// item, so that a command is only sent when the displayed value changes,
+// and the scheduler that decides which items to send each tick
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "displaymodel.h"
+#include "display.h"
+#include "trend.h"
+#include <Nextion.h>                        // for the command builder and byte count
+
+
+#define VDISPLAYREFRESHTICKS 250            // re-send an unchanged item after 5s, in case the display missed it
+#define VBYTECOUNTTICKS 50                  // ticks per byte count period (1s)
+#define VDISPLAYCMDLENGTH 24                // longest item command (p5t17.txt="-123.4")
+#define VITEMVALUEBYTES 11                  // most bytes after the attribute: "-123.4" and terminator
+
+
+//
+// how and when each item is sent: the declarative schedule
+// the period is the target refresh period in 20ms ticks (1 = 50Hz)
+// higher priority items are sent first when the tick's byte budget is short.
+// the deadband is in the units of the value sent: a bar that jitters by 1% is not
+// worth sending; text values are sent on any change
+//
+#define VITEMNUMBER 0                       // numeric attribute: "p2j0.val=12"
+#define VITEMTEXT 1                         // text: p2t2.txt="12"
+#define VITEMTEXTDP 2                       // text with 1 decimal place: p2t3.txt="1.2"
+
+struct DisplayItemFormat
+{
+  const char* Attribute;                    // object and attribute, up to the value
+  byte Page;                                // page the object is on (EDisplayPage)
+  byte Period;                              // target refresh period, ticks
+  byte Priority;                            // higher sent first
+  byte Deadband;                            // change that is ignored
+  byte Format;                              // how to send the value
+};
+
+const DisplayItemFormat GDisplayItemFormats[VNUMDISPLAYITEMS] =
+{
+  {"p2j0.val=", ePowerBargraphPage, 1, 3, 1, VITEMNUMBER},     // page 2 forward power bar
+  {"p2j1.val=", ePowerBargraphPage, 2, 3, 1, VITEMNUMBER},     // page 2 VSWR bar
+  {"p2t2.txt=", ePowerBargraphPage, 5, 2, 0, VITEMTEXT},       // page 2 forward power text
+  {"p2t3.txt=", ePowerBargraphPage, 5, 2, 0, VITEMTEXTDP},     // page 2 VSWR text
+  {"p2bt0.val=", ePowerBargraphPage, 5, 1, 0, VITEMNUMBER},    // page 2 overrange indicator
+  {"p3j0.val=", eLogBargraphPage, 1, 3, 1, VITEMNUMBER},       // page 3 forward dBm bar
+  {"p3j1.val=", eLogBargraphPage, 1, 3, 1, VITEMNUMBER},       // page 3 reverse dBm bar
+  {"p3t5.txt=", eLogBargraphPage, 5, 2, 0, VITEMTEXTDP},       // page 3 forward dBm text
+  {"p3t6.txt=", eLogBargraphPage, 5, 2, 0, VITEMTEXTDP},       // page 3 reverse dBm text
+  {"p4z0.val=", eMeterPage, 1, 3, 1, VITEMNUMBER},             // page 4 power meter needle
+  {"p4j0.val=", eMeterPage, 2, 3, 1, VITEMNUMBER},             // page 4 VSWR bar
+  {"p5t6.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXTDP},      // page 5 forward voltage
+  {"p5t7.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXTDP},      // page 5 reverse voltage
+  {"p5t17.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXTDP},     // page 5 forward dBm
+  {"p5t18.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXTDP},     // page 5 reverse dBm
+  {"p5t9.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXT},        // page 5 forward power
+  {"p5t10.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXT},       // page 5 reverse power
+  {"p5t12.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXT},       // page 5 forward peak power
+  {"p5t13.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXT},       // page 5 reverse peak power
+  {"p5t15.txt=", eEngineeringPage, 10, 1, 0, VITEMTEXTDP}      // page 5 VSWR
+};
+
+
+//
+// last value sent for each item
+//
+struct DisplayItemState
+{
+  int SentValue;                            // value last sent
+  unsigned int SentTick;                    // tick count when it was sent
+  unsigned int CheckTick;                   // tick count when the value was last checked
+  byte SendCount;                           // sends in this second
+  bool Valid;                               // false if nothing sent since the page was drawn
+};
+
+DisplayItemState GDisplayItems[VNUMDISPLAYITEMS];
+unsigned int GDisplayModelTicks;            // 20ms tick count
+unsigned int GDisplayBytesPerSecond;        // display UART bytes sent in the last second
+byte GDisplayItemRate[VNUMDISPLAYITEMS];    // achieved refresh rate of each item (sends in the last second)
+unsigned int GTickByteBudget;               // display UART bytes that can be sent in one tick
+unsigned long GLastByteCount;               // byte count at the start of this second
+byte GByteCountTicks;                       // ticks into this second
+
+
+//
+// initialise the display model
+// the byte budget is what the serial port can send in a 20ms tick (10 bits per byte),
+// but no more than the 1ms transmit service can pass to it in 20 calls
+//
+void DisplayModelInit(long Baud)
+{
+  GTickByteBudget = (unsigned int)min(Baud / 500, 20L * NEX_TX_SERVICE_MAX);
+  DisplayModelInvalidate();
+}
+
+
+//
+// forget all the values sent, so every item is sent at its next update
+//
+void DisplayModelInvalidate(void)
+{
+  byte Cntr;
+
+  for(Cntr = 0; Cntr < VNUMDISPLAYITEMS; Cntr++)
+    GDisplayItems[Cntr].Valid = false;
+}
+
+
+//
+// get the achieved refresh rate of an item (sends in the last second)
+//
+byte GetDisplayItemRate(EDisplayItem Item)
+{
+  return GDisplayItemRate[Item];
+}
+
+
+//
+// display model tick
+//
+void DisplayModelTick(void)
+{
+  unsigned long ByteCount;
+  byte Cntr;
+
+  GDisplayModelTicks++;
+  if(++GByteCountTicks >= VBYTECOUNTTICKS)
+  {
+    GByteCountTicks = 0;
+    ByteCount = nexTxByteCount;
+    GDisplayBytesPerSecond = (unsigned int)(ByteCount - GLastByteCount);
+    GLastByteCount = ByteCount;
+    for(Cntr = 0; Cntr < VNUMDISPLAYITEMS; Cntr++)
+    {
+      GDisplayItemRate[Cntr] = GDisplayItems[Cntr].SendCount;
+      GDisplayItems[Cntr].SendCount = 0;
+    }
+#ifdef VDISPLAYSTATSSERIAL
+    Serial.print("display bytes/s: ");
+    Serial.print(GDisplayBytesPerSecond);
+    Serial.print("  queue high water: ");
+    Serial.print(nexTxHighWater);
+    Serial.print("  rejected: ");
+    Serial.print(nexTxRejectCount);
+#ifdef VTRENDPAGE
+    Serial.print("  trend latency (ms): ");
+    Serial.print(GTrendLatency);
+#endif
+    Serial.print("  item rates (Hz):");
+    for(Cntr = 0; Cntr < VNUMDISPLAYITEMS; Cntr++)
+    {
+      Serial.print(" ");
+      Serial.print(GDisplayItemRate[Cntr]);
+    }
+    Serial.println();
+#endif
+  }
+}
+
+
+//
+// test whether a value needs to be sent: true if the item hasn't been sent since the page
+// was drawn or recently, or the value has changed by more than the item's deadband
+// (a return to zero is always sent)
+//
+bool DisplayItemNeedsSend(EDisplayItem Item, int Value)
+{
+  DisplayItemState* State;
+  int Difference;
+
+  State = &GDisplayItems[Item];
+#ifndef VDISPLAYSENDALWAYS
+  if(State->Valid && ((unsigned int)(GDisplayModelTicks - State->SentTick) < VDISPLAYREFRESHTICKS))
+  {
+    Difference = Value - State->SentValue;
+    if(Difference < 0)
+      Difference = -Difference;
+    if((Difference == 0) || ((Difference <= GDisplayItemFormats[Item].Deadband) && (Value != 0)))
+      return false;
+  }
+#endif
+  return true;
+}
+
+
+//
+// send a display item, and record it as sent
+// the command is built directly in the display transmit queue
+// returns the number of bytes sent, or 0 if there wasn't room
+//
+byte DisplayItemSend(EDisplayItem Item, int Value)
+{
+  DisplayItemState* State;
+  const DisplayItemFormat* Format;
+  NexCmdBuilder Cmd;
+
+  State = &GDisplayItems[Item];
+  Format = &GDisplayItemFormats[Item];
+  if(!nexCmdBegin(&Cmd, VDISPLAYCMDLENGTH))
+    return 0;
+  nexCmdText(&Cmd, Format->Attribute);
+  if(Format->Format == VITEMNUMBER)
+    nexCmdInt(&Cmd, Value);
+  else
+  {
+    nexCmdChar(&Cmd, '"');
+    nexCmdInt(&Cmd, Value, (Format->Format == VITEMTEXTDP) ? 1 : 0);
+    nexCmdChar(&Cmd, '"');
+  }
+  if(!nexCmdEnd(&Cmd))
+    return 0;
+
+  State->SentValue = Value;
+  State->SentTick = GDisplayModelTicks;
+  State->Valid = true;
+  State->SendCount++;
+  return Cmd.len + 3;
+}
+
+
+//
+// update the items on a page, within this tick's byte budget.
+// items are picked in order: due (at least their period since last checked), then highest
+// priority, then most overdue. An item that hasn't changed costs nothing and is marked checked.
+// when the budget runs out the remaining items stay due, so they are more overdue next tick:
+// fast high priority items keep their rate and slow low priority ones degrade.
+// bytes still waiting from earlier ticks (eg crossed needles) come out of the budget.
+//
+void DisplayModelUpdate(byte Page)
+{
+  int Budget;
+  int Late, BestLate;
+  byte Cntr, Best, BestPriority;
+  byte Sent;
+  int Value;
+  DisplayItemState* State;
+
+  Budget = min((int)GTickByteBudget - (int)nexTxUsed(), (int)nexTxFree());
+  while(Budget > 0)
+  {
+    Best = VNUMDISPLAYITEMS;
+    BestPriority = 0;
+    BestLate = 0;
+    for(Cntr = 0; Cntr < VNUMDISPLAYITEMS; Cntr++)
+    {
+      if(GDisplayItemFormats[Cntr].Page != Page)
+        continue;
+      State = &GDisplayItems[Cntr];
+      if(!State->Valid)
+        Late = VDISPLAYREFRESHTICKS;                  // not drawn yet: very overdue
+      else
+        Late = (int)(GDisplayModelTicks - State->CheckTick) - GDisplayItemFormats[Cntr].Period;
+      if(Late < 0)
+        continue;
+      if((Best == VNUMDISPLAYITEMS) || (GDisplayItemFormats[Cntr].Priority > BestPriority)
+         || ((GDisplayItemFormats[Cntr].Priority == BestPriority) && (Late > BestLate)))
+      {
+        Best = Cntr;
+        BestPriority = GDisplayItemFormats[Cntr].Priority;
+        BestLate = Late;
+      }
+    }
+    if(Best == VNUMDISPLAYITEMS)                        // nothing due
+      break;
+
+    Value = GetDisplayItemValue((EDisplayItem)Best);
+    if(DisplayItemNeedsSend((EDisplayItem)Best, Value))
+    {
+      if(Budget < (int)strlen(GDisplayItemFormats[Best].Attribute) + VITEMVALUEBYTES)
+        break;                                          // won't fit: leave it due
+      Sent = DisplayItemSend((EDisplayItem)Best, Value);
+      if(Sent == 0)
+        break;
+      Budget -= Sent;
+    }
+    GDisplayItems[Best].CheckTick = GDisplayModelTicks;
+  }
+}
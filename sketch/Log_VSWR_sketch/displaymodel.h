@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// displaymodel.h
+// this file holds the display model: the last value sent to each display
+// item, so that a command is only sent when the displayed value changes,
+// and the scheduler that decides which items to send each tick
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __DISPLAYMODEL_H
+#define __DISPLAYMODEL_H
+
+#include <Arduino.h>
+
+
+//
+// uncomment this to send every item on every update, as the code used to.
+// used to compare the display UART traffic with and without the model.
+//
+//#define VDISPLAYSENDALWAYS
+
+//
+// uncomment this to print the display UART bytes per second and transmit queue
+// statistics on the USB serial port (opened by TelemetryInit()). Don't use it with
+// telemetry on: the text would be mixed in with the frames.
+//
+//#define VDISPLAYSTATSSERIAL
+
+
+//
+// this type enumerates the display items that are updated periodically
+// the numbers are the value sent (percent, degrees, tenths etc.) not the text.
+// the object names, formats and update schedule are in displaymodel.cpp
+//
+enum EDisplayItem
+{
+  eItemP2FwdBar,                            // page 2 forward power bar
+  eItemP2VSWRBar,                           // page 2 VSWR bar
+  eItemP2FwdPower,                          // page 2 forward power text
+  eItemP2VSWRTxt,                           // page 2 VSWR text
+  eItemP2Overrange,                         // page 2 overrange indicator
+  eItemP3FwdBar,                            // page 3 forward dBm bar
+  eItemP3RevBar,                            // page 3 reverse dBm bar
+  eItemP3FwddBm,                            // page 3 forward dBm text
+  eItemP3RevdBm,                            // page 3 reverse dBm text
+  eItemP4Meter,                             // page 4 power meter needle
+  eItemP4VSWRBar,                           // page 4 VSWR bar
+  eItemP5FwdVolts,                          // page 5 engineering values
+  eItemP5RevVolts,
+  eItemP5FwddBm,
+  eItemP5RevdBm,
+  eItemP5FwdPower,
+  eItemP5RevPower,
+  eItemP5FwdPeak,
+  eItemP5RevPeak,
+  eItemP5VSWR,
+  VNUMDISPLAYITEMS
+};
+
+
+//
+// display UART traffic: bytes sent in the last second, updated once per second
+//
+extern unsigned int GDisplayBytesPerSecond;
+
+
+//
+// initialise the display model
+// Baud is the display serial rate, to set the bytes that can be sent each tick
+//
+void DisplayModelInit(long Baud);
+
+
+//
+// forget all the values sent, so every item is sent at its next update
+// call when the display page changes
+//
+void DisplayModelInvalidate(void);
+
+
+//
+// display model tick: call every 20ms tick
+// keeps the refresh timer and the bytes per second count
+//
+void DisplayModelTick(void);
+
+
+//
+// update the display items on a page
+// call every tick: the items due, changed and that fit in the tick's byte budget are sent
+//
+void DisplayModelUpdate(byte Page);
+
+
+//
+// get the achieved refresh rate of an item (sends in the last second)
+//
+byte GetDisplayItemRate(EDisplayItem Item);
+
+
+//
+// get the current value of a display item
+// this is provided by display.cpp, which knows how each value is found.
+// it must not change any state: an item can be read and then not sent
+//
+int GetDisplayItemValue(EDisplayItem Item);
+
+
+#endif      // file sentry
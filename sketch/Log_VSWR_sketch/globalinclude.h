@@ -21,5 +21,13 @@
 #define PRODUCTID 4                 // Power and VSWR meter
 
 
+//
+// uncomment this to include the power trend page (page 6)
+// it needs a display HMI file with page 6 holding a 300x200 waveform "p6s0" (id 2)
+// and a display button "p6b0" (id 1)
+//
+//#define VTRENDPAGE
+
+
 
 #endif      // file sentry
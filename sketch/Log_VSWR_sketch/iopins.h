@@ -16,5 +16,6 @@
 
 #define VPINFWDPOWERADC A0        // analogue input
 #define VPINREVPOWERADC A1        // analogue input
+#define VPINTRIPOUTPUT 2          // high VSWR trip output: high to inhibit PTT
 
 #endif //not defined
@@ -0,0 +1,144 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// slidingwindow.h
+// this file holds templates for the average and peak of the last N samples
+// both cost the same per sample and per query whatever the window length
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __SLIDINGWINDOW_H
+#define __SLIDINGWINDOW_H
+
+
+//
+// average of the last N samples
+// keeps a running sum: add the new sample, subtract the one leaving the window
+// T is the sample type; the sum is held in an unsigned long
+//
+template <typename T, unsigned int N> class SlidingAverage
+{
+  public:
+    SlidingAverage()
+    {
+      unsigned int Cntr;
+
+      for (Cntr = 0; Cntr < N; Cntr++)
+        Samples[Cntr] = 0;
+      Sum = 0;
+      Position = 0;
+    }
+
+//
+// add a new sample, replacing the oldest
+//
+    void AddSample(T Sample)
+    {
+      Sum -= Samples[Position];
+      Sum += Sample;
+      Samples[Position] = Sample;
+      if(++Position >= N)
+        Position = 0;
+    }
+
+//
+// return the average over the window
+//
+    T GetAverage(void)
+    {
+      return (T)(Sum / N);
+    }
+
+  private:
+    T Samples[N];                               // circular buffer of the last N samples
+    unsigned long Sum;                          // sum of all entries in Samples[]
+    unsigned int Position;                      // where the next sample is written
+};
+
+
+
+//
+// peak of the last N samples
+// uses a "monotonic deque": a list of samples that could still become the peak, in decreasing
+// order of value with the oldest at the head. A new sample removes every entry from the tail
+// that it is at least as big as, so each sample is added and removed once (amortised O(1))
+// and the peak is always the head entry.
+// the deque is held in a circular buffer of N entries, each with the sample number it arrived at.
+//
+template <typename T, unsigned int N> class SlidingPeak
+{
+  public:
+    SlidingPeak()
+    {
+      Head = 0;
+      Count = 0;
+      SampleNumber = 0;
+    }
+
+//
+// add a new sample
+//
+    void AddSample(T Sample)
+    {
+      unsigned int Tail;
+
+      SampleNumber++;
+//
+// first remove the head entry if it has now left the window
+// (unsigned subtraction so the sample number can wrap)
+//
+      if((Count != 0) && ((unsigned int)(SampleNumber - Ages[Head]) >= N))
+      {
+        if(++Head >= N)
+          Head = 0;
+        Count--;
+      }
+//
+// then remove entries from the tail that can never be the peak again
+//
+      while (Count != 0)
+      {
+        Tail = Head + Count - 1;
+        if(Tail >= N)
+          Tail -= N;
+        if(Values[Tail] > Sample)
+          break;
+        Count--;
+      }
+//
+// and add the new sample at the tail
+//
+      Tail = Head + Count;
+      if(Tail >= N)
+        Tail -= N;
+      Values[Tail] = Sample;
+      Ages[Tail] = SampleNumber;
+      Count++;
+    }
+
+//
+// return the peak value over the window
+//
+    T GetPeak(void)
+    {
+      if(Count == 0)
+        return 0;
+      return Values[Head];
+    }
+
+  private:
+    T Values[N];                                // deque of candidate peak values
+    unsigned int Ages[N];                       // sample number each was added at
+    unsigned int Head;                          // oldest entry (= current peak)
+    unsigned int Count;                         // number of entries in the deque
+    unsigned int SampleNumber;                  // incremented for every sample
+};
+
+
+
+#endif      // file sentry
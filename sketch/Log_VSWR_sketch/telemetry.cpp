@@ -0,0 +1,304 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// telemetry.cpp
+// this file holds the code to send binary telemetry frames to a PC
+//
+// each frame holds the ADC readings collected by the ADC interrupt since the
+// last frame (sums, counts and peaks) and the power and VSWR found from them.
+// frames are COBS encoded, so a zero byte only ever appears as the frame
+// delimiter: a PC can start listening at any point and lose at most one frame.
+//
+// frame payload, before encoding (all values little endian):
+//   0   type (VFRAMETELEMETRY)
+//   1   frame sequence number (16 bit)
+//   3   timestamp: micros() when the readings were claimed (32 bit)
+//   7   forward reading sum (32 bit)      11  reverse reading sum (32 bit)
+//   15  forward reading count             17  reverse reading count
+//   19  forward peak reading              21  reverse peak reading
+//   23  ADC conversion sequence number of the last reading
+//   25  forward average, tenths of dBm   27  reverse average, tenths of dBm (signed)
+//   29  forward average power, 0.1W      31  reverse average power, 0.1W
+//   33  forward peak power, 0.1W         35  reverse peak power, 0.1W
+//   37  VSWR, tenths                      39  flags (VFLAG...)
+//   40  CRC16 (CCITT, initial value 0xFFFF) of bytes 0-39
+// readings are in units of 1/16 ADC code.
+//
+// the sequence number counts frame periods, not frames sent: if the previous
+// frame is still being sent when the next is due, that frame is skipped and
+// its readings carry over into the next one. The PC sees the gap in the
+// sequence, and the counts and timestamp show the longer period.
+//
+// the PC sets the frame rate by sending a COBS frame holding
+// VFRAMESETRATE, rate (16 bit), CRC16. The console (console.cpp) reads the
+// serial input and passes frames here; it also shares the output, so a
+// frame and a console reply are never mixed: each waits for the other.
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "telemetry.h"
+#include "analogueio.h"
+#include "configdata.h"
+#include "console.h"
+
+
+#define VFRAMETELEMETRY 0x01                    // frame type: telemetry, version 1
+#define VFRAMESETRATE 0x81                      // frame type: set frame rate (from PC)
+#define VFLAGTRIPPED 1                          // flags bit: VSWR protection tripped
+#define VFLAGOVERSAMPLE 2                       // flags bit: ADC oversampling selected
+
+#define VPAYLOADSIZE 40                         // payload bytes before the CRC
+#define VFRAMESIZE (VPAYLOADSIZE + 2)           // with CRC
+#define VENCODEDSIZE (VFRAMESIZE + 2)           // with COBS overhead byte and delimiter
+
+
+byte GTxFrame[VENCODEDSIZE];                    // encoded frame being sent
+byte GTxLength;                                 // encoded frame length
+byte GTxPosition;                               // bytes sent so far
+unsigned int GTelemetryRate;                    // frames per second (0 = off)
+unsigned long GFramePeriodMicros;
+unsigned long GNextFrameMicros;                 // micros() when the next frame is due
+unsigned int GFrameSequence;
+unsigned int GTelemetryFramesSent;
+unsigned int GTelemetryFramesSkipped;
+
+
+
+//
+// write 16 and 32 bit values into a buffer, little endian
+//
+void PutWord(byte* Buffer, unsigned int Value)
+{
+  Buffer[0] = (byte)Value;
+  Buffer[1] = (byte)(Value >> 8);
+}
+
+void PutLong(byte* Buffer, unsigned long Value)
+{
+  PutWord(Buffer, (unsigned int)Value);
+  PutWord(Buffer + 2, (unsigned int)(Value >> 16));
+}
+
+
+//
+// COBS encode a frame and add the zero delimiter
+// each zero byte is replaced by the distance to the next one; the first byte
+// is the distance to the first zero. Returns the encoded length.
+// (frames are less than 254 bytes, so there is no need for the 0xFF code)
+//
+byte COBSEncode(const byte* Frame, byte Length, byte* Encoded)
+{
+  byte Code;                                    // where the current distance is written
+  byte Out;
+  byte Cntr;
+
+  Code = 0;
+  Out = 1;
+  for(Cntr = 0; Cntr < Length; Cntr++)
+  {
+    if(Frame[Cntr] == 0)
+    {
+      Encoded[Code] = Out - Code;
+      Code = Out++;
+    }
+    else
+      Encoded[Out++] = Frame[Cntr];
+  }
+  Encoded[Code] = Out - Code;
+  Encoded[Out++] = 0;
+  return Out;
+}
+
+
+//
+// COBS decode a frame in place (without its delimiter)
+// returns the decoded length, or 0 if the encoding is invalid
+//
+byte COBSDecode(byte* Frame, byte Length)
+{
+  byte In;
+  byte Out;
+  byte Code;
+
+  In = 0;
+  Out = 0;
+  while(In < Length)
+  {
+    Code = Frame[In++];
+    if((Code == 0) || ((In + Code - 1) > Length))
+      return 0;
+    while(--Code != 0)
+      Frame[Out++] = Frame[In++];
+    if(In < Length)
+      Frame[Out++] = 0;
+  }
+  return Out;
+}
+
+
+//
+// build and encode the next telemetry frame
+//
+void BuildTelemetryFrame(void)
+{
+  TelemetryData Data;
+  byte Frame[VFRAMESIZE];
+  unsigned int CRC;
+  byte Cntr;
+  byte Flags;
+
+  AnalogueIOGetTelemetry(&Data);
+  Frame[0] = VFRAMETELEMETRY;
+  PutWord(Frame + 1, GFrameSequence);
+  PutLong(Frame + 3, micros());
+  PutLong(Frame + 7, Data.FwdSum);
+  PutLong(Frame + 11, Data.RevSum);
+  PutWord(Frame + 15, Data.FwdCount);
+  PutWord(Frame + 17, Data.RevCount);
+  PutWord(Frame + 19, Data.FwdPeak);
+  PutWord(Frame + 21, Data.RevPeak);
+  PutWord(Frame + 23, Data.EndSequence);
+  PutWord(Frame + 25, (unsigned int)Data.FwdTenthdBm);
+  PutWord(Frame + 27, (unsigned int)Data.RevTenthdBm);
+  PutWord(Frame + 29, Data.FwdAvgPowerTenth);
+  PutWord(Frame + 31, Data.RevAvgPowerTenth);
+  PutWord(Frame + 33, Data.FwdPeakPowerTenth);
+  PutWord(Frame + 35, Data.RevPeakPowerTenth);
+  PutWord(Frame + 37, Data.VSWR);
+  Flags = 0;
+  if(Data.Tripped)
+    Flags |= VFLAGTRIPPED;
+  if(GOversampleInUse)
+    Flags |= VFLAGOVERSAMPLE;
+  Frame[39] = Flags;
+
+  CRC = 0xFFFF;
+  for(Cntr = 0; Cntr < VPAYLOADSIZE; Cntr++)
+    CRC = CRC16Update(CRC, Frame[Cntr]);
+  PutWord(Frame + VPAYLOADSIZE, CRC);
+
+  GTxLength = COBSEncode(Frame, VFRAMESIZE, GTxFrame);
+  GTxPosition = 0;
+}
+
+
+//
+// act on a frame from the PC (still COBS encoded, without the delimiter)
+// frames that don't decode or fail the CRC are ignored
+//
+void TelemetryHandleFrame(byte* Frame, byte Length)
+{
+  unsigned int CRC;
+  byte Cntr;
+
+  Length = COBSDecode(Frame, Length);
+  if(Length < 3)
+    return;
+  CRC = 0xFFFF;
+  for(Cntr = 0; Cntr < Length - 2; Cntr++)
+    CRC = CRC16Update(CRC, Frame[Cntr]);
+  if((Frame[Length - 2] != (byte)CRC) || (Frame[Length - 1] != (byte)(CRC >> 8)))
+    return;
+
+  if((Frame[0] == VFRAMESETRATE) && (Length == 5))
+    TelemetrySetRate(Frame[1] | ((unsigned int)Frame[2] << 8));
+}
+
+
+//
+// true if a frame has been started but not all passed to the serial port
+//
+bool TelemetryTxBusy(void)
+{
+  return (GTxPosition < GTxLength);
+}
+
+
+//
+// initialise
+//
+void TelemetryInit(void)
+{
+  Serial.begin(VUSBSERIALBAUD);
+  TelemetrySetRate(VTELEMETRYDEFAULTRATE);
+}
+
+
+//
+// set the frame rate
+// a frame being sent is finished, but the next is timed from now
+//
+void TelemetrySetRate(unsigned int Rate)
+{
+  if(Rate > VTELEMETRYMAXRATE)
+    Rate = VTELEMETRYMAXRATE;
+  if(Rate != 0)
+  {
+    GFramePeriodMicros = 1000000UL / Rate;
+    GNextFrameMicros = micros() + GFramePeriodMicros;
+  }
+  if((Rate != 0) != (GTelemetryRate != 0))
+    AnalogueIOEnableTelemetry(Rate != 0);
+  GTelemetryRate = Rate;
+}
+
+
+//
+// get the frame rate
+//
+unsigned int TelemetryGetRate(void)
+{
+  return GTelemetryRate;
+}
+
+
+//
+// telemetry service
+// if we have fallen more than a frame behind (eg during display initialisation) the timing
+// restarts from now, rather than sending a burst of frames to catch up
+//
+void TelemetryService(void)
+{
+  int Space;
+  int Count;
+
+  if(GTelemetryRate != 0)
+  {
+    if((long)(micros() - GNextFrameMicros) >= 0)
+    {
+      GNextFrameMicros += GFramePeriodMicros;
+      if((long)(micros() - GNextFrameMicros) >= 0)
+        GNextFrameMicros = micros() + GFramePeriodMicros;
+      if((GTxPosition < GTxLength) || ConsoleTxBusy())
+        GTelemetryFramesSkipped++;
+      else
+      {
+        BuildTelemetryFrame();
+        GTelemetryFramesSent++;
+      }
+      GFrameSequence++;
+    }
+  }
+
+//
+// send as much of the frame as fits without waiting
+//
+  if(GTxPosition < GTxLength)
+  {
+    Space = Serial.availableForWrite();
+    Count = GTxLength - GTxPosition;
+    if(Count > Space)
+      Count = Space;
+    if(Count > 0)
+    {
+      Serial.write(GTxFrame + GTxPosition, Count);
+      GTxPosition += Count;
+    }
+  }
+}
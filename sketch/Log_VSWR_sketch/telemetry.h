@@ -0,0 +1,73 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// telemetry.h
+// this file holds the code to send binary telemetry frames to a PC
+// over the USB serial port
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __TELEMETRY_H
+#define __TELEMETRY_H
+
+#include <Arduino.h>
+
+
+#define VUSBSERIALBAUD 500000L                          // USB serial rate: an exact divisor of 16MHz
+#define VTELEMETRYMAXRATE 500                           // frames per second
+#define VTELEMETRYDEFAULTRATE 0                         // rate at power up (0 = off)
+
+
+//
+// telemetry statistics
+//
+extern unsigned int GTelemetryFramesSent;               // frames sent since power up
+extern unsigned int GTelemetryFramesSkipped;            // frames not sent because the last was still going
+
+
+//
+// initialise: open the USB serial port and set the power up frame rate
+//
+void TelemetryInit(void);
+
+
+//
+// set the frame rate, in frames per second: 0 to turn telemetry off
+// rates above VTELEMETRYMAXRATE are reduced to it
+//
+void TelemetrySetRate(unsigned int Rate);
+
+
+//
+// get the frame rate in use (0 if off)
+//
+unsigned int TelemetryGetRate(void);
+
+
+//
+// act on a frame from the PC, as received (COBS encoded, without the zero delimiter)
+// the frame is decoded in place
+//
+void TelemetryHandleFrame(byte* Frame, byte Length);
+
+
+//
+// true if a telemetry frame is part sent: nothing else may be sent until it is finished
+//
+bool TelemetryTxBusy(void);
+
+
+//
+// telemetry service: call on every pass of loop()
+// builds a frame when one is due, and passes as much as fits into the serial transmit buffer.
+// Never waits for the serial port.
+//
+void TelemetryService(void);
+
+
+#endif      // file sentry
@@ -0,0 +1,199 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// trend.cpp
+// this file holds the code to draw the power trend page waveform
+//
+// the waveform is sent points with transparent transfers: an "addt" command
+// for one channel and a block of points, then the points as binary data,
+// rather than an "add" command for every point. The display answers the
+// command when it is ready for the data (0xFE) and again when it has it all
+// (0xFD); nothing else may be sent in between. So an update is a command and
+// two waits for each channel, and a full 300 point redraw is 6 blocks
+// rather than 900 commands.
+/////////////////////////////////////////////////////////////////////////
+
+#include <Arduino.h>
+#include "trend.h"
+
+#ifdef VTRENDPAGE
+
+#include "analogueio.h"
+#include <Nextion.h>                        // uses the Nextion class library
+
+
+#define VTRENDWAVEFORMID 2                  // component id of the p6s0 waveform
+#define VTRENDCLEARCMD "cle 2,255"          // clear all channels of the waveform
+#define VTRENDBLOCKMAX 200                  // most points in one transfer: must fit in the transmit queue
+#define VTRENDMINPOINTS 4                   // new points needed before an update is sent
+#define VTRENDTIMEOUTTICKS 10               // ticks to wait for the display to answer
+#define VTRENDCMDLENGTH 16                  // "addt 2,0,200"
+
+
+//
+// transfer state
+//
+enum ETrendState
+{
+  eTrendIdle,                               // waiting for new points
+  eTrendWaitReady,                          // addt sent, waiting for the display to be ready for the data
+  eTrendWaitDone                            // data sent, waiting for the display to have it all
+};
+
+ETrendState GTrendState;
+byte GTrendChannel;                         // channel being sent
+byte GTrendWaitTicks;                       // ticks waiting for the display
+unsigned long GTrendSentCount;              // point count up to which the display has been sent
+unsigned int GTrendBlockPoints;             // points in the update being sent
+unsigned long GTrendBlockTime;              // millis() when the oldest point in the update was taken
+unsigned int GTrendLatency;
+
+
+
+//
+// clear the waveform and start sending the whole history again
+// a terminator is sent first in case a failed transfer has left a command part sent
+//
+void TrendPageInit(void)
+{
+  unsigned long Points;
+
+  nexTrySendCommand("");
+  nexTrySendCommand(VTRENDCLEARCMD);
+  Points = GTrendPointCount;
+  if(Points > VTRENDLENGTH)
+    Points = VTRENDLENGTH;
+  GTrendSentCount = GTrendPointCount - Points;
+  GTrendChannel = 0;
+  GTrendState = eTrendIdle;
+}
+
+
+//
+// send the "addt" command for the current channel and block
+// returns false if there isn't room for it and the data in the transmit queue yet
+//
+bool TrendSendCommand(void)
+{
+  NexCmdBuilder Cmd;
+
+  if(nexTxFree() < (VTRENDCMDLENGTH + 3 + GTrendBlockPoints))
+    return false;
+  nexRxTransparentReady = false;
+  nexRxTransparentDone = false;
+  nexCmdBegin(&Cmd, VTRENDCMDLENGTH);
+  nexCmdText(&Cmd, "addt ");
+  nexCmdInt(&Cmd, VTRENDWAVEFORMID);
+  nexCmdChar(&Cmd, ',');
+  nexCmdInt(&Cmd, GTrendChannel);
+  nexCmdChar(&Cmd, ',');
+  nexCmdInt(&Cmd, GTrendBlockPoints);
+  return nexCmdEnd(&Cmd);
+}
+
+
+//
+// send the block of points for the current channel, oldest first
+// the history is circular, so it may be in two parts
+// returns false if there isn't room in the transmit queue yet
+//
+bool TrendSendData(void)
+{
+  unsigned int Start;
+  unsigned int Length;
+  byte* History;
+
+  if(nexTxFree() < GTrendBlockPoints)
+    return false;
+  History = GTrendHistory[GTrendChannel];
+  Start = (unsigned int)((GTrendWritePosition + VTRENDLENGTH - (GTrendPointCount - GTrendSentCount) % VTRENDLENGTH) % VTRENDLENGTH);
+  Length = GTrendBlockPoints;
+  if(Start + Length > VTRENDLENGTH)
+  {
+    nexTrySendData(History + Start, VTRENDLENGTH - Start);
+    Length -= VTRENDLENGTH - Start;
+    Start = 0;
+  }
+  nexTrySendData(History + Start, Length);
+  return true;
+}
+
+
+//
+// trend page tick
+// sends each channel in turn for a block of new points
+//
+void TrendPageTick(void)
+{
+  unsigned long NewPoints;
+
+  NewPoints = GTrendPointCount - GTrendSentCount;
+  if(NewPoints > VTRENDLENGTH)                        // fallen so far behind the oldest have gone
+  {
+    TrendPageInit();
+    return;
+  }
+
+  switch(GTrendState)
+  {
+    case eTrendIdle:
+      if(GTrendChannel == 0)                          // starting a new update
+      {
+        if(NewPoints < VTRENDMINPOINTS)
+          break;
+        GTrendBlockPoints = (NewPoints > VTRENDBLOCKMAX) ? VTRENDBLOCKMAX : (unsigned int)NewPoints;
+        GTrendBlockTime = GTrendPointTime - (NewPoints - 1) * VTRENDPOINTMS;
+      }
+      if(TrendSendCommand())
+      {
+        GTrendState = eTrendWaitReady;
+        GTrendWaitTicks = 0;
+      }
+      break;
+
+    case eTrendWaitReady:
+      if(nexRxTransparentReady)
+      {
+        if(TrendSendData())
+        {
+          GTrendState = eTrendWaitDone;
+          GTrendWaitTicks = 0;
+        }
+      }
+      else if(++GTrendWaitTicks >= VTRENDTIMEOUTTICKS)
+        TrendPageInit();
+      break;
+
+    case eTrendWaitDone:
+      if(nexRxTransparentDone)
+      {
+        GTrendState = eTrendIdle;
+        if(++GTrendChannel >= VTRENDCHANNELS)         // all channels drawn
+        {
+          GTrendChannel = 0;
+          GTrendSentCount += GTrendBlockPoints;
+          GTrendLatency = (unsigned int)(millis() - GTrendBlockTime);
+        }
+      }
+      else if(++GTrendWaitTicks >= VTRENDTIMEOUTTICKS)
+        TrendPageInit();
+      break;
+  }
+}
+
+
+//
+// true if a transfer is in progress
+//
+bool TrendTransferBusy(void)
+{
+  return (GTrendState != eTrendIdle);
+}
+
+#endif  // VTRENDPAGE
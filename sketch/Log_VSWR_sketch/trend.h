@@ -0,0 +1,49 @@
+/////////////////////////////////////////////////////////////////////////
+//
+// Log VSWR Bridge Display sketch by Laurence Barker G8NJJ
+// copyright (c) Laurence Barker G8NJJ 2020
+//
+// this sketch provides a VSWR bridge display
+//
+// the code is written for an Arduino Nano Every module
+//
+// trend.h
+// this file holds the code to draw the power trend page waveform
+// (only included if VTRENDPAGE is defined)
+/////////////////////////////////////////////////////////////////////////
+
+#ifndef __TREND_H
+#define __TREND_H
+
+#include <Arduino.h>
+#include "globalinclude.h"
+
+#ifdef VTRENDPAGE
+
+//
+// trend statistics
+//
+extern unsigned int GTrendLatency;                        // ms from the oldest point in an update being taken to it being drawn
+
+
+//
+// start the trend page: clear the waveform then send the whole history
+//
+void TrendPageInit(void);
+
+
+//
+// trend page tick: call every tick while the trend page is shown
+// sends new points to the waveform
+//
+void TrendPageTick(void);
+
+
+//
+// true if a transfer is in progress, when nothing else may be sent to the display
+//
+bool TrendTransferBusy(void);
+
+#endif  // VTRENDPAGE
+
+#endif      // file sentry